@@ -0,0 +1,132 @@
+// Point lookups through a B+ tree and through a hash index over the same
+// int keys, inserted in random order, with uniform and Zipfian (s = 0.99)
+// probes. Prints the time per lookup, the levels of the tree, which are the
+// pages a tree lookup reads, and the pages of a hash bucket.
+//
+// Usage: bench/run.sh hash_index [keys [lookups]]
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "buffer_manager.h"
+#include "catalog_manager.h"
+#include "hash_index.h"
+#include "index_manager.h"
+
+using namespace std;
+
+namespace {
+
+// Pages in the chain of each bucket, on average.
+double PagesPerBucket(BufferManager &hdl, Index &idx) {
+  long pages = 0;
+  for (unsigned int i = 0; i < idx.buckets().size(); ++i) {
+    for (int b = idx.buckets()[i]; b != -1;) {
+      ++pages;
+      BlockInfo *page = hdl.GetFileBlock("d", idx.name(), FORMAT_INDEX, b);
+      b = page->GetNextBlockNum();
+    }
+  }
+  return (double)pages / idx.buckets().size();
+}
+
+// Index `n` keys in the data folder `path` and time `lookups` lookups.
+void Run(string path, int n, int lookups) {
+  mkdir((path + "d").c_str(), 0755);
+  ofstream((path + "d/bt.index").c_str());
+  ofstream((path + "d/hh.index").c_str());
+
+  BufferManager hdl(path);
+  vector<string> attrs(1, "k");
+  Index bt("bt", attrs, T_INT, 4, (4 * 1024 - 12) / (4 + 4) / 2 - 1, true);
+  Index hh("hh", attrs, T_BYTES, 4, 0, true, INDEX_HASH);
+  BPlusTree tree(&bt, &hdl, NULL, "d");
+  HashIndex hash(&hh, &hdl, "d");
+
+  vector<int> keys(n);
+  for (int i = 0; i < n; ++i) {
+    keys[i] = i * 7 + 3;
+  }
+  mt19937 rng(1);
+  shuffle(keys.begin(), keys.end(), rng);
+  for (int i = 0; i < n; ++i) {
+    TKey k(T_INT, 4);
+    memcpy(k.key(), &keys[i], 4);
+    tree.Add(k, i >> 8, i & 0xff);
+    TKey h(T_BYTES, 4);
+    NormalizeKey(T_INT, k.key(), 4, h.key());
+    hash.Add(h, i >> 8, i & 0xff);
+  }
+  hdl.WriteToDisk();
+
+  // The i-th most frequent key of the Zipfian probes is keys[i].
+  vector<double> cdf(n);
+  double sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += 1.0 / pow(i + 1, 0.99);
+    cdf[i] = sum;
+  }
+
+  for (int zipf = 0; zipf < 2; ++zipf) {
+    vector<int> probes(lookups);
+    uniform_int_distribution<int> uniform(0, n - 1);
+    uniform_real_distribution<double> weight(0, sum);
+    for (int i = 0; i < lookups; ++i) {
+      int k = zipf ? lower_bound(cdf.begin(), cdf.end(), weight(rng)) -
+                         cdf.begin()
+                   : uniform(rng);
+      probes[i] = keys[k];
+    }
+    for (int use_hash = 0; use_hash < 2; ++use_hash) {
+      long missing = 0;
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for (int i = 0; i < lookups; ++i) {
+        TKey k(T_INT, 4);
+        memcpy(k.key(), &probes[i], 4);
+        if (!use_hash) {
+          missing += tree.GetVal(k) < 0;
+        } else {
+          TKey h(T_BYTES, 4);
+          NormalizeKey(T_INT, k.key(), 4, h.key());
+          vector<int> vals;
+          hash.Lookup(h.key(), vals);
+          missing += vals.empty();
+        }
+      }
+      double ns = chrono::duration<double, nano>(chrono::steady_clock::now() -
+                                                 start).count();
+      printf("%d keys, %-7s probes, %-7s %8.0f ns/lookup%s\n", n,
+             zipf ? "zipf" : "uniform", use_hash ? "hash" : "B+ tree",
+             ns / lookups, missing ? ", keys missing!" : "");
+    }
+  }
+  printf("B+ tree: %d levels; hash: %d buckets, %.2f pages each\n",
+         bt.level(), (int)hh.buckets().size(), PagesPerBucket(hdl, hh));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 20000;
+  int lookups = argc > 2 ? atoi(argv[2]) : 200000;
+
+  char dir[] = "/tmp/minidb_bench_XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+  Run(string(dir) + "/", n, lookups);
+  string rm = "rm -rf " + string(dir);
+  return system(rm.c_str()) == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Filtering in-memory row pages of (int, float, char(8)) records by
+// "b < 100 and c = 'n5'", three ways, on one thread and with no buffer
+// manager in the way:
+//  - copying every field out of the record and comparing them one
+//    condition at a time, looking each column up by name, as SatisfyWhere
+//    did before WHERE conditions were compiled;
+//  - the compiled Predicate, one record at a time;
+//  - the compiled Predicate over a whole page with the filter kernels.
+//
+// Usage: bench/run.sh predicate [rows]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "catalog_manager.h"
+#include "commons.h"
+#include "filter_kernels.h"
+#include "predicate.h"
+#include "tuple_view.h"
+
+using namespace std;
+
+namespace {
+
+const int kRecordLength = 16;
+const int kRowsPerPage = (4 * 1024 - 12) / kRecordLength;
+
+// The per-row test WHERE conditions went through before they were
+// compiled: the column is looked up and the constant parsed every time.
+bool SatisfyWhere(Table *tbl, vector<TKey> keys, SQLWhere where) {
+  int idx = -1;
+  for (unsigned int i = 0; i < tbl->GetAttributeNum(); ++i) {
+    if (tbl->ats()[i].attr_name() == where.key) {
+      idx = i;
+    }
+  }
+  TKey tmp(tbl->ats()[idx].data_type(), tbl->ats()[idx].length());
+  tmp.ReadValue(where.value.c_str());
+  switch (where.sign_type) {
+  case SIGN_EQ: return keys[idx] == tmp;
+  case SIGN_NE: return !(keys[idx] == tmp);
+  case SIGN_LT: return keys[idx] < tmp;
+  case SIGN_GT: return !(keys[idx] <= tmp);
+  case SIGN_LE: return keys[idx] <= tmp;
+  case SIGN_GE: return keys[idx] >= tmp;
+  }
+  return false;
+}
+
+double Millis(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  long rows = argc > 1 ? atol(argv[1]) : 10000000;
+
+  Table tbl;
+  const char *names[] = {"a", "b", "c"};
+  int types[] = {T_INT, T_FLOAT, T_CHAR};
+  int lengths[] = {4, 4, 8};
+  for (int i = 0; i < 3; ++i) {
+    Attribute attr;
+    attr.set_attr_name(names[i]);
+    attr.set_data_type(types[i]);
+    attr.set_length(lengths[i]);
+    tbl.AddAttribute(attr);
+  }
+  tbl.set_record_length(kRecordLength);
+
+  // Pages as they sit in the buffer: a 12 byte header, then the records.
+  long pages = (rows + kRowsPerPage - 1) / kRowsPerPage;
+  vector<char> data(pages * 4 * 1024);
+  for (long r = 0; r < rows; ++r) {
+    char *p = &data[(r / kRowsPerPage) * 4 * 1024 + 12 +
+                    (r % kRowsPerPage) * kRecordLength];
+    int a = (int)r;
+    float b = (float)(r % 1000);
+    memcpy(p, &a, 4);
+    memcpy(p + 4, &b, 4);
+    snprintf(p + 8, 8, "n%ld", r % 37);
+  }
+
+  vector<SQLWhere> wheres(2);
+  wheres[0].key = "b";
+  wheres[0].sign_type = SIGN_LT;
+  wheres[0].value = "100";
+  wheres[1].key = "c";
+  wheres[1].sign_type = SIGN_EQ;
+  wheres[1].value = "n5";
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  long hits = 0;
+  for (long r = 0; r < rows; ++r) {
+    TupleView tuple(&tbl, &data[(r / kRowsPerPage) * 4 * 1024 + 12],
+                    r % kRowsPerPage);
+    vector<TKey> keys = tuple.Materialize();
+    bool pass = true;
+    for (unsigned int i = 0; i < wheres.size(); ++i) {
+      pass = pass && SatisfyWhere(&tbl, keys, wheres[i]);
+    }
+    hits += pass;
+  }
+  printf("materialize + SatisfyWhere: %8.0f ms, %ld rows pass\n",
+         Millis(start), hits);
+
+  Predicate pred(&tbl, wheres);
+  start = chrono::steady_clock::now();
+  hits = 0;
+  for (long r = 0; r < rows; ++r) {
+    hits += pred.Evaluate(&data[(r / kRowsPerPage) * 4 * 1024 + 12 +
+                                (r % kRowsPerPage) * kRecordLength]);
+  }
+  printf("Predicate::Evaluate:        %8.0f ms, %ld rows pass\n",
+         Millis(start), hits);
+
+  start = chrono::steady_clock::now();
+  hits = 0;
+  vector<uint64_t> mask((kRowsPerPage + 63) / 64);
+  for (long p = 0; p < pages; ++p) {
+    int count = (int)min<long>(kRowsPerPage, rows - p * kRowsPerPage);
+    pred.EvaluateBlock(&data[p * 4 * 1024 + 12], kRecordLength, count,
+                       &mask[0]);
+    for (int w = 0; w < (count + 63) / 64; ++w) {
+      hits += __builtin_popcountll(mask[w]);
+    }
+  }
+  printf("Predicate::EvaluateBlock:   %8.0f ms, %ld rows pass (%s)\n",
+         Millis(start), hits, GetFilterKernels().name);
+  return 0;
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Builds bench/<name>_bench.cc against the sources, with optimizations,
+# and runs it with the remaining arguments.
+#
+# Usage: bench/run.sh name [arguments...]
+
+NAME=${1:?usage: $0 name [arguments...]}
+shift
+CXX=${CXX:-g++}
+DIR=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+SOURCES=
+for f in "$DIR"/src/*.cc; do
+  [ "$(basename "$f")" = main.cc ] || SOURCES="$SOURCES $f"
+done
+if ! "$CXX" -std=c++11 -O2 -I "$DIR/src" -o "$WORK/bench" \
+    "$DIR/bench/${NAME}_bench.cc" $SOURCES -lboost_serialization \
+    -lboost_filesystem -lboost_regex -lreadline -lpthread; then
+  echo "could not build bench/${NAME}_bench.cc"
+  exit 1
+fi
+"$WORK/bench" "$@"
@@ -0,0 +1,475 @@
+#include "bitmap_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "index_manager.h"
+
+using namespace std;
+
+namespace {
+
+typedef RidBitmap::Container Container;
+
+bool HasSlot(const Container &c, int slot) {
+  if (c.words.empty()) {
+    return binary_search(c.slots.begin(), c.slots.end(), (uint16_t)slot);
+  }
+  return (c.words[slot >> 6] >> (slot & 63)) & 1;
+}
+
+// The slots of `c` as `words` words of bits.
+void GetWords(const Container &c, int words, vector<uint64_t> &out) {
+  if (!c.words.empty()) {
+    out = c.words;
+    return;
+  }
+  out.assign(words, 0);
+  for (unsigned int i = 0; i < c.slots.size(); ++i) {
+    out[c.slots[i] >> 6] |= (uint64_t)1 << (c.slots[i] & 63);
+  }
+}
+
+long Cardinality(const Container &c) {
+  if (c.words.empty()) {
+    return c.slots.size();
+  }
+  long n = 0;
+  for (unsigned int i = 0; i < c.words.size(); ++i) {
+    n += __builtin_popcountll(c.words[i]);
+  }
+  return n;
+}
+
+} // namespace
+
+//=======================RidBitmap=======================//
+
+std::vector<Container>::iterator RidBitmap::Find(int block) {
+  unsigned int lo = 0, hi = containers_.size();
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+    if (containers_[mid].block < block) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return containers_.begin() + lo;
+}
+
+void RidBitmap::Fit(Container &c) {
+  // An array takes two bytes a slot, a bitmap eight a word.
+  long n = Cardinality(c);
+  if (c.words.empty() && 2 * n >= 8 * words_) {
+    GetWords(c, words_, c.words);
+    c.slots.clear();
+  } else if (!c.words.empty() && 2 * n < 8 * words_) {
+    c.slots.clear();
+    for (int w = 0; w < words_; ++w) {
+      for (uint64_t bits = c.words[w]; bits != 0; bits &= bits - 1) {
+        c.slots.push_back(w * 64 + __builtin_ctzll(bits));
+      }
+    }
+    c.words.clear();
+  }
+}
+
+long RidBitmap::Count() {
+  long n = 0;
+  for (unsigned int i = 0; i < containers_.size(); ++i) {
+    n += Cardinality(containers_[i]);
+  }
+  return n;
+}
+
+void RidBitmap::Set(int block, int slot) {
+  vector<Container>::iterator it = Find(block);
+  if (it == containers_.end() || it->block != block) {
+    Container c;
+    c.block = block;
+    c.slots.push_back(slot);
+    containers_.insert(it, c);
+    return;
+  }
+  if (it->words.empty()) {
+    vector<uint16_t>::iterator pos =
+        lower_bound(it->slots.begin(), it->slots.end(), (uint16_t)slot);
+    if (pos == it->slots.end() || *pos != slot) {
+      it->slots.insert(pos, slot);
+    }
+  } else {
+    it->words[slot >> 6] |= (uint64_t)1 << (slot & 63);
+  }
+  Fit(*it);
+}
+
+bool RidBitmap::Clear(int block, int slot) {
+  vector<Container>::iterator it = Find(block);
+  if (it == containers_.end() || it->block != block || !HasSlot(*it, slot)) {
+    return false;
+  }
+  if (it->words.empty()) {
+    it->slots.erase(
+        lower_bound(it->slots.begin(), it->slots.end(), (uint16_t)slot));
+  } else {
+    it->words[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+  }
+  if (Cardinality(*it) == 0) {
+    containers_.erase(it);
+  } else {
+    Fit(*it);
+  }
+  return true;
+}
+
+void RidBitmap::Append(Container &c) { containers_.push_back(c); }
+
+void RidBitmap::And(RidBitmap &other) {
+  vector<Container> out;
+  vector<Container>::iterator a = containers_.begin();
+  vector<Container>::iterator b = other.containers_.begin();
+  while (a != containers_.end() && b != other.containers_.end()) {
+    if (a->block < b->block) {
+      ++a;
+      continue;
+    }
+    if (b->block < a->block) {
+      ++b;
+      continue;
+    }
+    Container c;
+    c.block = a->block;
+    if (!a->words.empty() && !b->words.empty()) {
+      c.words.resize(words_);
+      for (int w = 0; w < words_; ++w) {
+        c.words[w] = a->words[w] & b->words[w];
+      }
+    } else if (a->words.empty() && b->words.empty()) {
+      set_intersection(a->slots.begin(), a->slots.end(), b->slots.begin(),
+                       b->slots.end(), back_inserter(c.slots));
+    } else {
+      // The slots of the array that the bitmap holds.
+      Container &array = a->words.empty() ? *a : *b;
+      Container &bitmap = a->words.empty() ? *b : *a;
+      for (unsigned int i = 0; i < array.slots.size(); ++i) {
+        if (HasSlot(bitmap, array.slots[i])) {
+          c.slots.push_back(array.slots[i]);
+        }
+      }
+    }
+    if (Cardinality(c) > 0) {
+      Fit(c);
+      out.push_back(c);
+    }
+    ++a;
+    ++b;
+  }
+  containers_.swap(out);
+}
+
+void RidBitmap::Or(RidBitmap &other) {
+  vector<Container> out;
+  vector<Container>::iterator a = containers_.begin();
+  vector<Container>::iterator b = other.containers_.begin();
+  while (a != containers_.end() || b != other.containers_.end()) {
+    if (b == other.containers_.end() ||
+        (a != containers_.end() && a->block < b->block)) {
+      out.push_back(*a++);
+      continue;
+    }
+    if (a == containers_.end() || b->block < a->block) {
+      out.push_back(*b++);
+      continue;
+    }
+    Container c;
+    c.block = a->block;
+    if (a->words.empty() && b->words.empty()) {
+      set_union(a->slots.begin(), a->slots.end(), b->slots.begin(),
+                b->slots.end(), back_inserter(c.slots));
+    } else {
+      vector<uint64_t> words;
+      GetWords(*a, words_, c.words);
+      GetWords(*b, words_, words);
+      for (int w = 0; w < words_; ++w) {
+        c.words[w] |= words[w];
+      }
+    }
+    Fit(c);
+    out.push_back(c);
+    ++a;
+    ++b;
+  }
+  containers_.swap(out);
+}
+
+void RidBitmap::AndNot(RidBitmap &other) {
+  vector<Container> out;
+  vector<Container>::iterator b = other.containers_.begin();
+  for (vector<Container>::iterator a = containers_.begin();
+       a != containers_.end(); ++a) {
+    while (b != other.containers_.end() && b->block < a->block) {
+      ++b;
+    }
+    if (b == other.containers_.end() || b->block != a->block) {
+      out.push_back(*a);
+      continue;
+    }
+    Container c;
+    c.block = a->block;
+    if (a->words.empty()) {
+      for (unsigned int i = 0; i < a->slots.size(); ++i) {
+        if (!HasSlot(*b, a->slots[i])) {
+          c.slots.push_back(a->slots[i]);
+        }
+      }
+    } else {
+      vector<uint64_t> words;
+      GetWords(*b, words_, words);
+      c.words.resize(words_);
+      for (int w = 0; w < words_; ++w) {
+        c.words[w] = a->words[w] & ~words[w];
+      }
+    }
+    if (Cardinality(c) > 0) {
+      Fit(c);
+      out.push_back(c);
+    }
+  }
+  containers_.swap(out);
+}
+
+void RidBitmap::GetRids(std::vector<int> &rids) {
+  for (unsigned int i = 0; i < containers_.size(); ++i) {
+    Container &c = containers_[i];
+    if (c.words.empty()) {
+      for (unsigned int j = 0; j < c.slots.size(); ++j) {
+        rids.push_back((c.block << 16) | c.slots[j]);
+      }
+      continue;
+    }
+    for (int w = 0; w < words_; ++w) {
+      for (uint64_t bits = c.words[w]; bits != 0; bits &= bits - 1) {
+        rids.push_back((c.block << 16) | (w * 64 + __builtin_ctzll(bits)));
+      }
+    }
+  }
+}
+
+//=======================BitmapIndex=======================//
+
+BitmapIndex::BitmapIndex(Table *tbl, Index *idx, BufferManager *hdl,
+                         std::string db_name)
+    : tbl_(tbl), idx_(idx), hdl_(hdl), db_name_(db_name) {
+  slots_ = tbl->GetMaxRecordCount();
+  // A container takes four bytes of header and at most a full bitmap.
+  group_ = (4 * 1024 - 12) / (4 + 8 * ((slots_ + 63) / 64));
+  Attribute *attr = tbl->GetAttribute(idx->attr_name());
+  value_len_ = attr->length();
+  data_type_ = attr->data_type();
+}
+
+int BitmapIndex::FindValue(const char *value) {
+  vector<string> &values = idx_->values();
+  for (unsigned int i = 0; i < values.size(); ++i) {
+    if (memcmp(values[i].data(), value, value_len_) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void BitmapIndex::ReadPage(int page, int group, RidBitmap &out) {
+  BlockInfo *block =
+      hdl_->GetFileBlock(db_name_, idx_->name(), FORMAT_INDEX, page);
+  const char *p = block->GetContentAddress();
+  int words = out.words();
+  for (int i = 0; i < block->GetRecordCount(); ++i) {
+    uint16_t head[2]; // Block within the group, and number of slots.
+    memcpy(head, p, 4);
+    p += 4;
+    Container c;
+    c.block = group * group_ + head[0];
+    if (2 * head[1] < 8 * words) {
+      c.slots.resize(head[1]);
+      memcpy(&c.slots[0], p, 2 * head[1]);
+      p += 2 * head[1];
+    } else {
+      c.words.resize(words);
+      memcpy(&c.words[0], p, 8 * words);
+      p += 8 * words;
+    }
+    out.Append(c);
+  }
+}
+
+void BitmapIndex::WritePage(int page, int group, RidBitmap &bm) {
+  BlockInfo *block =
+      hdl_->GetFileBlock(db_name_, idx_->name(), FORMAT_INDEX, page);
+  char *p = block->GetContentAddress();
+  vector<Container> &containers = bm.containers();
+  for (unsigned int i = 0; i < containers.size(); ++i) {
+    Container &c = containers[i];
+    uint16_t head[2];
+    head[0] = c.block - group * group_;
+    if (c.words.empty()) {
+      head[1] = c.slots.size();
+      memcpy(p, head, 4);
+      memcpy(p + 4, &c.slots[0], 2 * c.slots.size());
+      p += 4 + 2 * c.slots.size();
+    } else {
+      head[1] = 0;
+      for (unsigned int w = 0; w < c.words.size(); ++w) {
+        head[1] += __builtin_popcountll(c.words[w]);
+      }
+      memcpy(p, head, 4);
+      memcpy(p + 4, &c.words[0], 8 * c.words.size());
+      p += 4 + 8 * c.words.size();
+    }
+  }
+  block->SetRecordCount(containers.size());
+  block->set_dirty(true);
+}
+
+int BitmapIndex::NewPage() {
+  int page = idx_->rubbish();
+  if (page != -1) {
+    idx_->set_rubbish(
+        hdl_->GetFileBlock(db_name_, idx_->name(), FORMAT_INDEX, page)
+            ->GetNextBlockNum());
+  } else {
+    page = idx_->IncreaseMaxCount();
+  }
+  BlockInfo *block =
+      hdl_->GetFileBlock(db_name_, idx_->name(), FORMAT_INDEX, page);
+  block->SetPrevBlockNum(-1);
+  block->SetNextBlockNum(-1);
+  block->SetRecordCount(0);
+  block->set_dirty(true);
+  return page;
+}
+
+void BitmapIndex::FreePage(int page) {
+  BlockInfo *block =
+      hdl_->GetFileBlock(db_name_, idx_->name(), FORMAT_INDEX, page);
+  block->SetNextBlockNum(idx_->rubbish());
+  block->set_dirty(true);
+  idx_->set_rubbish(page);
+}
+
+bool BitmapIndex::Matches(int v, std::vector<SQLWhere> &wheres) {
+  const char *value = idx_->values()[v].data();
+  vector<char> other(value_len_);
+  for (unsigned int i = 0; i < wheres.size(); ++i) {
+    if (wheres[i].key != idx_->attr_name()) {
+      continue;
+    }
+    TKey key(data_type_, value_len_);
+    key.ReadValue(wheres[i].value);
+    NormalizeKey(data_type_, key.key(), value_len_, &other[0]);
+    int cmp = memcmp(value, &other[0], value_len_);
+    bool ok;
+    switch (wheres[i].sign_type) {
+    case SIGN_EQ:
+      ok = cmp == 0;
+      break;
+    case SIGN_NE:
+      ok = cmp != 0;
+      break;
+    case SIGN_LT:
+      ok = cmp < 0;
+      break;
+    case SIGN_GT:
+      ok = cmp > 0;
+      break;
+    case SIGN_LE:
+      ok = cmp <= 0;
+      break;
+    default:
+      ok = cmp >= 0;
+      break;
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BitmapIndex::Add(TKey &key, int block_num, int offset) {
+  int v = FindValue(key.key());
+  if (v == -1) {
+    v = idx_->values().size();
+    idx_->values().push_back(string(key.key(), value_len_));
+    idx_->value_pages().push_back(vector<int>());
+  }
+  int group = block_num / group_;
+  vector<int> &pages = idx_->value_pages()[v];
+  if ((int)pages.size() <= group) {
+    pages.resize(group + 1, -1);
+  }
+  RidBitmap bm(slots_);
+  if (pages[group] == -1) {
+    pages[group] = NewPage();
+  } else {
+    ReadPage(pages[group], group, bm);
+  }
+  bm.Set(block_num, offset);
+  WritePage(pages[group], group, bm);
+  idx_->IncreaseKeyCount();
+}
+
+bool BitmapIndex::Remove(TKey &key) {
+  int v = FindValue(key.key());
+  if (v == -1) {
+    return false;
+  }
+  uint32_t rid = 0;
+  for (int i = 0; i < 4; ++i) {
+    rid = (rid << 8) | (unsigned char)key.key()[value_len_ + i];
+  }
+  int block_num = (rid >> 16) & 0xffff;
+  int group = block_num / group_;
+  vector<int> &pages = idx_->value_pages()[v];
+  if ((int)pages.size() <= group || pages[group] == -1) {
+    return false;
+  }
+  RidBitmap bm(slots_);
+  ReadPage(pages[group], group, bm);
+  if (!bm.Clear(block_num, rid & 0xffff)) {
+    return false;
+  }
+  if (bm.empty()) {
+    FreePage(pages[group]);
+    pages[group] = -1;
+  } else {
+    WritePage(pages[group], group, bm);
+  }
+  idx_->DecreaseKeyCount();
+  return true;
+}
+
+void BitmapIndex::Match(std::vector<SQLWhere> &wheres, bool failing,
+                        RidBitmap &out) {
+  for (unsigned int v = 0; v < idx_->values().size(); ++v) {
+    if (Matches(v, wheres) == failing) {
+      continue;
+    }
+    // The groups come in block order, so the containers are appended.
+    RidBitmap bm(slots_);
+    vector<int> &pages = idx_->value_pages()[v];
+    for (unsigned int g = 0; g < pages.size(); ++g) {
+      if (pages[g] != -1) {
+        ReadPage(pages[g], g, bm);
+      }
+    }
+    out.Or(bm);
+  }
+}
+
+void BitmapIndex::Print() {
+  printf("*****************************************************\n");
+  printf("KeyCount: %d, Values: %d \n", idx_->key_count(),
+         (int)idx_->values().size());
+}
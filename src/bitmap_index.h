@@ -0,0 +1,106 @@
+#ifndef MINIDB_BITMAP_INDEX_H_
+#define MINIDB_BITMAP_INDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "buffer_manager.h"
+#include "catalog_manager.h"
+#include "sql_statement.h"
+
+// RidBitmap: a set of record ids, split as in Roaring bitmaps: a container
+// for each table block holding records of the set, keeping their slots as
+// a sorted array while few, else as a bitmap of the block's slots. Sets
+// combine container by container, each pair by whichever method their
+// kinds call for.
+class RidBitmap {
+public:
+  struct Container {
+    int block;
+    std::vector<uint16_t> slots; // Sorted slots, for an array container.
+    std::vector<uint64_t> words; // Slot bits, for a bitmap container.
+  };
+
+private:
+  int words_;                         // Words of a bitmap container.
+  std::vector<Container> containers_; // By ascending block.
+
+  // The container of `block`, or where it would go.
+  std::vector<Container>::iterator Find(int block);
+  // Keep `c` in the smaller of the two kinds.
+  void Fit(Container &c);
+
+public:
+  // `slots` is the number of records a block holds.
+  explicit RidBitmap(int slots) : words_((slots + 63) / 64) {}
+
+  std::vector<Container> &containers() { return containers_; }
+  int words() { return words_; }
+  bool empty() { return containers_.empty(); }
+  long Count();
+
+  void Set(int block, int slot);
+  // False if the record was not in the set.
+  bool Clear(int block, int slot);
+  // Add a container after the last one; its block must be higher.
+  void Append(Container &c);
+
+  // Keep the records also in `other`, add those of `other`, or drop them.
+  void And(RidBitmap &other);
+  void Or(RidBitmap &other);
+  void AndNot(RidBitmap &other);
+
+  // Append the record ids of the set in ascending order, block by block.
+  void GetRids(std::vector<int> &rids);
+};
+
+// BitmapIndex: a bitmap of the records holding each value of a column, for
+// columns with few distinct values. The values met so far are listed in
+// the catalog, normalized. The bitmap of a value is stored a group of
+// table blocks per page of the index file, groups small enough that the
+// containers of a page fit however dense they get, so an insert or a
+// delete only rewrites the page of its block. The catalog holds the page
+// of every value and group, -1 where the value has no record.
+//
+// Keys are made by MakeIndexKey for a non-unique index: the normalized
+// value followed by the record id.
+class BitmapIndex {
+private:
+  Table *tbl_;
+  Index *idx_;
+  BufferManager *hdl_;
+  std::string db_name_;
+  int slots_;      // Records a table block holds.
+  int group_;      // Table blocks a page covers.
+  int value_len_;  // Bytes of a normalized value.
+  int data_type_;  // Type of the column.
+
+  int FindValue(const char *value);
+  // Add to `out` the containers of a page of group `group`.
+  void ReadPage(int page, int group, RidBitmap &out);
+  void WritePage(int page, int group, RidBitmap &bm);
+  int NewPage();
+  void FreePage(int page);
+  // True if the value numbered `v` satisfies every condition on the column.
+  bool Matches(int v, std::vector<SQLWhere> &wheres);
+
+public:
+  BitmapIndex(Table *tbl, Index *idx, BufferManager *hdl,
+              std::string db_name);
+
+  int slots() { return slots_; }
+
+  void Add(TKey &key, int block_num, int offset);
+  // Remove the record whose key, record id included, is `key`; false if
+  // it is absent.
+  bool Remove(TKey &key);
+  // Add to `out` the records whose value satisfies every one of the
+  // conditions on the column in `wheres`, or, with `failing`, those whose
+  // value fails one of them.
+  void Match(std::vector<SQLWhere> &wheres, bool failing, RidBitmap &out);
+
+  void Print();
+};
+
+#endif
@@ -30,8 +30,13 @@ void BlockInfo::WriteInfo(std::string path) {
     path += ".records";
   }
 
-  ofstream ofs(path, ios::binary);
-  ofs.seekp(block_num_ * 4 * 1024);
-  ofs.write(data_, 4 * 1024);
-  ofs.close();
+  // Open for update: an ofstream alone would truncate the file and lose
+  // every other block.
+  fstream fs(path, ios::in | ios::out | ios::binary);
+  if (!fs.is_open()) {
+    fs.open(path, ios::out | ios::binary);
+  }
+  fs.seekp(block_num_ * 4 * 1024);
+  fs.write(data_, 4 * 1024);
+  fs.close();
 }
@@ -16,6 +16,7 @@ private:
   char *data_; // Pointer to a memory block (allocated as 4 * 1024 bytes).
   bool dirty_; //Flag indicating if the block has been modified.
   long age_; //Age counter for the block.
+  int pins_; //Number of holders keeping the block in the buffer.
   BlockInfo *next_; //Pointer to the next BlockInfo block in a linked list.
 
 // Implementing replacement policies like Least Recently Used (LRU) or Least Frequently Used (LFU)
@@ -23,7 +24,8 @@ private:
 
 public:
   BlockInfo(int num)
-      : dirty_(false), next_(NULL), file_(NULL), age_(0), block_num_(num) {
+      : dirty_(false), next_(NULL), file_(NULL), age_(0), pins_(0),
+        block_num_(num) {
     data_ = new char[4 * 1024];
   }
   virtual ~BlockInfo() { delete[] data_; }
@@ -46,6 +48,11 @@ public:
   void IncreaseAge() { ++age_; }
   void ResetAge() { age_ = 0; }
 
+  // A pinned block is never recycled, however old it is.
+  bool pinned() { return pins_ > 0; }
+  void Pin() { ++pins_; }
+  void Unpin() { --pins_; }
+
 //   Offset	Purpose
 // 0	Previous block number (int)
 // 4	Next block number (int)
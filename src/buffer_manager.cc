@@ -1,41 +1,51 @@
 #include "buffer_manager.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <vector>
 
 #include "commons.h"
 
 using namespace std;
 
 BlockInfo *BufferManager::GetFileBlock(string db_name, string tb_name,
-                                       int file_type, int block_num) {
+                                       int file_type, int block_num,
+                                       bool pin) {
+  lock_guard<mutex> lock(mutex_);
 
   fhandle_->IncreaseAge();
 
   FileInfo *file = fhandle_->GetFileInfo(db_name, tb_name, file_type);
 
+  BlockInfo *bp;
   if (file) {
-    BlockInfo *block = fhandle_->GetBlockInfo(file, block_num);
-    if (block) {
-      return block;
-    } else {
-      BlockInfo *bp = GetUsableBlock();
+    bp = fhandle_->GetBlockInfo(file, block_num);
+    if (bp == NULL) {
+      bp = GetUsableBlock();
       bp->set_block_num(block_num);
       bp->set_file(file);
       bp->ReadInfo(path_);
       fhandle_->AddBlockInfo(bp);
-      return bp;
     }
   } else {
-    BlockInfo *bp = GetUsableBlock();
+    bp = GetUsableBlock();
     bp->set_block_num(block_num);
     FileInfo *fp = new FileInfo(db_name, file_type, tb_name, 0, 0, NULL, NULL);
     fhandle_->AddFileInfo(fp);
     bp->set_file(fp);
     bp->ReadInfo(path_);
     fhandle_->AddBlockInfo(bp);
-    return bp;
   }
-  return 0;
+  if (pin) {
+    bp->Pin();
+  }
+  return bp;
+}
+
+void BufferManager::UnpinBlock(BlockInfo *block) {
+  lock_guard<mutex> lock(mutex_);
+  block->Unpin();
 }
 
 BlockInfo *BufferManager::GetUsableBlock() {
@@ -46,6 +56,50 @@ BlockInfo *BufferManager::GetUsableBlock() {
   }
 }
 
+void BufferManager::ReadFileBlocks(string db_name, string tb_name,
+                                   int file_type, int block_num, int count,
+                                   char *dest) {
+  vector<bool> cached(count, false);
+  int first_missing = count;
+  int last_missing = -1;
+  {
+    lock_guard<mutex> lock(mutex_);
+    FileInfo *file = fhandle_->GetFileInfo(db_name, tb_name, file_type);
+    for (int i = 0; i < count; ++i) {
+      BlockInfo *bp =
+          file ? fhandle_->GetBlockInfo(file, block_num + i) : NULL;
+      if (bp) {
+        memcpy(dest + i * 4 * 1024, bp->data(), 4 * 1024);
+        cached[i] = true;
+      } else {
+        first_missing = min(first_missing, i);
+        last_missing = i;
+      }
+    }
+  }
+  if (last_missing == -1) {
+    return;
+  }
+
+  // One read covering every block that is not cached. Blocks that are not
+  // cached are not dirty, and no one writes the table while it is scanned,
+  // so the file holds their latest contents even outside the lock.
+  string path = path_ + db_name + "/" + tb_name;
+  path += file_type == FORMAT_INDEX ? ".index" : ".records";
+  int n = last_missing - first_missing + 1;
+  vector<char> data(n * 4 * 1024, 0);
+  ifstream ifs(path, ios::binary);
+  ifs.seekg((long)(block_num + first_missing) * 4 * 1024);
+  ifs.read(&data[0], data.size());
+  ifs.close();
+  for (int i = first_missing; i <= last_missing; ++i) {
+    if (!cached[i]) {
+      memcpy(dest + i * 4 * 1024, &data[(i - first_missing) * 4 * 1024],
+             4 * 1024);
+    }
+  }
+}
+
 void BufferManager::WriteBlock(BlockInfo *block) { block->set_dirty(true); }
 
 void BufferManager::WriteToDisk() { fhandle_->WriteToDisk(); }
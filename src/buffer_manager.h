@@ -1,6 +1,7 @@
 #ifndef MINIDB_BUFFER_MANAGER_H_
 #define MINIDB_BUFFER_MANAGER_H_
 
+#include <mutex>
 #include <string>
 
 #include "block_handle.h"
@@ -11,6 +12,7 @@ private:
   BlockHandle *bhandle_;
   FileHandle *fhandle_;
   std::string path_;
+  std::mutex mutex_; // Guards the buffer against concurrent callers.
 
   BlockInfo *GetUsableBlock();
 
@@ -22,8 +24,21 @@ public:
     delete fhandle_;
   }
 
+  // The block, loaded into the buffer if needed. It may be called while
+  // scan workers read blocks, as when an index join looks records up, but
+  // the block must not be modified meanwhile. With `pin`, the block stays
+  // in the buffer until UnpinBlock is called for it as often.
   BlockInfo *GetFileBlock(std::string db_name, std::string tb_name,
-                          int file_type, int block_num);
+                          int file_type, int block_num, bool pin = false);
+  void UnpinBlock(BlockInfo *block);
+  // Copy `count` consecutive blocks starting at `block_num` into `dest`.
+  // Blocks held in the buffer are copied from there, since they may be
+  // newer than the file; the others are read from the file with a single
+  // request and are not cached. Scan workers may call this from several
+  // threads at once, alongside GetFileBlock, as long as no one writes the
+  // blocks being read meanwhile.
+  void ReadFileBlocks(std::string db_name, std::string tb_name, int file_type,
+                      int block_num, int count, char *dest);
   void WriteBlock(BlockInfo *block);
   void WriteToDisk();
 };
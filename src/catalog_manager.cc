@@ -1,4 +1,6 @@
 #include "catalog_manager.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <boost/filesystem.hpp>
 
@@ -71,6 +73,7 @@ void Database::CreateTable(SQLCreateTable &st) {
   }
   tb.set_tb_name(st.tb_name());
   tb.set_record_length(record_length);
+  tb.set_layout(st.layout());
   tbs_.push_back(tb);
 }
 
@@ -136,3 +139,79 @@ int Table::GetAttributeIndex(std::string name) {
   }
   return -1;
 }
+
+void Table::ComputeOffsets() {
+  offsets_.clear();
+  bases_.clear();
+  strides_.clear();
+  zone_offsets_.clear();
+  int offset = 0;
+  int zone_offset = 0;
+  for (unsigned int i = 0; i < ats_.size(); ++i) {
+    offsets_.push_back(offset);
+    if (layout_ == LAYOUT_COLUMNAR) {
+      bases_.push_back(GetMaxRecordCount() * offset);
+      strides_.push_back(ats_[i].length());
+    } else {
+      bases_.push_back(offset);
+      strides_.push_back(record_length_);
+    }
+    offset += ats_[i].length();
+    zone_offsets_.push_back(zone_offset);
+    if (ats_[i].data_type() == T_CHAR) {
+      zone_offset += 2 * min(ats_[i].length(), ZONE_PREFIX_LEN);
+    } else {
+      zone_offset += 2 * 4;
+    }
+  }
+  zone_offsets_.push_back(zone_offset);
+}
+
+void Table::set_blocks(std::vector<int> &blocks) {
+  blocks_ = blocks;
+  sort(blocks_.begin(), blocks_.end());
+  has_blocks_ = true;
+}
+
+void Table::AddBlock(int block_num) {
+  if (!has_blocks_) {
+    return;
+  }
+  vector<int>::iterator it =
+      lower_bound(blocks_.begin(), blocks_.end(), block_num);
+  if (it == blocks_.end() || *it != block_num) {
+    blocks_.insert(it, block_num);
+  }
+}
+
+void Table::RemoveBlock(int block_num) {
+  if (!has_blocks_) {
+    return;
+  }
+  vector<int>::iterator it =
+      lower_bound(blocks_.begin(), blocks_.end(), block_num);
+  if (it != blocks_.end() && *it == block_num) {
+    blocks_.erase(it);
+  }
+}
+
+char *Table::GetZone(int block_num) {
+  int size = GetZoneSize();
+  int count = zones_.size() / size;
+  if (block_num >= count) {
+    zones_.resize((block_num + 1) * size);
+    for (int i = count; i <= block_num; ++i) {
+      ClearZone(i);
+    }
+  }
+  return &zones_[block_num * size];
+}
+
+void Table::ClearZone(int block_num) {
+  char *zone = GetZone(block_num);
+  for (unsigned int i = 0; i < ats_.size(); ++i) {
+    int width = GetZoneWidth(i);
+    memset(zone + GetZoneOffset(i), 0xff, width);
+    memset(zone + GetZoneOffset(i) + width, 0, width);
+  }
+}
@@ -12,7 +12,9 @@
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 
+#include "commons.h"
 #include "sql_statement.h"
 
 class CatalogManager;
@@ -110,6 +112,23 @@ private:
     ar &block_count_;        // Total number of blocks.
     ar &ats_;                // List of attributes (columns).
     ar &ids_;                // List of indexes on the table.
+    if (version >= 1) {
+      ar &layout_;           // Page layout, row or columnar.
+    }
+    if (version >= 2) {
+      ar &has_blocks_;
+      ar &blocks_;           // Block directory.
+    } else {
+      // Older catalogs have no directory; it is rebuilt from the block
+      // chain the first time it is needed.
+      has_blocks_ = false;
+    }
+    if (version >= 3) {
+      ar &has_zones_;
+      ar &zones_;            // Zone map.
+    } else {
+      has_zones_ = false;
+    }
   }
 
   std::string tb_name_;       // Name of the table.
@@ -119,10 +138,19 @@ private:
   int block_count_;           // Total count of blocks allocated.
   std::vector<Attribute> ats_; // Attributes (columns) of the table.
   std::vector<Index> ids_;     // Indexes defined on the table.
+  int layout_;                 // LAYOUT_ROW or LAYOUT_COLUMNAR.
+  std::vector<int> blocks_;    // Blocks holding records, in file order.
+  bool has_blocks_;            // blocks_ is up to date.
+  std::vector<char> zones_;    // Zone of each block, by block number.
+  bool has_zones_;             // zones_ is up to date.
+  std::vector<int> offsets_;   // Byte offset of each attribute in a record (derived, not serialized).
+  std::vector<int> bases_;     // Start of each attribute in a block (derived, not serialized).
+  std::vector<int> strides_;   // Distance between two values of an attribute (derived, not serialized).
+  std::vector<int> zone_offsets_; // Start of the bounds of each attribute in a zone (derived, not serialized).
 
 public:
   // Constructor initializing members to default values.
-  Table() : tb_name_(""), record_length_(-1), first_block_num_(-1), first_rubbish_num_(-1), block_count_(0) {}
+  Table() : tb_name_(""), record_length_(-1), first_block_num_(-1), first_rubbish_num_(-1), block_count_(0), layout_(LAYOUT_ROW), has_blocks_(true), has_zones_(true) {}
   ~Table() {}
 
   // Accessor and mutator for table name.
@@ -131,7 +159,10 @@ public:
 
   // Accessor and mutator for record length.
   int record_length() { return record_length_; }
-  void set_record_length(int len) { record_length_ = len; }
+  void set_record_length(int len) {
+    record_length_ = len;
+    offsets_.clear();
+  }
 
   // Accessor for the list of attributes.
   std::vector<Attribute> &ats() { return ats_; }
@@ -139,6 +170,41 @@ public:
   Attribute *GetAttribute(std::string name);
   // Retrieve the index of an attribute by name.
   int GetAttributeIndex(std::string name);
+  // Byte offset of the i-th attribute inside a record.
+  int GetAttributeOffset(int i) {
+    if (offsets_.size() != ats_.size()) {
+      ComputeOffsets();
+    }
+    return offsets_[i];
+  }
+  // Rebuild the attribute offsets and field addressing from the attribute
+  // list and the layout.
+  void ComputeOffsets();
+
+  // Accessor and mutator for the page layout.
+  int layout() { return layout_; }
+  void set_layout(int layout) {
+    layout_ = layout;
+    offsets_.clear();
+  }
+  // Maximum number of records stored in one block.
+  int GetMaxRecordCount() { return (4096 - 12) / record_length_; }
+  // Field i of record r is found at content + GetFieldBase(i) +
+  // r * GetFieldStride(i), where content follows the block header. In a
+  // columnar block the values of one attribute are packed in a minipage
+  // sized for a full block.
+  int GetFieldBase(int i) {
+    if (offsets_.size() != ats_.size()) {
+      ComputeOffsets();
+    }
+    return bases_[i];
+  }
+  int GetFieldStride(int i) {
+    if (offsets_.size() != ats_.size()) {
+      ComputeOffsets();
+    }
+    return strides_[i];
+  }
 
   // Accessors and mutators for block pointers and count.
   int first_block_num() { return first_block_num_; }
@@ -147,6 +213,45 @@ public:
   void set_first_rubbish_num(int num) { first_rubbish_num_ = num; }
   int block_count() { return block_count_; }
 
+  // Block directory: the blocks that hold records, in ascending block
+  // number, i.e. in the order they are stored in the file. Scans walk it
+  // instead of the prev/next chain, which lists the same blocks newest
+  // first. Rubbish blocks are not in it.
+  std::vector<int> &blocks() { return blocks_; }
+  bool has_blocks() { return has_blocks_; }
+  void set_blocks(std::vector<int> &blocks);
+  // Enter a block that received its first record. Both are no-ops while
+  // the directory still has to be rebuilt.
+  void AddBlock(int block_num);
+  // Drop a block that lost its last record.
+  void RemoveBlock(int block_num);
+
+  // Zone map: for each block, the lowest and the highest value of every
+  // attribute among its records, normalized as by NormalizeKey so that
+  // they compare with memcmp; strings are cut to ZONE_PREFIX_LEN bytes.
+  // The bounds of a block without records are empty, the low one above the
+  // high one. Deleting a record may leave them wider than needed until the
+  // block is summarized again; they never leave a record out.
+  bool has_zones() { return has_zones_; }
+  void set_has_zones(bool has_zones) { has_zones_ = has_zones; }
+  // The zone of a block, made empty the first time it is asked for: the
+  // low bound of attribute i at GetZoneOffset(i), the high one right after
+  // it. The address holds until the zone of a higher block is first asked
+  // for.
+  char *GetZone(int block_num);
+  void ClearZone(int block_num);
+  int GetZoneOffset(int i) {
+    if (offsets_.size() != ats_.size()) {
+      ComputeOffsets();
+    }
+    return zone_offsets_[i];
+  }
+  int GetZoneWidth(int i) {
+    return (GetZoneOffset(i + 1) - GetZoneOffset(i)) / 2;
+  }
+  // Bytes of the zone of a block.
+  int GetZoneSize() { return GetZoneOffset(ats_.size()); }
+
   // Get the number of attributes.
   unsigned long GetAttributeNum() { return ats_.size(); }
   // Add a new attribute (column) to the table.
@@ -164,6 +269,10 @@ public:
   void AddIndex(Index &idx) { ids_.push_back(idx); }
 };
 
+// Version 1 adds the page layout, version 2 the block directory, version 3
+// the zone map.
+BOOST_CLASS_VERSION(Table, 3)
+
 // Attribute: Represents a single column in a table with its name, type, and length.
 class Attribute {
 private:
@@ -224,6 +333,34 @@ private:
     ar &key_count_;
     ar &level_;
     ar &node_count_;
+    if (version >= 1) {
+      ar &unique_;
+    } else {
+      unique_ = true;
+    }
+    if (version >= 2) {
+      ar &attr_names_;
+    } else {
+      attr_names_.assign(1, attr_name_);
+    }
+    if (version >= 3) {
+      ar &method_;
+      ar &buckets_;
+    } else {
+      method_ = INDEX_BTREE;
+    }
+    if (version >= 4) {
+      ar &include_names_;
+    }
+    if (version >= 5) {
+      ar &values_;
+      ar &value_pages_;
+    }
+    if (version >= 6) {
+      ar &back_links_;
+    } else {
+      back_links_ = false;
+    }
   }
   int max_count_;  // Maximum number of keys a node can hold.
   int key_len_;    // Length in bytes of a key.
@@ -235,16 +372,26 @@ private:
   int key_count_;  // Current number of keys in the index.
   int level_;      // Height (number of levels) in the B+ tree.
   int node_count_; // Total number of nodes in the tree.
+  bool unique_;    // Each key is held once; else keys carry the record id.
+  bool back_links_; // Every leaf links to the previous one.
   std::string attr_name_; // The attribute name this index is built on.
+  std::vector<std::string> attr_names_; // All key attributes, attr_name_ first.
+  int method_;                // INDEX_BTREE, INDEX_HASH or INDEX_BITMAP.
+  std::vector<int> buckets_;  // First block of each bucket of a hash index.
+  std::vector<std::string> include_names_; // Attributes carried after the key.
+  std::vector<std::string> values_; // Values of a bitmap index, normalized.
+  // For each of them, the page of each group of table blocks, or -1.
+  std::vector<std::vector<int> > value_pages_;
   std::string name_;      // The name of the index itself.
 
 public:
   // Default constructor.
   Index() {}
   // Constructor to initialize an index with specific properties.
-  Index(std::string name, std::string attr_name, int keytype, int keylen,
-        int rank) {
-    attr_name_ = attr_name;
+  Index(std::string name, std::vector<std::string> attr_names, int keytype,
+        int keylen, int rank, bool unique, int method = INDEX_BTREE) {
+    attr_name_ = attr_names[0];
+    attr_names_ = attr_names;
     name_ = name;
     key_count_ = 0;
     level_ = -1;
@@ -256,10 +403,21 @@ public:
     rank_ = rank;
     rubbish_ = -1;
     max_count_ = 0;
+    unique_ = unique;
+    back_links_ = true;
+    method_ = method;
   }
 
-  // Accessor for the attribute name of the index.
+  // Accessor for the attribute name of the index, the leading one of a key
+  // over several attributes.
   std::string attr_name() { return attr_name_; }
+  // The key attributes, most significant first.
+  std::vector<std::string> &attr_names() { return attr_names_; }
+  // The attributes whose values the entries carry without ordering by them.
+  std::vector<std::string> &include_names() { return include_names_; }
+  void set_include_names(std::vector<std::string> &names) {
+    include_names_ = names;
+  }
   // Accessor for the key length.
   int key_len() { return key_len_; }
   // Accessor for the key type.
@@ -283,6 +441,21 @@ public:
   void set_node_count(int node_count) { node_count_ = node_count; }
   // Accessor for the index name.
   std::string name() { return name_; }
+  // True for the index on the primary key, which holds each key once.
+  bool unique() { return unique_; }
+  // False for a B+ tree saved before leaves linked back, whose leaves may
+  // not: it can only be walked forward.
+  bool back_links() { return back_links_; }
+  // How the entries are organized: INDEX_BTREE, INDEX_HASH or INDEX_BITMAP.
+  int method() { return method_; }
+  // Accessor and mutator for the head of the list of free blocks.
+  int rubbish() { return rubbish_; }
+  void set_rubbish(int rubbish) { rubbish_ = rubbish; }
+  // The first block of each bucket of a hash index, by bucket number.
+  std::vector<int> &buckets() { return buckets_; }
+  // The values a bitmap index has met, and where their bitmaps lie.
+  std::vector<std::string> &values() { return values_; }
+  std::vector<std::vector<int> > &value_pages() { return value_pages_; }
 
   // Methods to increase/decrease various counters.
   int IncreaseMaxCount() { return max_count_++; }
@@ -295,4 +468,9 @@ public:
   int DecreaseLevel() { return level_--; }
 };
 
+// Version 1 adds non-unique indexes, version 2 keys over several attributes,
+// version 3 hash indexes, version 4 included attributes, version 5 bitmap
+// indexes, version 6 marks the B+ trees whose leaves link back.
+BOOST_CLASS_VERSION(Index, 6)
+
 #endif
@@ -9,6 +9,19 @@
 #define T_INT 0
 #define T_FLOAT 1
 #define T_CHAR 2
+#define T_BYTES 3 // Index keys encoded to compare bytewise
+
+// Index Method
+#define INDEX_BTREE 0 // B+ tree: ordered, serves ranges
+#define INDEX_HASH 1  // linear hashing: equality lookups only
+#define INDEX_BITMAP 2 // one record id bitmap per value
+
+// Page Layout
+#define LAYOUT_ROW 0      // records stored one after another
+#define LAYOUT_COLUMNAR 1 // PAX: one minipage per attribute
+
+// Zone Map
+#define ZONE_PREFIX_LEN 8 // bytes of a string a block bound keeps
 
 //=	<>	<	>	<=	>=
 #define SIGN_EQ 0 // ==	Equals
@@ -18,4 +31,11 @@
 #define SIGN_LE 4 // <=	Less or equal
 #define SIGN_GE 5 // >=	Greater or equal
 
+// Aggregate Function
+#define AGG_COUNT 0
+#define AGG_SUM 1
+#define AGG_MIN 2
+#define AGG_MAX 3
+#define AGG_AVG 4
+
 #endif
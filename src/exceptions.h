@@ -15,16 +15,18 @@ class TableNotExistException : public std::exception {};
 
 class TableAlreadyExistsException : public std::exception {};
 
+class AttributeNotExistException : public std::exception {};
+
 class IndexAlreadyExistsException : public std::exception {};
 
 class IndexNotExistException : public std::exception {};
 
-class OneIndexEachTableException : public std::exception {};
-
 class BPlusTreeException : public std::exception {};
 
-class IndexMustBeCreatedOnPKException : public std::exception {};
-
 class PrimaryKeyConflictException : public std::exception {};
 
+class IndexEntryInvalidException : public std::exception {};
+
+class SpillFileException : public std::exception {};
+
 #endif
@@ -0,0 +1,2292 @@
+#include "executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#include "bitmap_index.h"
+#include "exceptions.h"
+#include "filter_kernels.h"
+#include "hash_index.h"
+#include "index_manager.h"
+#include "record_manager.h"
+#include "spill_manager.h"
+#include "tuple_view.h"
+
+using namespace std;
+
+namespace {
+
+// Equality of two join keys of the same type. CHAR columns may differ in
+// length; the shorter value must then end where the longer one does.
+bool KeysEqual(int data_type, const char *a, int alen, const char *b,
+               int blen) {
+  switch (data_type) {
+  case T_INT: {
+    int x, y;
+    memcpy(&x, a, 4);
+    memcpy(&y, b, 4);
+    return x == y;
+  }
+  case T_FLOAT: {
+    float x, y;
+    memcpy(&x, a, 4);
+    memcpy(&y, b, 4);
+    return x == y;
+  }
+  case T_CHAR: {
+    int len = min(alen, blen);
+    if (strncmp(a, b, len) != 0) {
+      return false;
+    }
+    if (alen > len) {
+      return a[len] == 0;
+    }
+    if (blen > len) {
+      return b[len] == 0;
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// Run the WHERE terms over the `count` records of a block, one bit per
+// record in `mask`.
+void FilterRecords(Table *tbl, Predicate &pred, const char *content, int count,
+                   std::vector<uint64_t> &mask) {
+  mask.resize((count + 63) / 64);
+  if (count == 0) {
+    return;
+  }
+  FillSelectionMask(&mask[0], count);
+  std::vector<PredicateTerm> &terms = pred.terms();
+  for (unsigned int i = 0; i < terms.size(); ++i) {
+    PredicateTerm &t = terms[i];
+    Predicate::ApplyTerm(t, content + tbl->GetFieldBase(t.attr),
+                         tbl->GetFieldStride(t.attr), count, &mask[0]);
+  }
+}
+
+// Append the selected records of a block, from `row` on, to the batch until
+// either is exhausted, copying the listed columns out of the page a column
+// at a time. Returns the row to resume from.
+int EmitRecords(Table *tbl, std::vector<int> &cols, const char *content,
+                int count, int block_num, int row, std::vector<uint64_t> &mask,
+                Batch &batch) {
+  int first = batch.count();
+  for (; row < count && !batch.full(); ++row) {
+    if ((mask[row >> 6] >> (row & 63)) & 1) {
+      batch.AddRow((block_num << 16) | row);
+    }
+  }
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    ColumnVector &col = batch.col(i);
+    const char *field = content + tbl->GetFieldBase(cols[i]);
+    int stride = tbl->GetFieldStride(cols[i]);
+    int width = col.width();
+    for (int r = first; r < batch.count(); ++r) {
+      memcpy(col.At(r), field + (batch.rid(r) & 0xffff) * stride, width);
+    }
+  }
+  return row;
+}
+
+// Number of directory entries from `pos` on, before `end`, that name
+// consecutive blocks and can be read together.
+int RunLength(std::vector<int> &blocks, int pos, int end) {
+  int n = 1;
+  while (n < READ_RUN_BLOCKS && pos + n < end &&
+         blocks[pos + n] == blocks[pos] + n) {
+    ++n;
+  }
+  return n;
+}
+
+// FNV-1a over some bytes, mixed so that both the high bits (partition) and
+// the low bits (bucket) depend on all of them.
+uint32_t HashBytes(const char *data, int len) {
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < len; ++i) {
+    h = (h ^ (unsigned char)data[i]) * 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+// Hash of a join key, consistent with KeysEqual: CHAR values are hashed up
+// to their terminator and both zeros of a FLOAT hash alike.
+uint32_t HashKey(int data_type, const char *key, int width) {
+  if (data_type == T_CHAR) {
+    int len = 0;
+    while (len < width && key[len] != 0) {
+      ++len;
+    }
+    return HashBytes(key, len);
+  }
+  char bytes[4];
+  memcpy(bytes, key, 4);
+  if (data_type == T_FLOAT) {
+    float f;
+    memcpy(&f, key, 4);
+    if (f == 0) {
+      memset(bytes, 0, 4);
+    }
+  }
+  return HashBytes(bytes, 4);
+}
+
+// Order of two keys of the same type, consistent with KeysEqual.
+int CompareKeys(int data_type, const char *a, int alen, const char *b,
+                int blen) {
+  switch (data_type) {
+  case T_INT: {
+    int x, y;
+    memcpy(&x, a, 4);
+    memcpy(&y, b, 4);
+    return x < y ? -1 : (x > y ? 1 : 0);
+  }
+  case T_FLOAT: {
+    float x, y;
+    memcpy(&x, a, 4);
+    memcpy(&y, b, 4);
+    return x < y ? -1 : (x > y ? 1 : 0);
+  }
+  case T_CHAR: {
+    int len = min(alen, blen);
+    int c = strncmp(a, b, len);
+    if (c != 0) {
+      return c < 0 ? -1 : 1;
+    }
+    if (memchr(a, 0, len) != NULL) {
+      return 0;
+    }
+    if (alen > len && a[len] != 0) {
+      return 1;
+    }
+    if (blen > len && b[len] != 0) {
+      return -1;
+    }
+    return 0;
+  }
+  default:
+    return 0;
+  }
+}
+
+// Hash join partition of a hash, taken from its high bits.
+int PartitionOf(uint32_t hash) {
+  return (int)(((uint64_t)hash * HASH_JOIN_PARTITIONS) >> 32);
+}
+
+// Temporary file a spilled row goes to. Each level of splitting salts the
+// hash differently, so rows that shared a file get spread out again.
+int SpillPartitionOf(uint32_t hash, int level) {
+  uint32_t h = (hash ^ (0x9e3779b9u * (level + 1))) * 0x85ebca6bu;
+  h ^= h >> 15;
+  return h % SPILL_FANOUT;
+}
+
+// Overwrite row `o` of `to` with row `r` of `from`, both laid out for the
+// same schema.
+void SetRow(Batch &from, int r, Batch &to, int o) {
+  to.set_rid(o, from.rid(r));
+  for (unsigned int i = 0; i < from.GetColumnNum(); ++i) {
+    memcpy(to.col(i).At(o), from.col(i).At(r), from.col(i).width());
+  }
+}
+
+// Append row `r` of `from` to `to`.
+void CopyRow(Batch &from, int r, Batch &to) {
+  SetRow(from, r, to, to.AddRow(from.rid(r)));
+}
+
+// Run f(0) .. f(count - 1) on up to `num_threads` threads.
+template <typename F> void ParallelFor(int num_threads, int count, F f) {
+  int n = min(num_threads, count);
+  if (n <= 1) {
+    for (int i = 0; i < count; ++i) {
+      f(i);
+    }
+    return;
+  }
+  std::atomic<int> next(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n; ++t) {
+    threads.push_back(std::thread([&]() {
+      for (int i = next++; i < count; i = next++) {
+        f(i);
+      }
+    }));
+  }
+  for (int t = 0; t < n; ++t) {
+    threads[t].join();
+  }
+}
+
+// The record `rid` of block `bp`, found through an index. An entry past
+// the records of its block is left by a corrupt index, and is not read.
+TupleView GetIndexedTuple(RecordManager *rm, Table *tbl, BlockInfo *bp,
+                          int rid) {
+  int slot = rid & 0xffff;
+  if (slot >= bp->GetRecordCount()) {
+    throw IndexEntryInvalidException();
+  }
+  return rm->GetTuple(tbl, bp, slot);
+}
+
+// Copy the columns listed in `cols` of the records in `order`, pairs of a
+// record id and the row of `batch` it fills, visiting each block once.
+void FetchRows(RecordManager *rm, Table *tbl, std::vector<int> &cols,
+               std::vector<std::pair<int, int> > &order, Batch &batch) {
+  std::sort(order.begin(), order.end());
+  BlockInfo *bp = NULL;
+  for (unsigned int i = 0; i < order.size(); ++i) {
+    int rid = order[i].first;
+    int block_num = (rid >> 16) & 0xffff;
+    if (bp == NULL || bp->block_num() != block_num) {
+      bp = rm->GetBlockInfo(tbl, block_num);
+      rm->CountBlocksRead(1);
+    }
+    TupleView tuple = GetIndexedTuple(rm, tbl, bp, rid);
+    for (unsigned int c = 0; c < cols.size(); ++c) {
+      ColumnVector &col = batch.col(c);
+      memcpy(col.At(order[i].second), tuple.GetField(cols[c]), col.width());
+    }
+  }
+}
+
+} // namespace
+
+//=======================ColumnVector / Batch=======================//
+
+TKey ColumnVector::GetKey(int i) {
+  TKey tmp(data_type_, width_);
+  memcpy(tmp.key(), At(i), tmp.length());
+  return tmp;
+}
+
+void Batch::Init(std::vector<Attribute> &schema) {
+  cols_.clear();
+  cols_.reserve(schema.size());
+  for (unsigned int i = 0; i < schema.size(); ++i) {
+    cols_.push_back(ColumnVector(schema[i].data_type(), schema[i].length()));
+  }
+  rids_.assign(BATCH_SIZE, -1);
+  sel_.reserve(BATCH_SIZE);
+  Reset();
+}
+
+size_t Batch::GetMemorySize() {
+  size_t size = 0;
+  for (unsigned int i = 0; i < cols_.size(); ++i) {
+    size += (size_t)cols_[i].width() * BATCH_SIZE;
+  }
+  return size;
+}
+
+void Batch::Select(std::vector<uint64_t> &mask) {
+  unsigned int n = 0;
+  for (unsigned int i = 0; i < sel_.size(); ++i) {
+    int r = sel_[i];
+    if ((mask[r >> 6] >> (r & 63)) & 1) {
+      sel_[n++] = r;
+    }
+  }
+  sel_.resize(n);
+}
+
+void Batch::TakeColumns(Batch &from, std::vector<int> &cols) {
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    unsigned int j = find(cols.begin(), cols.begin() + i, cols[i]) -
+                     cols.begin();
+    if (j < i) {
+      cols_[i] = cols_[j];
+    } else {
+      swap(cols_[i], from.cols_[cols[i]]);
+    }
+  }
+  rids_.swap(from.rids_);
+  sel_.swap(from.sel_);
+  count_ = from.count_;
+  from.Reset();
+}
+
+//=======================TableScan=======================//
+
+TableScan::TableScan(RecordManager *rm, Table *tbl,
+                     std::vector<SQLWhere> &wheres)
+    : rm_(rm), tbl_(tbl), pred_(tbl, wheres), pos_(0), run_len_(0),
+      run_pos_(0), row_(0) {
+  schema_ = tbl->ats();
+  for (unsigned int i = 0; i < schema_.size(); ++i) {
+    cols_.push_back(i);
+  }
+}
+
+TableScan::TableScan(RecordManager *rm, Table *tbl,
+                     std::vector<SQLWhere> &wheres, std::vector<int> &cols)
+    : rm_(rm), tbl_(tbl), pred_(tbl, wheres), cols_(cols), pos_(0),
+      run_len_(0), run_pos_(0), row_(0) {
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    schema_.push_back(tbl->ats()[cols[i]]);
+  }
+}
+
+void TableScan::Open() {
+  blocks_ = rm_->GetBlocks(tbl_);
+  rm_->SkipBlocks(tbl_, pred_, blocks_);
+  pos_ = 0;
+  run_len_ = 0;
+  run_pos_ = 0;
+  row_ = 0;
+}
+
+bool TableScan::Next(Batch &batch) {
+  batch.Reset();
+  while (!batch.full()) {
+    if (run_pos_ == run_len_) {
+      // Read the next run. The copy stays valid whatever the parent does
+      // with the buffer between calls.
+      pos_ += run_len_;
+      if (pos_ >= blocks_.size()) {
+        run_len_ = 0;
+        run_pos_ = 0;
+        break;
+      }
+      run_len_ = RunLength(blocks_, pos_, blocks_.size());
+      run_.resize(run_len_ * 4 * 1024);
+      rm_->hdl()->ReadFileBlocks(rm_->db_name(), tbl_->tb_name(),
+                                 FORMAT_RECORD, blocks_[pos_], run_len_,
+                                 &run_[0]);
+      rm_->CountBlocksRead(run_len_);
+      run_pos_ = 0;
+      row_ = 0;
+    }
+    const char *block = &run_[run_pos_ * 4 * 1024];
+    int count;
+    memcpy(&count, block + 8, 4);
+    const char *content = block + 12;
+    if (row_ == 0) {
+      FilterRecords(tbl_, pred_, content, count, mask_);
+    }
+    row_ = EmitRecords(tbl_, cols_, content, count, blocks_[pos_ + run_pos_],
+                       row_, mask_, batch);
+    if (row_ == count) {
+      ++run_pos_;
+      row_ = 0;
+    }
+  }
+  return batch.count() > 0;
+}
+
+//=======================ParallelTableScan=======================//
+
+ParallelTableScan::ParallelTableScan(RecordManager *rm, Table *tbl,
+                                     std::vector<SQLWhere> &wheres,
+                                     std::vector<int> &cols, bool keep_order,
+                                     int num_threads)
+    : rm_(rm), tbl_(tbl), pred_(tbl, wheres), cols_(cols),
+      keep_order_(keep_order), num_threads_(num_threads), num_morsels_(0),
+      next_morsel_(0), next_emit_(0), emitted_(0), in_flight_(0),
+      stop_(false), current_pos_(0), has_current_(false) {
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    schema_.push_back(tbl->ats()[cols[i]]);
+  }
+  if (num_threads_ <= 0) {
+    num_threads_ = max(1, (int)thread::hardware_concurrency());
+  }
+}
+
+void ParallelTableScan::Open() {
+  Close();
+
+  // A directory or a zone map left by an old catalog is rebuilt through
+  // the buffer, so fetch them while the buffer is still ours alone.
+  blocks_ = rm_->GetBlocks(tbl_);
+  rm_->SkipBlocks(tbl_, pred_, blocks_);
+  // The field addressing is computed lazily; do it before it is shared.
+  tbl_->ComputeOffsets();
+
+  num_morsels_ = (blocks_.size() + MORSEL_BLOCKS - 1) / MORSEL_BLOCKS;
+  results_.assign(num_morsels_, std::vector<Batch *>());
+  done_.assign(num_morsels_, false);
+  ready_.clear();
+  next_morsel_ = 0;
+  next_emit_ = 0;
+  emitted_ = 0;
+  in_flight_ = 0;
+  stop_ = false;
+  int n = min(num_threads_, num_morsels_);
+  for (int i = 0; i < n; ++i) {
+    workers_.push_back(thread(&ParallelTableScan::Work, this));
+  }
+}
+
+void ParallelTableScan::Close() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (unsigned int i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+  workers_.clear();
+  FreeBatches();
+}
+
+void ParallelTableScan::FreeBatches() {
+  for (unsigned int i = current_pos_; i < current_.size(); ++i) {
+    delete current_[i];
+  }
+  current_.clear();
+  current_pos_ = 0;
+  has_current_ = false;
+  for (unsigned int m = 0; m < results_.size(); ++m) {
+    for (unsigned int i = 0; i < results_[m].size(); ++i) {
+      delete results_[m][i];
+    }
+    results_[m].clear();
+  }
+}
+
+void ParallelTableScan::Work() {
+  for (;;) {
+    int m;
+    {
+      unique_lock<mutex> lock(mutex_);
+      // Do not run too far ahead of the parent.
+      while (!stop_ && next_morsel_ < num_morsels_ &&
+             in_flight_ >= 2 * num_threads_) {
+        cv_.wait(lock);
+      }
+      if (stop_ || next_morsel_ == num_morsels_) {
+        return;
+      }
+      m = next_morsel_++;
+      ++in_flight_;
+    }
+
+    std::vector<Batch *> out;
+    ScanMorsel(m, out);
+
+    {
+      lock_guard<mutex> lock(mutex_);
+      results_[m].swap(out);
+      done_[m] = true;
+      if (!keep_order_) {
+        ready_.push_back(m);
+      }
+    }
+    cv_.notify_all();
+  }
+}
+
+void ParallelTableScan::ScanMorsel(int m, std::vector<Batch *> &out) {
+  std::vector<char> run;
+  std::vector<uint64_t> mask;
+  Batch *batch = NULL;
+  int end = min((m + 1) * MORSEL_BLOCKS, (int)blocks_.size());
+  for (int i = m * MORSEL_BLOCKS; i < end;) {
+    int len = RunLength(blocks_, i, end);
+    run.resize(len * 4 * 1024);
+    rm_->hdl()->ReadFileBlocks(rm_->db_name(), tbl_->tb_name(), FORMAT_RECORD,
+                               blocks_[i], len, &run[0]);
+    rm_->CountBlocksRead(len);
+    for (int j = 0; j < len; ++j, ++i) {
+      const char *block = &run[j * 4 * 1024];
+      int count;
+      memcpy(&count, block + 8, 4);
+      const char *content = block + 12;
+      FilterRecords(tbl_, pred_, content, count, mask);
+      int row = 0;
+      while (row < count) {
+        if (batch == NULL || batch->full()) {
+          batch = new Batch();
+          batch->Init(schema_);
+          out.push_back(batch);
+        }
+        row = EmitRecords(tbl_, cols_, content, count, blocks_[i], row, mask,
+                          *batch);
+      }
+    }
+  }
+  if (batch != NULL && batch->count() == 0) {
+    delete batch;
+    out.pop_back();
+  }
+}
+
+bool ParallelTableScan::Next(Batch &batch) {
+  batch.Reset();
+  for (;;) {
+    if (has_current_) {
+      if (current_pos_ < current_.size()) {
+        Batch *b = current_[current_pos_++];
+        batch.Swap(*b);
+        delete b;
+        return true;
+      }
+      current_.clear();
+      current_pos_ = 0;
+      has_current_ = false;
+      {
+        lock_guard<mutex> lock(mutex_);
+        --in_flight_;
+      }
+      cv_.notify_all();
+    }
+
+    unique_lock<mutex> lock(mutex_);
+    if (emitted_ == num_morsels_) {
+      return false;
+    }
+    int m;
+    if (keep_order_) {
+      while (!done_[next_emit_]) {
+        cv_.wait(lock);
+      }
+      m = next_emit_++;
+    } else {
+      while (ready_.empty()) {
+        cv_.wait(lock);
+      }
+      m = ready_.front();
+      ready_.pop_front();
+    }
+    ++emitted_;
+    current_.swap(results_[m]);
+    has_current_ = true;
+  }
+}
+
+//=======================IndexScan=======================//
+
+IndexScan::IndexScan(RecordManager *rm, Table *tbl, Index *idx,
+                     KeyRange &range, std::vector<int> &cols,
+                     bool descending)
+    : rm_(rm), tbl_(tbl), tree_(idx, rm->hdl(), rm->cm(), rm->db_name()),
+      range_(&tree_, range, descending), cols_(cols) {
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    schema_.push_back(tbl->ats()[cols[i]]);
+  }
+
+  // Lay out the fields of a key: a raw key is the field itself; else come
+  // the normalized key fields, the record id if values repeat, then the
+  // included fields as stored.
+  std::vector<int> offsets, types, key_cols;
+  if (idx->key_type() != T_BYTES) {
+    key_cols.push_back(tbl->GetAttributeIndex(idx->attr_name()));
+    offsets.push_back(0);
+    types.push_back(-1);
+  } else {
+    int len = 0;
+    for (unsigned int i = 0; i < idx->attr_names().size(); ++i) {
+      key_cols.push_back(tbl->GetAttributeIndex(idx->attr_names()[i]));
+      offsets.push_back(len);
+      types.push_back(tbl->ats()[key_cols.back()].data_type());
+      len += tbl->ats()[key_cols.back()].length();
+    }
+    if (!idx->unique()) {
+      len += 4;
+    }
+    for (unsigned int i = 0; i < idx->include_names().size(); ++i) {
+      key_cols.push_back(tbl->GetAttributeIndex(idx->include_names()[i]));
+      offsets.push_back(len);
+      types.push_back(-1);
+      len += tbl->ats()[key_cols.back()].length();
+    }
+  }
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    size_t k = std::find(key_cols.begin(), key_cols.end(), cols[i]) -
+               key_cols.begin();
+    if (k == key_cols.size()) {
+      key_offsets_.clear();
+      key_types_.clear();
+      break;
+    }
+    key_offsets_.push_back(offsets[k]);
+    key_types_.push_back(types[k]);
+  }
+}
+
+bool IndexScan::Next(Batch &batch) {
+  batch.Reset();
+  rids_.clear();
+  if (index_only()) {
+    keys_.clear();
+    if (!range_.Next(rids_, BATCH_SIZE, &keys_)) {
+      return false;
+    }
+    int key_len = tree_.idx()->key_len();
+    for (unsigned int i = 0; i < rids_.size(); ++i) {
+      int row = batch.AddRow(rids_[i]);
+      const char *key = &keys_[i * key_len];
+      for (unsigned int c = 0; c < cols_.size(); ++c) {
+        ColumnVector &col = batch.col(c);
+        if (key_types_[c] == -1) {
+          memcpy(col.At(row), key + key_offsets_[c], col.width());
+        } else {
+          DenormalizeKey(key_types_[c], key + key_offsets_[c], col.width(),
+                         col.At(row));
+        }
+      }
+    }
+    return true;
+  }
+  if (!range_.Next(rids_, BATCH_SIZE)) {
+    return false;
+  }
+  order_.clear();
+  for (unsigned int i = 0; i < rids_.size(); ++i) {
+    order_.push_back(std::make_pair(rids_[i], batch.AddRow(rids_[i])));
+  }
+
+  FetchRows(rm_, tbl_, cols_, order_, batch);
+  return true;
+}
+
+//=======================HashIndexScan=======================//
+
+HashIndexScan::HashIndexScan(RecordManager *rm, Table *tbl, Index *idx,
+                             KeyRange &range, std::vector<int> &cols)
+    : rm_(rm), tbl_(tbl), idx_(idx), key_(range.low), cols_(cols), pos_(0) {
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    schema_.push_back(tbl->ats()[cols[i]]);
+  }
+}
+
+void HashIndexScan::Open() {
+  vals_.clear();
+  pos_ = 0;
+  HashIndex hash(idx_, rm_->hdl(), rm_->db_name());
+  hash.Lookup(key_.key(), vals_);
+}
+
+bool HashIndexScan::Next(Batch &batch) {
+  batch.Reset();
+  if (pos_ == vals_.size()) {
+    return false;
+  }
+  order_.clear();
+  for (; pos_ < vals_.size() && batch.count() < BATCH_SIZE; ++pos_) {
+    order_.push_back(std::make_pair(vals_[pos_], batch.AddRow(vals_[pos_])));
+  }
+  FetchRows(rm_, tbl_, cols_, order_, batch);
+  return true;
+}
+
+//=======================BitmapScan=======================//
+
+BitmapScan::BitmapScan(RecordManager *rm, Table *tbl,
+                       std::vector<SQLWhere> &wheres, std::vector<int> &cols)
+    : rm_(rm), tbl_(tbl), wheres_(wheres), cols_(cols), pos_(0) {
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    schema_.push_back(tbl->ats()[cols[i]]);
+  }
+}
+
+void BitmapScan::Open() {
+  rids_.clear();
+  pos_ = 0;
+  RidBitmap result(tbl_->GetMaxRecordCount());
+  bool narrowed = false;
+  std::vector<Index *> negated; // Columns tested only with <>.
+  for (unsigned int i = 0; i < tbl_->GetIndexNum(); ++i) {
+    Index *idx = tbl_->GetIndex(i);
+    if (idx->method() != INDEX_BITMAP) {
+      continue;
+    }
+    bool tested = false, only_ne = true;
+    for (unsigned int j = 0; j < wheres_.size(); ++j) {
+      if (wheres_[j].key == idx->attr_name()) {
+        tested = true;
+        only_ne = only_ne && wheres_[j].sign_type == SIGN_NE;
+      }
+    }
+    if (!tested) {
+      continue;
+    }
+    if (only_ne) {
+      negated.push_back(idx);
+      continue;
+    }
+    BitmapIndex bitmap(tbl_, idx, rm_->hdl(), rm_->db_name());
+    RidBitmap match(bitmap.slots());
+    bitmap.Match(wheres_, false, match);
+    if (narrowed) {
+      result.And(match);
+    } else {
+      result.Or(match);
+      narrowed = true;
+    }
+  }
+  for (unsigned int i = 0; i < negated.size(); ++i) {
+    BitmapIndex bitmap(tbl_, negated[i], rm_->hdl(), rm_->db_name());
+    RidBitmap match(bitmap.slots());
+    bitmap.Match(wheres_, narrowed, match);
+    if (!narrowed) {
+      result.Or(match);
+      narrowed = true;
+    } else {
+      result.AndNot(match);
+    }
+  }
+  result.GetRids(rids_);
+}
+
+bool BitmapScan::Next(Batch &batch) {
+  batch.Reset();
+  if (pos_ == rids_.size()) {
+    return false;
+  }
+  order_.clear();
+  for (; pos_ < rids_.size() && batch.count() < BATCH_SIZE; ++pos_) {
+    order_.push_back(std::make_pair(rids_[pos_], batch.AddRow(rids_[pos_])));
+  }
+  FetchRows(rm_, tbl_, cols_, order_, batch);
+  return true;
+}
+
+//=======================Filter=======================//
+
+Filter::Filter(Operator *child, std::vector<SQLWhere> &wheres)
+    : child_(child), pred_(child->schema(), wheres) {
+  schema_ = child->schema();
+}
+
+bool Filter::Next(Batch &batch) {
+  std::vector<PredicateTerm> &terms = pred_.terms();
+  while (child_->Next(batch)) {
+    if (terms.empty()) {
+      return true;
+    }
+    // Only rows still selected start with their bit set, so the kernels,
+    // which run over the whole column, cannot bring dropped rows back.
+    mask_.assign((batch.count() + 63) / 64, 0);
+    for (int i = 0; i < batch.sel_count(); ++i) {
+      int r = batch.sel(i);
+      mask_[r >> 6] |= (uint64_t)1 << (r & 63);
+    }
+    for (unsigned int i = 0; i < terms.size(); ++i) {
+      ColumnVector &col = batch.col(terms[i].attr);
+      Predicate::ApplyTerm(terms[i], col.data(), col.width(), batch.count(),
+                           &mask_[0]);
+    }
+    batch.Select(mask_);
+    if (batch.sel_count() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//=======================Project=======================//
+
+Project::Project(Operator *child, std::vector<int> &cols)
+    : child_(child), cols_(cols) {
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    schema_.push_back(child->schema()[cols[i]]);
+  }
+  in_.Init(child->schema());
+}
+
+bool Project::Next(Batch &batch) {
+  if (!child_->Next(in_)) {
+    batch.Reset();
+    return false;
+  }
+  batch.TakeColumns(in_, cols_);
+  return true;
+}
+
+//=======================Limit=======================//
+
+Limit::Limit(Operator *child, long limit, long offset)
+    : child_(child), limit_(limit), offset_(offset), skipped_(0),
+      emitted_(0) {
+  schema_ = child->schema();
+}
+
+void Limit::Open() {
+  skipped_ = 0;
+  emitted_ = 0;
+  // Nothing to read for LIMIT 0.
+  if (limit_ != 0) {
+    child_->Open();
+  }
+}
+
+void Limit::Close() {
+  if (limit_ != 0) {
+    child_->Close();
+  }
+}
+
+bool Limit::Next(Batch &batch) {
+  batch.Reset();
+  while (limit_ == -1 || emitted_ < limit_) {
+    if (!child_->Next(batch)) {
+      return false;
+    }
+    std::vector<int> &sel = batch.sel();
+    long skip = min(offset_ - skipped_, (long)sel.size());
+    sel.erase(sel.begin(), sel.begin() + skip);
+    skipped_ += skip;
+    if (limit_ != -1 && emitted_ + (long)sel.size() > limit_) {
+      sel.resize(limit_ - emitted_);
+    }
+    emitted_ += sel.size();
+    if (!sel.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//=======================HashJoin=======================//
+
+HashJoin::HashJoin(Operator *left, Operator *right, int left_col,
+                   int right_col, bool build_left, SpillManager *spill,
+                   int num_threads)
+    : left_(left), right_(right), left_col_(left_col), right_col_(right_col),
+      build_left_(build_left), spill_(spill), num_threads_(num_threads),
+      reserved_(0), out_batch_(0), out_pos_(0), probe_done_(true),
+      grace_(false), probe_file_(NULL) {
+  schema_ = left->schema();
+  schema_.insert(schema_.end(), right->schema().begin(),
+                 right->schema().end());
+  if (num_threads_ <= 0) {
+    num_threads_ = max(1, (int)thread::hardware_concurrency());
+  }
+}
+
+HashJoin::~HashJoin() {
+  ClearOutput();
+  ClearBuild();
+  ClearSpill();
+  for (unsigned int i = 0; i < probe_.size(); ++i) {
+    delete probe_[i];
+  }
+  delete left_;
+  delete right_;
+}
+
+void HashJoin::ClearBuild() {
+  for (unsigned int i = 0; i < build_.size(); ++i) {
+    delete build_[i];
+  }
+  build_.clear();
+  parts_.clear();
+  if (spill_ != NULL) {
+    spill_->Release(reserved_);
+  }
+  reserved_ = 0;
+}
+
+void HashJoin::ClearOutput() {
+  for (unsigned int i = 0; i < out_.size(); ++i) {
+    for (unsigned int j = 0; j < out_[i].size(); ++j) {
+      delete out_[i][j];
+    }
+  }
+  out_.clear();
+  out_batch_ = 0;
+  out_pos_ = 0;
+}
+
+void HashJoin::ClearSpill() {
+  for (unsigned int i = 0; i < pending_.size(); ++i) {
+    delete pending_[i].build;
+    delete pending_[i].probe;
+  }
+  pending_.clear();
+  delete probe_file_;
+  probe_file_ = NULL;
+  grace_ = false;
+}
+
+void HashJoin::Open() {
+  ClearOutput();
+  ClearBuild();
+  ClearSpill();
+  probe_done_ = false;
+  if (ReadBuild()) {
+    BuildTable();
+    probe_input()->Open();
+  } else if (!LoadPartition()) {
+    probe_done_ = true;
+  }
+}
+
+void HashJoin::Close() {
+  if (!grace_) {
+    probe_input()->Close();
+  }
+  probe_done_ = true;
+  ClearOutput();
+  ClearBuild();
+  ClearSpill();
+}
+
+bool HashJoin::ReadBuild() {
+  Operator *in = build_input();
+  in->Open();
+  std::vector<SpillFile *> files;
+  Batch *b = new Batch();
+  b->Init(in->schema());
+  while (in->Next(*b)) {
+    if (files.empty()) {
+      if (spill_ == NULL || spill_->Reserve(b->GetMemorySize())) {
+        reserved_ += b->GetMemorySize();
+        build_.push_back(b);
+        b = new Batch();
+        b->Init(in->schema());
+        continue;
+      }
+      // Out of memory: from now on every build row goes to a file.
+      for (int i = 0; i < SPILL_FANOUT; ++i) {
+        files.push_back(spill_->CreateFile(in->schema()));
+      }
+      for (unsigned int i = 0; i < build_.size(); ++i) {
+        SpillRows(*build_[i], build_col(), 0, files);
+      }
+      ClearBuild();
+    }
+    SpillRows(*b, build_col(), 0, files);
+  }
+  delete b;
+  in->Close();
+  if (files.empty()) {
+    return true;
+  }
+
+  // Split the probe input the same way.
+  grace_ = true;
+  Operator *probe = probe_input();
+  std::vector<SpillFile *> probe_files;
+  for (int i = 0; i < SPILL_FANOUT; ++i) {
+    probe_files.push_back(spill_->CreateFile(probe->schema()));
+  }
+  Batch pb;
+  pb.Init(probe->schema());
+  probe->Open();
+  while (probe->Next(pb)) {
+    SpillRows(pb, probe_col(), 0, probe_files);
+  }
+  probe->Close();
+  AddPairs(files, probe_files, 0);
+  return false;
+}
+
+void HashJoin::SpillRows(Batch &batch, int col, int level,
+                         std::vector<SpillFile *> &files) {
+  ColumnVector &key = batch.col(col);
+  for (int i = 0; i < batch.sel_count(); ++i) {
+    int r = batch.sel(i);
+    uint32_t hash = HashKey(key.data_type(), key.At(r), key.width());
+    files[SpillPartitionOf(hash, level)]->WriteRow(batch, r);
+  }
+}
+
+void HashJoin::AddPairs(std::vector<SpillFile *> &build,
+                        std::vector<SpillFile *> &probe, int level) {
+  for (unsigned int i = 0; i < build.size(); ++i) {
+    // An inner join of an empty side produces nothing.
+    if (build[i]->rows() == 0 || probe[i]->rows() == 0) {
+      delete build[i];
+      delete probe[i];
+      continue;
+    }
+    SpillPair pair;
+    pair.build = build[i];
+    pair.probe = probe[i];
+    pair.level = level;
+    pending_.push_back(pair);
+  }
+}
+
+bool HashJoin::LoadPartition() {
+  delete probe_file_;
+  probe_file_ = NULL;
+  ClearBuild();
+  while (!pending_.empty()) {
+    SpillPair pair = pending_.back();
+    pending_.pop_back();
+    size_t size = pair.build->GetMemorySize();
+    if (spill_->Reserve(size)) {
+      reserved_ = size;
+    } else if (pair.level + 1 < SPILL_MAX_LEVEL) {
+      // Still too large: split both files again.
+      std::vector<SpillFile *> build, probe;
+      for (int i = 0; i < SPILL_FANOUT; ++i) {
+        build.push_back(spill_->CreateFile(build_input()->schema()));
+        probe.push_back(spill_->CreateFile(probe_input()->schema()));
+      }
+      Batch b;
+      b.Init(build_input()->schema());
+      pair.build->Rewind();
+      while (pair.build->Read(b)) {
+        SpillRows(b, build_col(), pair.level + 1, build);
+      }
+      Batch p;
+      p.Init(probe_input()->schema());
+      pair.probe->Rewind();
+      while (pair.probe->Read(p)) {
+        SpillRows(p, probe_col(), pair.level + 1, probe);
+      }
+      delete pair.build;
+      delete pair.probe;
+      AddPairs(build, probe, pair.level + 1);
+      continue;
+    }
+    // Otherwise, e.g. for a single key with too many rows, the partition is
+    // joined in memory regardless of the budget.
+
+    pair.build->Rewind();
+    for (;;) {
+      Batch *b = new Batch();
+      b->Init(build_input()->schema());
+      if (!pair.build->Read(*b)) {
+        delete b;
+        break;
+      }
+      build_.push_back(b);
+    }
+    delete pair.build;
+    BuildTable();
+    probe_file_ = pair.probe;
+    probe_file_->Rewind();
+    return true;
+  }
+  return false;
+}
+
+void HashJoin::BuildTable() {
+  // Scatter: every thread hashes its share of the batches into private
+  // partition lists.
+  int col = build_col();
+  int n = max(1, min(num_threads_, (int)build_.size()));
+  std::vector<std::vector<std::vector<Entry> > > local(
+      n, std::vector<std::vector<Entry> >(HASH_JOIN_PARTITIONS));
+  ParallelFor(n, n, [&](int t) {
+    for (unsigned int b = t; b < build_.size(); b += n) {
+      Batch &batch = *build_[b];
+      ColumnVector &key = batch.col(col);
+      for (int i = 0; i < batch.sel_count(); ++i) {
+        Entry e;
+        e.batch = b;
+        e.row = batch.sel(i);
+        e.hash = HashKey(key.data_type(), key.At(e.row), key.width());
+        local[t][PartitionOf(e.hash)].push_back(e);
+      }
+    }
+  });
+
+  // Build: every partition gathers its entries and chains them per bucket.
+  parts_.assign(HASH_JOIN_PARTITIONS, Partition());
+  ParallelFor(n, HASH_JOIN_PARTITIONS, [&](int p) {
+    Partition &part = parts_[p];
+    for (int t = 0; t < n; ++t) {
+      part.entries.insert(part.entries.end(), local[t][p].begin(),
+                          local[t][p].end());
+    }
+    unsigned int buckets = 1;
+    while (buckets < part.entries.size()) {
+      buckets <<= 1;
+    }
+    part.heads.assign(buckets, -1);
+    part.next.resize(part.entries.size());
+    for (unsigned int e = 0; e < part.entries.size(); ++e) {
+      int h = part.entries[e].hash & (buckets - 1);
+      part.next[e] = part.heads[h];
+      part.heads[h] = e;
+    }
+  });
+}
+
+void HashJoin::ProbeBatch(Batch &in, std::vector<Batch *> &out) {
+  int pcol = probe_col();
+  int bcol = build_col();
+  ColumnVector &pkey = in.col(pcol);
+  Batch *o = NULL;
+  for (int i = 0; i < in.sel_count(); ++i) {
+    int r = in.sel(i);
+    uint32_t hash = HashKey(pkey.data_type(), pkey.At(r), pkey.width());
+    Partition &part = parts_[PartitionOf(hash)];
+    if (part.entries.empty()) {
+      continue;
+    }
+    int e = part.heads[hash & (part.heads.size() - 1)];
+    for (; e != -1; e = part.next[e]) {
+      Entry &entry = part.entries[e];
+      Batch &b = *build_[entry.batch];
+      ColumnVector &bkey = b.col(bcol);
+      if (entry.hash != hash ||
+          !KeysEqual(pkey.data_type(), pkey.At(r), pkey.width(),
+                     bkey.At(entry.row), bkey.width())) {
+        continue;
+      }
+      if (o == NULL || o->full()) {
+        o = new Batch();
+        o->Init(schema_);
+        out.push_back(o);
+      }
+      int row = o->AddRow(-1);
+      Batch &lb = build_left_ ? b : in;
+      Batch &rb = build_left_ ? in : b;
+      int lr = build_left_ ? entry.row : r;
+      int rr = build_left_ ? r : entry.row;
+      int nleft = lb.GetColumnNum();
+      for (int c = 0; c < nleft; ++c) {
+        memcpy(o->col(c).At(row), lb.col(c).At(lr), lb.col(c).width());
+      }
+      for (unsigned int c = 0; c < rb.GetColumnNum(); ++c) {
+        memcpy(o->col(nleft + c).At(row), rb.col(c).At(rr), rb.col(c).width());
+      }
+    }
+  }
+}
+
+bool HashJoin::ReadProbe(Batch &batch) {
+  if (grace_) {
+    return probe_file_ != NULL && probe_file_->Read(batch);
+  }
+  return probe_input()->Next(batch);
+}
+
+bool HashJoin::Next(Batch &batch) {
+  batch.Reset();
+  for (;;) {
+    if (out_batch_ < out_.size()) {
+      std::vector<Batch *> &out = out_[out_batch_];
+      if (out_pos_ < out.size()) {
+        Batch *b = out[out_pos_];
+        out[out_pos_++] = NULL;
+        batch.Swap(*b);
+        delete b;
+        return true;
+      }
+      ++out_batch_;
+      out_pos_ = 0;
+      continue;
+    }
+    if (probe_done_) {
+      return false;
+    }
+
+    // Pull the next group of probe batches and probe them side by side. A
+    // group never spans two spilled partitions: they use different tables.
+    ClearOutput();
+    int n = 0;
+    while (n < num_threads_) {
+      if (n == (int)probe_.size()) {
+        probe_.push_back(new Batch());
+        probe_.back()->Init(probe_input()->schema());
+      }
+      if (ReadProbe(*probe_[n])) {
+        ++n;
+        continue;
+      }
+      if (grace_ && n == 0 && LoadPartition()) {
+        continue;
+      }
+      if (!grace_ || n == 0) {
+        probe_done_ = true;
+      }
+      break;
+    }
+    out_.assign(n, std::vector<Batch *>());
+    ParallelFor(num_threads_, n,
+                [&](int i) { ProbeBatch(*probe_[i], out_[i]); });
+  }
+}
+
+//=======================IndexJoin=======================//
+
+IndexJoin::IndexJoin(Operator *outer, RecordManager *rm, Table *tbl,
+                     Index *idx, int outer_col, bool outer_left)
+    : outer_(outer), rm_(rm), tbl_(tbl), idx_(idx), outer_col_(outer_col),
+      outer_left_(outer_left), pos_(0), done_(true) {
+  schema_ = outer_left ? outer->schema() : tbl->ats();
+  std::vector<Attribute> &right = outer_left ? tbl->ats() : outer->schema();
+  schema_.insert(schema_.end(), right.begin(), right.end());
+  in_.Init(outer->schema());
+}
+
+void IndexJoin::Open() {
+  outer_->Open();
+  matches_.clear();
+  pos_ = 0;
+  done_ = false;
+}
+
+bool IndexJoin::Probe() {
+  BPlusTree tree(idx_, rm_->hdl(), rm_->cm(), rm_->db_name());
+  ColumnVector &col = in_.col(outer_col_);
+  int key_len = idx_->key_len();
+  std::vector<int> rows, order, vals;
+  std::vector<TKey> keys;
+  matches_.clear();
+  pos_ = 0;
+  while (matches_.empty()) {
+    if (!outer_->Next(in_)) {
+      return false;
+    }
+    if (idx_->root() == -1) {
+      continue;
+    }
+
+    // Keys of the live rows, zero padded to the key length. A CHAR value
+    // longer than the key cannot match any.
+    rows.clear();
+    for (int i = 0; i < in_.sel_count(); ++i) {
+      int r = in_.sel(i);
+      if (col.width() > key_len && col.At(r)[key_len] != 0) {
+        continue;
+      }
+      rows.push_back(r);
+    }
+    order.resize(rows.size());
+    for (unsigned int i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    int type = col.data_type();
+    int width = col.width();
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return CompareKeys(type, col.At(rows[a]), width, col.At(rows[b]),
+                         width) < 0;
+    });
+    keys.assign(rows.size(), TKey(idx_->key_type(), key_len));
+    for (unsigned int i = 0; i < order.size(); ++i) {
+      memset(keys[i].key(), 0, keys[i].length());
+      memcpy(keys[i].key(), col.At(rows[order[i]]),
+             min(width, keys[i].length()));
+    }
+
+    tree.GetVals(keys, vals);
+    for (unsigned int i = 0; i < vals.size(); ++i) {
+      if (vals[i] != -1) {
+        matches_.push_back(std::make_pair(vals[i], rows[order[i]]));
+      }
+    }
+    std::sort(matches_.begin(), matches_.end());
+  }
+  return true;
+}
+
+bool IndexJoin::Next(Batch &batch) {
+  batch.Reset();
+  int nleft = outer_left_ ? in_.GetColumnNum() : tbl_->GetAttributeNum();
+  int inner_base = outer_left_ ? nleft : 0;
+  int outer_base = outer_left_ ? 0 : nleft;
+  BlockInfo *bp = NULL;
+  while (!batch.full()) {
+    if (pos_ == matches_.size()) {
+      if (done_ || !Probe()) {
+        done_ = true;
+        break;
+      }
+      // The lookups may have evicted the block.
+      bp = NULL;
+      continue;
+    }
+    int rid = matches_[pos_].first;
+    int r = matches_[pos_++].second;
+    int block_num = (rid >> 16) & 0xffff;
+    if (bp == NULL || bp->block_num() != block_num) {
+      bp = rm_->GetBlockInfo(tbl_, block_num);
+    }
+    TupleView tuple = GetIndexedTuple(rm_, tbl_, bp, rid);
+    int o = batch.AddRow(-1);
+    for (unsigned int c = 0; c < tbl_->GetAttributeNum(); ++c) {
+      ColumnVector &out = batch.col(inner_base + c);
+      memcpy(out.At(o), tuple.GetField(c), out.width());
+    }
+    for (unsigned int c = 0; c < in_.GetColumnNum(); ++c) {
+      ColumnVector &out = batch.col(outer_base + c);
+      memcpy(out.At(o), in_.col(c).At(r), out.width());
+    }
+  }
+  return batch.count() > 0;
+}
+
+//=======================MergeJoin=======================//
+
+MergeJoin::MergeJoin(Operator *left, Operator *right, int left_col,
+                     int right_col)
+    : left_col_(left_col), right_col_(right_col), group_batch_(0),
+      group_row_(0) {
+  left_.in = left;
+  right_.in = right;
+  left_.batch.Init(left->schema());
+  right_.batch.Init(right->schema());
+  left_.pos = right_.pos = 0;
+  left_.done = right_.done = true;
+  schema_ = left->schema();
+  schema_.insert(schema_.end(), right->schema().begin(),
+                 right->schema().end());
+}
+
+MergeJoin::~MergeJoin() {
+  ClearGroup();
+  delete left_.in;
+  delete right_.in;
+}
+
+void MergeJoin::ClearGroup() {
+  for (unsigned int i = 0; i < group_.size(); ++i) {
+    delete group_[i];
+  }
+  group_.clear();
+  group_batch_ = 0;
+  group_row_ = 0;
+}
+
+void MergeJoin::Open() {
+  ClearGroup();
+  Cursor *cursors[] = {&left_, &right_};
+  for (int i = 0; i < 2; ++i) {
+    cursors[i]->in->Open();
+    cursors[i]->batch.Reset();
+    cursors[i]->pos = 0;
+    cursors[i]->done = false;
+  }
+}
+
+void MergeJoin::Close() {
+  left_.in->Close();
+  right_.in->Close();
+  left_.done = right_.done = true;
+  ClearGroup();
+}
+
+bool MergeJoin::Fetch(Cursor &c) {
+  while (!c.done && c.pos == c.batch.sel_count()) {
+    c.pos = 0;
+    if (!c.in->Next(c.batch)) {
+      c.done = true;
+    }
+  }
+  return !c.done;
+}
+
+void MergeJoin::ReadGroup() {
+  ColumnVector &first = right_.batch.col(right_col_);
+  int type = first.data_type();
+  int width = first.width();
+  char *key = first.At(right_.batch.sel(right_.pos));
+  key_.assign(key, key + width);
+  Batch *b = NULL;
+  while (Fetch(right_)) {
+    int r = right_.batch.sel(right_.pos);
+    if (CompareKeys(type, right_.batch.col(right_col_).At(r), width, &key_[0],
+                    width) != 0) {
+      break;
+    }
+    if (b == NULL || b->full()) {
+      b = new Batch();
+      b->Init(right_.in->schema());
+      group_.push_back(b);
+    }
+    CopyRow(right_.batch, r, *b);
+    ++right_.pos;
+  }
+  group_batch_ = 0;
+  group_row_ = 0;
+}
+
+bool MergeJoin::Next(Batch &batch) {
+  batch.Reset();
+  int nleft = left_.batch.GetColumnNum();
+  while (!batch.full()) {
+    if (!group_.empty()) {
+      // Pair the current left row with the next row of the group.
+      Batch &lb = left_.batch;
+      Batch &rb = *group_[group_batch_];
+      int lr = lb.sel(left_.pos);
+      int o = batch.AddRow(-1);
+      for (int c = 0; c < nleft; ++c) {
+        memcpy(batch.col(c).At(o), lb.col(c).At(lr), lb.col(c).width());
+      }
+      for (unsigned int c = 0; c < rb.GetColumnNum(); ++c) {
+        memcpy(batch.col(nleft + c).At(o), rb.col(c).At(group_row_),
+               rb.col(c).width());
+      }
+      if (++group_row_ < rb.count()) {
+        continue;
+      }
+      group_row_ = 0;
+      if (++group_batch_ < (int)group_.size()) {
+        continue;
+      }
+      group_batch_ = 0;
+      // The next left row may have the same key.
+      ++left_.pos;
+      if (!Fetch(left_)) {
+        ClearGroup();
+        continue;
+      }
+      ColumnVector &lkey = left_.batch.col(left_col_);
+      if (CompareKeys(lkey.data_type(), lkey.At(left_.batch.sel(left_.pos)),
+                      lkey.width(), &key_[0], key_.size()) != 0) {
+        ClearGroup();
+      }
+      continue;
+    }
+
+    if (!Fetch(left_) || !Fetch(right_)) {
+      break;
+    }
+    ColumnVector &lkey = left_.batch.col(left_col_);
+    ColumnVector &rkey = right_.batch.col(right_col_);
+    int c = CompareKeys(lkey.data_type(), lkey.At(left_.batch.sel(left_.pos)),
+                        lkey.width(), rkey.At(right_.batch.sel(right_.pos)),
+                        rkey.width());
+    if (c < 0) {
+      ++left_.pos;
+    } else if (c > 0) {
+      ++right_.pos;
+    } else {
+      ReadGroup();
+    }
+  }
+  return batch.count() > 0;
+}
+
+//=======================Sort=======================//
+
+Sort::Sort(Operator *child, std::vector<SortKey> &keys, SpillManager *spill,
+           long limit, int num_threads)
+    : child_(child), keys_(keys), spill_(spill), limit_(limit),
+      num_threads_(num_threads), key_width_(0), reserved_(0), pos_(0) {
+  schema_ = child->schema();
+  if (num_threads_ <= 0) {
+    num_threads_ = max(1, (int)thread::hardware_concurrency());
+  }
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    key_width_ += schema_[keys[i].col].length();
+  }
+}
+
+Sort::~Sort() {
+  ClearRows();
+  ClearRuns();
+  delete child_;
+}
+
+void Sort::ClearRows() {
+  for (unsigned int i = 0; i < rows_.size(); ++i) {
+    delete rows_[i];
+  }
+  rows_.clear();
+  order_.clear();
+  pos_ = 0;
+  std::vector<char>().swap(norm_);
+  seq_.clear();
+  top_.clear();
+  if (spill_ != NULL) {
+    spill_->Release(reserved_);
+  }
+  reserved_ = 0;
+}
+
+void Sort::ClearRuns() {
+  for (unsigned int i = 0; i < runs_.size(); ++i) {
+    delete runs_[i];
+    delete heads_[i];
+  }
+  runs_.clear();
+  heads_.clear();
+  head_pos_.clear();
+  heap_.clear();
+}
+
+void Sort::MakeKey(Batch &batch, int r, char *key) {
+  for (unsigned int i = 0; i < keys_.size(); ++i) {
+    ColumnVector &col = batch.col(keys_[i].col);
+    NormalizeKey(col.data_type(), col.At(r), col.width(), key);
+    if (keys_[i].desc) {
+      for (int j = 0; j < col.width(); ++j) {
+        key[j] = ~key[j];
+      }
+    }
+    key += col.width();
+  }
+}
+
+int Sort::Compare(Batch &a, int ra, Batch &b, int rb) {
+  for (unsigned int i = 0; i < keys_.size(); ++i) {
+    ColumnVector &x = a.col(keys_[i].col);
+    ColumnVector &y = b.col(keys_[i].col);
+    int c = CompareKeys(x.data_type(), x.At(ra), x.width(), y.At(rb),
+                        y.width());
+    if (c != 0) {
+      return keys_[i].desc ? -c : c;
+    }
+  }
+  return 0;
+}
+
+bool Sort::RunAfter(int a, int b) {
+  int c = Compare(*heads_[a], heads_[a]->sel(head_pos_[a]), *heads_[b],
+                  heads_[b]->sel(head_pos_[b]));
+  // Earlier runs hold earlier input rows.
+  return c > 0 || (c == 0 && a > b);
+}
+
+bool Sort::TopBefore(int a, int b) {
+  int c = memcmp(&norm_[(size_t)a * key_width_], &norm_[(size_t)b * key_width_],
+                 key_width_);
+  return c < 0 || (c == 0 && seq_[a] < seq_[b]);
+}
+
+void Sort::SortRows() {
+  // Number the buffered rows and compute their keys, a batch per worker.
+  std::vector<std::pair<int, int> > rows;
+  std::vector<int> first(rows_.size() + 1, 0);
+  for (unsigned int b = 0; b < rows_.size(); ++b) {
+    for (int i = 0; i < rows_[b]->sel_count(); ++i) {
+      rows.push_back(std::make_pair((int)b, rows_[b]->sel(i)));
+    }
+    first[b + 1] = rows.size();
+  }
+  int n = rows.size();
+  norm_.resize((size_t)n * key_width_);
+  ParallelFor(num_threads_, rows_.size(), [&](int b) {
+    for (int i = first[b]; i < first[b + 1]; ++i) {
+      MakeKey(*rows_[b], rows[i].second, &norm_[(size_t)i * key_width_]);
+    }
+  });
+
+  // Sort chunks of consecutive rows side by side. A stable sort keeps rows
+  // with equal keys in input order.
+  int chunks = max(1, min(num_threads_, n / BATCH_SIZE));
+  std::vector<int> ids(n);
+  for (int i = 0; i < n; ++i) {
+    ids[i] = i;
+  }
+  const char *norm = norm_.data();
+  int width = key_width_;
+  ParallelFor(num_threads_, chunks, [&](int c) {
+    std::stable_sort(ids.begin() + (size_t)n * c / chunks,
+                     ids.begin() + (size_t)n * (c + 1) / chunks,
+                     [norm, width](int x, int y) {
+                       return memcmp(norm + (size_t)x * width,
+                                     norm + (size_t)y * width, width) < 0;
+                     });
+  });
+
+  // Merge the chunks k-way. Earlier chunks hold earlier input rows, so they
+  // win ties.
+  std::vector<int> pos(chunks), end(chunks), heap;
+  for (int c = 0; c < chunks; ++c) {
+    pos[c] = (size_t)n * c / chunks;
+    end[c] = (size_t)n * (c + 1) / chunks;
+    if (pos[c] < end[c]) {
+      heap.push_back(c);
+    }
+  }
+  auto after = [&](int x, int y) {
+    int cmp = memcmp(norm + (size_t)ids[pos[x]] * width,
+                     norm + (size_t)ids[pos[y]] * width, width);
+    return cmp > 0 || (cmp == 0 && x > y);
+  };
+  std::make_heap(heap.begin(), heap.end(), after);
+  order_.clear();
+  order_.reserve(n);
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), after);
+    int c = heap.back();
+    order_.push_back(rows[ids[pos[c]]]);
+    if (++pos[c] == end[c]) {
+      heap.pop_back();
+    } else {
+      std::push_heap(heap.begin(), heap.end(), after);
+    }
+  }
+  std::vector<char>().swap(norm_);
+  pos_ = 0;
+}
+
+void Sort::ReadTopN() {
+  Batch in;
+  in.Init(schema_);
+  std::vector<char> key(key_width_ + 1);
+  auto before = [this](int x, int y) { return TopBefore(x, y); };
+  for (long seq = 0; limit_ > 0 && child_->Next(in);) {
+    for (int i = 0; i < in.sel_count(); ++i, ++seq) {
+      int r = in.sel(i);
+      if ((long)top_.size() < limit_) {
+        int row = top_.size();
+        if (row % BATCH_SIZE == 0) {
+          rows_.push_back(new Batch());
+          rows_.back()->Init(schema_);
+          size_t size = rows_.back()->GetMemorySize();
+          if (spill_ != NULL && spill_->Reserve(size)) {
+            reserved_ += size;
+          }
+        }
+        CopyRow(in, r, *rows_.back());
+        norm_.resize(norm_.size() + key_width_);
+        MakeKey(in, r, &norm_[(size_t)row * key_width_]);
+        seq_.push_back(seq);
+        top_.push_back(row);
+        std::push_heap(top_.begin(), top_.end(), before);
+        continue;
+      }
+      // The row takes the place of the last row kept if it comes before
+      // it; with an equal key it comes after, being read later.
+      MakeKey(in, r, &key[0]);
+      int last = top_.front();
+      if (memcmp(&key[0], &norm_[(size_t)last * key_width_], key_width_) >= 0) {
+        continue;
+      }
+      std::pop_heap(top_.begin(), top_.end(), before);
+      SetRow(in, r, *rows_[last / BATCH_SIZE], last % BATCH_SIZE);
+      memcpy(&norm_[(size_t)last * key_width_], &key[0], key_width_);
+      seq_[last] = seq;
+      std::push_heap(top_.begin(), top_.end(), before);
+    }
+  }
+
+  std::sort_heap(top_.begin(), top_.end(), before);
+  for (unsigned int i = 0; i < top_.size(); ++i) {
+    order_.push_back(std::make_pair(top_[i] / BATCH_SIZE, top_[i] % BATCH_SIZE));
+  }
+  pos_ = 0;
+}
+
+void Sort::WriteRun() {
+  SortRows();
+  SpillFile *run = spill_->CreateFile(schema_);
+  for (unsigned int i = 0; i < order_.size(); ++i) {
+    run->WriteRow(*rows_[order_[i].first], order_[i].second);
+  }
+  runs_.push_back(run);
+  ClearRows();
+}
+
+void Sort::Open() {
+  ClearRows();
+  ClearRuns();
+  child_->Open();
+  if (limit_ != -1 && limit_ <= TOP_N_MAX_ROWS) {
+    ReadTopN();
+    child_->Close();
+    return;
+  }
+
+  Batch *b = new Batch();
+  b->Init(schema_);
+  while (child_->Next(*b)) {
+    // The keys of the rows are buffered too while they are sorted.
+    size_t size = b->GetMemorySize() + (size_t)BATCH_SIZE * key_width_;
+    if (spill_ != NULL && !spill_->Reserve(size)) {
+      if (!rows_.empty()) {
+        WriteRun();
+      }
+      // Keep at least this batch, within the budget or not.
+      if (!spill_->Reserve(size)) {
+        size = 0;
+      }
+    }
+    reserved_ += size;
+    rows_.push_back(b);
+    b = new Batch();
+    b->Init(schema_);
+  }
+  delete b;
+  child_->Close();
+
+  if (runs_.empty()) {
+    SortRows();
+    return;
+  }
+  WriteRun();
+  for (unsigned int i = 0; i < runs_.size(); ++i) {
+    runs_[i]->Rewind();
+    heads_.push_back(new Batch());
+    heads_[i]->Init(schema_);
+    head_pos_.push_back(0);
+    if (runs_[i]->Read(*heads_[i])) {
+      heap_.push_back(i);
+    }
+  }
+  std::make_heap(heap_.begin(), heap_.end(),
+                 [this](int x, int y) { return RunAfter(x, y); });
+}
+
+void Sort::Close() {
+  ClearRows();
+  ClearRuns();
+}
+
+bool Sort::Next(Batch &batch) {
+  batch.Reset();
+  if (runs_.empty()) {
+    for (; pos_ < order_.size() && !batch.full(); ++pos_) {
+      CopyRow(*rows_[order_[pos_].first], order_[pos_].second, batch);
+    }
+    return batch.count() > 0;
+  }
+
+  // Merge the runs: take the smallest current row until the batch is full.
+  while (!heap_.empty() && !batch.full()) {
+    std::pop_heap(heap_.begin(), heap_.end(),
+                  [this](int x, int y) { return RunAfter(x, y); });
+    int run = heap_.back();
+    heap_.pop_back();
+    Batch &head = *heads_[run];
+    CopyRow(head, head.sel(head_pos_[run]), batch);
+    if (++head_pos_[run] == head.sel_count()) {
+      head_pos_[run] = 0;
+      if (!runs_[run]->Read(head)) {
+        continue;
+      }
+    }
+    heap_.push_back(run);
+    std::push_heap(heap_.begin(), heap_.end(),
+                   [this](int x, int y) { return RunAfter(x, y); });
+  }
+  return batch.count() > 0;
+}
+
+//=======================Aggregate=======================//
+
+Aggregate::Aggregate(Operator *child, std::vector<int> &group_cols,
+                     std::vector<AggregateSpec> &aggs)
+    : child_(child), group_cols_(group_cols), aggs_(aggs), key_width_(0),
+      value_width_(0) {
+  std::vector<Attribute> &in = child->schema();
+  for (unsigned int i = 0; i < group_cols.size(); ++i) {
+    schema_.push_back(in[group_cols[i]]);
+    key_width_ += in[group_cols[i]].length();
+  }
+  static const char *names[] = {"count", "sum", "min", "max", "avg"};
+  for (unsigned int i = 0; i < aggs.size(); ++i) {
+    Attribute attr;
+    AggregateSpec &agg = aggs[i];
+    std::string col = agg.col == -1 ? "*" : in[agg.col].attr_name();
+    attr.set_attr_name(std::string(names[agg.func]) + "(" + col + ")");
+    if (agg.func == AGG_COUNT) {
+      attr.set_data_type(T_INT);
+      attr.set_length(4);
+    } else if (agg.func == AGG_AVG) {
+      attr.set_data_type(T_FLOAT);
+      attr.set_length(4);
+    } else {
+      attr.set_data_type(in[agg.col].data_type());
+      attr.set_length(in[agg.col].length());
+    }
+    schema_.push_back(attr);
+    value_offset_.push_back(value_width_);
+    if (agg.func == AGG_MIN || agg.func == AGG_MAX) {
+      value_width_ += in[agg.col].length();
+    }
+  }
+}
+
+void Aggregate::MakeKey(Batch &batch, int r, char *key) {
+  for (unsigned int i = 0; i < group_cols_.size(); ++i) {
+    ColumnVector &col = batch.col(group_cols_[i]);
+    memcpy(key, col.At(r), col.width());
+    if (col.data_type() == T_CHAR) {
+      char *end = (char *)memchr(key, 0, col.width());
+      if (end != NULL) {
+        memset(end, 0, key + col.width() - end);
+      }
+    } else if (col.data_type() == T_FLOAT) {
+      float f;
+      memcpy(&f, key, 4);
+      if (f == 0) {
+        memset(key, 0, 4);
+      }
+    }
+    key += col.width();
+  }
+}
+
+void Aggregate::InitStates(AggState *states) {
+  for (unsigned int i = 0; i < aggs_.size(); ++i) {
+    states[i].count = 0;
+    states[i].sum = 0;
+  }
+}
+
+void Aggregate::Update(AggState *states, char *values, Batch &batch, int r) {
+  for (unsigned int i = 0; i < aggs_.size(); ++i) {
+    AggregateSpec &agg = aggs_[i];
+    AggState &st = states[i];
+    ++st.count;
+    if (agg.col == -1) {
+      continue;
+    }
+    ColumnVector &col = batch.col(agg.col);
+    const char *v = col.At(r);
+    if (agg.func == AGG_SUM || agg.func == AGG_AVG) {
+      if (col.data_type() == T_INT) {
+        int x;
+        memcpy(&x, v, 4);
+        st.sum += x;
+      } else if (col.data_type() == T_FLOAT) {
+        float x;
+        memcpy(&x, v, 4);
+        st.sum += x;
+      }
+    } else if (agg.func == AGG_MIN || agg.func == AGG_MAX) {
+      char *value = values + value_offset_[i];
+      int c = st.count == 1 ? 0
+                            : CompareKeys(col.data_type(), v, col.width(),
+                                          value, col.width());
+      if (st.count == 1 || (agg.func == AGG_MIN ? c < 0 : c > 0)) {
+        memcpy(value, v, col.width());
+      }
+    }
+  }
+}
+
+void Aggregate::Combine(AggState *states, char *values, AggState *from_states,
+                        char *from_values) {
+  for (unsigned int i = 0; i < aggs_.size(); ++i) {
+    AggregateSpec &agg = aggs_[i];
+    AggState &st = states[i];
+    AggState &from = from_states[i];
+    if (from.count == 0) {
+      continue;
+    }
+    if (agg.func == AGG_MIN || agg.func == AGG_MAX) {
+      int width = child_->schema()[agg.col].length();
+      char *value = values + value_offset_[i];
+      char *from_value = from_values + value_offset_[i];
+      int c = st.count == 0
+                  ? 0
+                  : CompareKeys(child_->schema()[agg.col].data_type(),
+                                from_value, width, value, width);
+      if (st.count == 0 || (agg.func == AGG_MIN ? c < 0 : c > 0)) {
+        memcpy(value, from_value, width);
+      }
+    }
+    st.count += from.count;
+    st.sum += from.sum;
+  }
+}
+
+void Aggregate::Emit(const char *key, AggState *states, char *values,
+                     Batch &batch) {
+  int o = batch.AddRow(-1);
+  for (unsigned int i = 0; i < group_cols_.size(); ++i) {
+    ColumnVector &col = batch.col(i);
+    memcpy(col.At(o), key, col.width());
+    key += col.width();
+  }
+  for (unsigned int i = 0; i < aggs_.size(); ++i) {
+    AggState &st = states[i];
+    ColumnVector &col = batch.col(group_cols_.size() + i);
+    char *out = col.At(o);
+    switch (aggs_[i].func) {
+    case AGG_COUNT: {
+      int n = (int)st.count;
+      memcpy(out, &n, 4);
+    } break;
+    case AGG_AVG: {
+      float f = st.count == 0 ? 0 : (float)(st.sum / st.count);
+      memcpy(out, &f, 4);
+    } break;
+    case AGG_SUM:
+      if (col.data_type() == T_INT) {
+        int n = (int)st.sum;
+        memcpy(out, &n, 4);
+      } else {
+        float f = (float)st.sum;
+        memcpy(out, &f, 4);
+      }
+      break;
+    default:
+      if (st.count == 0) {
+        memset(out, 0, col.width());
+      } else {
+        memcpy(out, values + value_offset_[i], col.width());
+      }
+    }
+  }
+}
+
+//=======================HashAggregate=======================//
+
+HashAggregate::HashAggregate(Operator *child, std::vector<int> &group_cols,
+                             std::vector<AggregateSpec> &aggs,
+                             SpillManager *spill, int num_threads)
+    : Aggregate(child, group_cols, aggs), spill_(spill),
+      num_threads_(num_threads), emit_pos_(0) {
+  if (num_threads_ <= 0) {
+    num_threads_ = max(1, (int)thread::hardware_concurrency());
+  }
+  // Two slots per group, as the table is grown at half load.
+  group_size_ = key_width_ + value_width_ + aggs.size() * sizeof(AggState) +
+                sizeof(uint32_t) + 2 * sizeof(int);
+}
+
+HashAggregate::~HashAggregate() {
+  ClearGroups();
+  ClearSpill();
+  for (unsigned int i = 0; i < in_.size(); ++i) {
+    delete in_[i];
+  }
+}
+
+void HashAggregate::Clear(GroupTable &t) {
+  if (spill_ != NULL) {
+    spill_->Release(t.reserved);
+  }
+  t = GroupTable();
+}
+
+void HashAggregate::ClearGroups() {
+  for (unsigned int i = 0; i < partials_.size(); ++i) {
+    Clear(partials_[i]);
+  }
+  Clear(table_);
+  emit_pos_ = 0;
+}
+
+void HashAggregate::ClearSpill() {
+  for (unsigned int i = 0; i < pending_.size(); ++i) {
+    delete pending_[i].file;
+  }
+  pending_.clear();
+}
+
+int HashAggregate::Find(GroupTable &t, const char *key, uint32_t hash) {
+  if (t.slots.empty()) {
+    return -1;
+  }
+  size_t mask = t.slots.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    int g = t.slots[i];
+    if (g == -1) {
+      return -1;
+    }
+    if (t.hashes[g] == hash &&
+        memcmp(t.keys.data() + (size_t)g * key_width_, key, key_width_) == 0) {
+      return g;
+    }
+  }
+}
+
+int HashAggregate::AddGroup(GroupTable &t, const char *key, uint32_t hash) {
+  int g = t.hashes.size();
+  t.hashes.push_back(hash);
+  t.keys.insert(t.keys.end(), key, key + key_width_);
+  t.states.resize(t.states.size() + aggs_.size());
+  InitStates(&t.states[(size_t)g * aggs_.size()]);
+  t.values.resize(t.values.size() + value_width_);
+
+  if (t.hashes.size() * 2 > t.slots.size()) {
+    // Grow to keep the table at most half full and place every group again.
+    t.slots.assign(max((size_t)1024, t.slots.size() * 2), -1);
+    size_t mask = t.slots.size() - 1;
+    for (unsigned int i = 0; i < t.hashes.size(); ++i) {
+      size_t s = t.hashes[i] & mask;
+      while (t.slots[s] != -1) {
+        s = (s + 1) & mask;
+      }
+      t.slots[s] = i;
+    }
+  } else {
+    size_t mask = t.slots.size() - 1;
+    size_t s = hash & mask;
+    while (t.slots[s] != -1) {
+      s = (s + 1) & mask;
+    }
+    t.slots[s] = g;
+  }
+  return g;
+}
+
+bool HashAggregate::Reserve(GroupTable &t, int level) {
+  if (spill_ != NULL && level < SPILL_MAX_LEVEL &&
+      t.used + group_size_ > t.reserved) {
+    // Take the budget in chunks, so that workers rarely contend for it.
+    size_t chunk = max(group_size_, (size_t)64 << 10);
+    if (!spill_->Reserve(chunk)) {
+      return false;
+    }
+    t.reserved += chunk;
+  }
+  t.used += group_size_;
+  return true;
+}
+
+int HashAggregate::AggregatePartial(GroupTable &t, Batch &batch, int level) {
+  std::vector<char> key(key_width_ + 1);
+  for (int i = 0; i < batch.sel_count(); ++i) {
+    int r = batch.sel(i);
+    MakeKey(batch, r, &key[0]);
+    uint32_t hash = HashBytes(&key[0], key_width_);
+    int g = Find(t, &key[0], hash);
+    if (g == -1) {
+      if (!Reserve(t, level)) {
+        return i;
+      }
+      g = AddGroup(t, &key[0], hash);
+    }
+    Update(&t.states[(size_t)g * aggs_.size()],
+           t.values.data() + (size_t)g * value_width_, batch, r);
+  }
+  return batch.sel_count();
+}
+
+void HashAggregate::AggregateSerial(Batch &batch, int pos, int level,
+                                    std::vector<SpillFile *> &files) {
+  std::vector<char> key(key_width_ + 1);
+  for (int i = pos; i < batch.sel_count(); ++i) {
+    int r = batch.sel(i);
+    MakeKey(batch, r, &key[0]);
+    uint32_t hash = HashBytes(&key[0], key_width_);
+    int g = Find(table_, &key[0], hash);
+    if (g == -1) {
+      if (files.empty() && !Reserve(table_, level)) {
+        // Out of memory: rows of groups not seen yet go to files.
+        for (int f = 0; f < SPILL_FANOUT; ++f) {
+          files.push_back(spill_->CreateFile(child_->schema()));
+        }
+      }
+      if (!files.empty()) {
+        files[SpillPartitionOf(hash, level)]->WriteRow(batch, r);
+        continue;
+      }
+      g = AddGroup(table_, &key[0], hash);
+    }
+    Update(&table_.states[(size_t)g * aggs_.size()],
+           table_.values.data() + (size_t)g * value_width_, batch, r);
+  }
+}
+
+void HashAggregate::Merge(GroupTable &from) {
+  for (unsigned int i = 0; i < from.hashes.size(); ++i) {
+    const char *key = from.keys.data() + (size_t)i * key_width_;
+    int g = Find(table_, key, from.hashes[i]);
+    if (g == -1) {
+      g = AddGroup(table_, key, from.hashes[i]);
+      table_.used += group_size_;
+    }
+    Combine(&table_.states[(size_t)g * aggs_.size()],
+            table_.values.data() + (size_t)g * value_width_,
+            &from.states[(size_t)i * aggs_.size()],
+            from.values.data() + (size_t)i * value_width_);
+  }
+  // The merged table never holds more groups than its partials did.
+  table_.reserved += from.reserved;
+  from.reserved = 0;
+  Clear(from);
+}
+
+void HashAggregate::Consume(Operator *in, SpillFile *file, int level) {
+  std::vector<SpillFile *> files;
+  bool serial = false;
+  bool done = false;
+  partials_.resize(num_threads_);
+  while (!done) {
+    // Read a group of batches, one per worker, or one once serial.
+    int want = serial ? 1 : num_threads_;
+    int n = 0;
+    while (n < want) {
+      if (n == (int)in_.size()) {
+        in_.push_back(new Batch());
+        in_.back()->Init(child_->schema());
+      }
+      if (in != NULL ? !in->Next(*in_[n]) : !file->Read(*in_[n])) {
+        done = true;
+        break;
+      }
+      ++n;
+    }
+    if (serial) {
+      for (int i = 0; i < n; ++i) {
+        AggregateSerial(*in_[i], 0, level, files);
+      }
+      continue;
+    }
+
+    std::vector<int> stop(n);
+    ParallelFor(num_threads_, n, [&](int i) {
+      stop[i] = AggregatePartial(partials_[i], *in_[i], level);
+    });
+    for (int i = 0; i < n; ++i) {
+      if (stop[i] < in_[i]->sel_count()) {
+        serial = true;
+      }
+    }
+    if (serial) {
+      // Out of memory: merge what the workers have and go on alone.
+      for (unsigned int p = 0; p < partials_.size(); ++p) {
+        Merge(partials_[p]);
+      }
+      for (int i = 0; i < n; ++i) {
+        AggregateSerial(*in_[i], stop[i], level, files);
+      }
+    }
+  }
+  if (!serial) {
+    for (unsigned int p = 0; p < partials_.size(); ++p) {
+      Merge(partials_[p]);
+    }
+  }
+
+  for (unsigned int f = 0; f < files.size(); ++f) {
+    if (files[f]->rows() == 0) {
+      delete files[f];
+      continue;
+    }
+    SpillPart part;
+    part.file = files[f];
+    part.level = level + 1;
+    pending_.push_back(part);
+  }
+}
+
+void HashAggregate::Open() {
+  ClearGroups();
+  ClearSpill();
+  child_->Open();
+  Consume(child_, NULL, 0);
+  child_->Close();
+  if (group_cols_.empty() && table_.hashes.empty() && pending_.empty()) {
+    // An aggregate over no rows still produces its row.
+    AddGroup(table_, NULL, HashBytes(NULL, 0));
+  }
+}
+
+void HashAggregate::Close() {
+  ClearGroups();
+  ClearSpill();
+}
+
+bool HashAggregate::Next(Batch &batch) {
+  batch.Reset();
+  for (;;) {
+    for (; emit_pos_ < table_.hashes.size() && !batch.full(); ++emit_pos_) {
+      size_t g = emit_pos_;
+      Emit(table_.keys.data() + g * key_width_,
+           &table_.states[g * aggs_.size()],
+           table_.values.data() + g * value_width_, batch);
+    }
+    if (batch.count() > 0) {
+      return true;
+    }
+    // The table is done; aggregate the next spilled file, if any.
+    ClearGroups();
+    if (pending_.empty()) {
+      return false;
+    }
+    SpillPart part = pending_.back();
+    pending_.pop_back();
+    part.file->Rewind();
+    Consume(NULL, part.file, part.level);
+    delete part.file;
+  }
+}
+
+//=======================StreamAggregate=======================//
+
+StreamAggregate::StreamAggregate(Operator *child, std::vector<int> &group_cols,
+                                 std::vector<AggregateSpec> &aggs)
+    : Aggregate(child, group_cols, aggs), pos_(0), done_(true),
+      has_group_(false), groups_(0), key_(key_width_ + 1),
+      row_key_(key_width_ + 1), states_(aggs.size()),
+      values_(value_width_ + 1) {
+  in_.Init(child->schema());
+}
+
+void StreamAggregate::Open() {
+  child_->Open();
+  in_.Reset();
+  pos_ = 0;
+  done_ = false;
+  has_group_ = false;
+  groups_ = 0;
+}
+
+bool StreamAggregate::Next(Batch &batch) {
+  batch.Reset();
+  while (!batch.full()) {
+    if (pos_ == in_.sel_count()) {
+      pos_ = 0;
+      if (!done_ && child_->Next(in_)) {
+        continue;
+      }
+      in_.Reset();
+      if (!done_ && (has_group_ || (group_cols_.empty() && groups_ == 0))) {
+        // The last group, or the row of an aggregate over no rows.
+        if (!has_group_) {
+          InitStates(&states_[0]);
+        }
+        Emit(&key_[0], &states_[0], &values_[0], batch);
+        ++groups_;
+        has_group_ = false;
+      }
+      done_ = true;
+      break;
+    }
+
+    int r = in_.sel(pos_);
+    MakeKey(in_, r, &row_key_[0]);
+    if (has_group_ && memcmp(&row_key_[0], &key_[0], key_width_) != 0) {
+      Emit(&key_[0], &states_[0], &values_[0], batch);
+      ++groups_;
+      has_group_ = false;
+    }
+    if (!has_group_) {
+      key_.swap(row_key_);
+      InitStates(&states_[0]);
+      has_group_ = true;
+    }
+    Update(&states_[0], &values_[0], in_, r);
+    ++pos_;
+  }
+  return batch.count() > 0;
+}
+
+//=======================Sinks=======================//
+
+bool PrintSink::Consume(Batch &batch) {
+  for (int i = 0; i < batch.sel_count(); ++i) {
+    int r = batch.sel(i);
+    for (unsigned int j = 0; j < batch.GetColumnNum(); ++j) {
+      out_ << batch.col(j).GetKey(r);
+    }
+    out_ << '\n';
+  }
+  out_.flush();
+  return true;
+}
+
+bool RidSink::Consume(Batch &batch) {
+  for (int i = 0; i < batch.sel_count(); ++i) {
+    rids_.push_back(batch.rid(batch.sel(i)));
+  }
+  return true;
+}
+
+bool CountSink::Consume(Batch &batch) {
+  count_ += batch.sel_count();
+  return true;
+}
+
+void RunPlan(Operator *plan, Sink &sink) {
+  Batch batch;
+  batch.Init(plan->schema());
+  plan->Open();
+  while (plan->Next(batch) && sink.Consume(batch)) {
+  }
+  plan->Close();
+  sink.Finish();
+}
@@ -0,0 +1,755 @@
+#ifndef MINIDB_EXECUTOR_H_
+#define MINIDB_EXECUTOR_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog_manager.h"
+#include "index_manager.h"
+#include "predicate.h"
+#include "sql_statement.h"
+
+class RecordManager;
+class SpillFile;
+class SpillManager;
+
+// Number of rows an operator hands to its parent at a time.
+#define BATCH_SIZE 1024
+// Number of consecutive blocks a parallel scan worker takes at a time.
+#define MORSEL_BLOCKS 16
+// Most blocks a scan reads from the file in one request.
+#define READ_RUN_BLOCKS 16
+// Number of partitions of a hash join build table, a power of two.
+#define HASH_JOIN_PARTITIONS 64
+// Times a spilled partition that still does not fit may be split again.
+#define SPILL_MAX_LEVEL 3
+// Most rows a Sort with a limit keeps in its heap; beyond that it sorts all.
+#define TOP_N_MAX_ROWS (64 * BATCH_SIZE)
+
+// ColumnVector: the values of one column for the rows of a batch, packed
+// `width` bytes apart so the filter kernels can run over them directly.
+class ColumnVector {
+private:
+  int data_type_;
+  int width_;
+  std::vector<char> data_;
+
+public:
+  ColumnVector(int data_type, int width)
+      : data_type_(data_type), width_(width), data_(BATCH_SIZE * width) {}
+
+  int data_type() { return data_type_; }
+  int width() { return width_; }
+  char *data() { return &data_[0]; }
+  char *At(int i) { return &data_[i * width_]; }
+
+  // Copy a value out, used when a row is emitted.
+  TKey GetKey(int i);
+};
+
+// Batch: up to BATCH_SIZE rows stored column by column. Operators that drop
+// rows only shrink the selection vector, which lists the live row positions
+// in ascending order; the column data stays where it is.
+class Batch {
+private:
+  std::vector<ColumnVector> cols_;
+  std::vector<int> rids_; // (block_num << 16) | offset of each row, or -1.
+  std::vector<int> sel_;  // Positions of the live rows.
+  int count_;             // Rows stored in the columns.
+
+public:
+  Batch() : count_(0) {}
+
+  // Lay out one column per attribute of the schema and drop all rows.
+  void Init(std::vector<Attribute> &schema);
+  void Reset() {
+    count_ = 0;
+    sel_.clear();
+  }
+
+  int count() { return count_; }
+  bool full() { return count_ == BATCH_SIZE; }
+  // Bytes held by the column data.
+  size_t GetMemorySize();
+  unsigned long GetColumnNum() { return cols_.size(); }
+  ColumnVector &col(int i) { return cols_[i]; }
+  int rid(int i) { return rids_[i]; }
+  void set_rid(int i, int rid) { rids_[i] = rid; }
+
+  // Append a live row and return its position; the caller fills the columns.
+  int AddRow(int rid) {
+    rids_[count_] = rid;
+    sel_.push_back(count_);
+    return count_++;
+  }
+
+  std::vector<int> &sel() { return sel_; }
+  int sel_count() { return sel_.size(); }
+  int sel(int i) { return sel_[i]; }
+
+  // Exchange the rows of two batches laid out for the same schema.
+  void Swap(Batch &other) {
+    cols_.swap(other.cols_);
+    rids_.swap(other.rids_);
+    sel_.swap(other.sel_);
+    std::swap(count_, other.count_);
+  }
+
+  // Keep only the rows whose bit is set in `mask`.
+  void Select(std::vector<uint64_t> &mask);
+  // Take over the rows of `from` without copying column data: column i of
+  // this batch is swapped with column `cols[i]` of `from`. Only a column
+  // listed a second time is copied.
+  void TakeColumns(Batch &from, std::vector<int> &cols);
+};
+
+// Operator: one step of a query pipeline. A parent pulls batches from its
+// children with Next() until it returns false; the batch passed in must have
+// been laid out with Init(schema()). Operators own their children.
+class Operator {
+protected:
+  std::vector<Attribute> schema_; // Columns of the batches produced.
+
+public:
+  virtual ~Operator() {}
+  std::vector<Attribute> &schema() { return schema_; }
+
+  virtual void Open() {}
+  virtual bool Next(Batch &batch) = 0;
+  virtual void Close() {}
+};
+
+// TableScan: reads the blocks of a table in file order, following the block
+// directory, a run of consecutive blocks at a time. Blocks whose zone map
+// shows that no record can satisfy the WHERE conditions are not read. The
+// conditions are evaluated on the page with the filter kernels, and only the
+// requested columns of the qualifying records are copied into the batch, so
+// the minipages of other columns of a columnar table are never read.
+class TableScan : public Operator {
+private:
+  RecordManager *rm_;
+  Table *tbl_;
+  Predicate pred_;
+  std::vector<int> cols_;   // Table column of each output column.
+  std::vector<int> blocks_; // Blocks to read, from the directory at Open.
+  unsigned int pos_;        // Directory entry of the first block of run_.
+  int run_len_;             // Blocks held in run_.
+  int run_pos_;             // Block of run_ being scanned.
+  int row_;                 // Next record to look at in that block.
+  std::vector<char> run_;   // Private copy of the blocks being scanned.
+  std::vector<uint64_t> mask_;
+
+public:
+  // Produce every column of the table.
+  TableScan(RecordManager *rm, Table *tbl, std::vector<SQLWhere> &wheres);
+  // Produce only the listed table columns, in that order.
+  TableScan(RecordManager *rm, Table *tbl, std::vector<SQLWhere> &wheres,
+            std::vector<int> &cols);
+  void Open();
+  bool Next(Batch &batch);
+};
+
+// ParallelTableScan: a TableScan split over worker threads. The block
+// directory, less the blocks the zone map rules out, is cut into morsels of
+// MORSEL_BLOCKS blocks; each worker takes the next morsel, filters it on a
+// private copy of every block and queues the resulting batches. The parent
+// gets the batches of a morsel together, either in table order or as soon
+// as any morsel is done. The workers read through ReadFileBlocks, which
+// only holds the buffer lock while it copies cached blocks, so other
+// operators may still read blocks through GetFileBlock meanwhile; but
+// nothing may write the blocks of the scanned table until Close.
+class ParallelTableScan : public Operator {
+private:
+  RecordManager *rm_;
+  Table *tbl_;
+  Predicate pred_;
+  std::vector<int> cols_;
+  bool keep_order_;
+  int num_threads_;
+
+  std::vector<int> blocks_; // Blocks to read, from the directory at Open.
+  int num_morsels_;
+
+  std::mutex mutex_; // Guards everything below.
+  std::condition_variable cv_;
+  std::vector<std::vector<Batch *> > results_; // Output of each morsel.
+  std::vector<bool> done_;                     // Morsel finished.
+  std::deque<int> ready_;  // Finished morsels not yet emitted, in order done.
+  int next_morsel_;        // Next morsel to hand to a worker.
+  int next_emit_;          // Next morsel to emit in table order.
+  int emitted_;            // Morsels taken by the parent.
+  int in_flight_;          // Morsels started but not yet fully emitted.
+  bool stop_;
+  std::vector<std::thread> workers_;
+
+  // Batches of the morsel being emitted, owned by the parent side.
+  std::vector<Batch *> current_;
+  unsigned int current_pos_;
+  bool has_current_;
+
+  void Work();
+  void ScanMorsel(int m, std::vector<Batch *> &out);
+  void FreeBatches();
+
+public:
+  // `num_threads` 0 uses one thread per hardware thread.
+  ParallelTableScan(RecordManager *rm, Table *tbl,
+                    std::vector<SQLWhere> &wheres, std::vector<int> &cols,
+                    bool keep_order, int num_threads = 0);
+  ~ParallelTableScan() { Close(); }
+  void Open();
+  bool Next(Batch &batch);
+  void Close();
+};
+
+// IndexScan: reads the columns listed in `cols` of the records whose keys
+// lie in a range of a B+ tree index, in ascending key order or descending:
+// the tree is descended to the bound it starts from once, and the leaf
+// chain walked from there.
+// The record ids of a batch worth of entries are gathered first and the
+// records fetched in block order, so each block is visited once per batch;
+// the rows are then laid out in key order. When the key and included
+// attributes of the index hold every column, they are read from the leaves
+// and the records are not visited at all.
+class IndexScan : public Operator {
+private:
+  RecordManager *rm_;
+  Table *tbl_;
+  BPlusTree tree_;
+  BPlusTreeRange range_;
+  std::vector<int> cols_;
+  std::vector<int> rids_;                   // Record ids of a batch.
+  std::vector<std::pair<int, int> > order_; // (record id, row) of a batch.
+  // For a scan of the index alone: where each column lies in a key, and
+  // the type to decode it from, or -1 if it is held as stored.
+  std::vector<int> key_offsets_;
+  std::vector<int> key_types_;
+  std::vector<char> keys_; // Keys of a batch.
+
+public:
+  IndexScan(RecordManager *rm, Table *tbl, Index *idx, KeyRange &range,
+            std::vector<int> &cols, bool descending = false);
+  // True if the rows are read from the index alone.
+  bool index_only() { return key_offsets_.size() == cols_.size(); }
+  void Open() { range_.Seek(); }
+  bool Next(Batch &batch);
+};
+
+// HashIndexScan: reads the columns listed in `cols` of the records whose
+// keys are the low bound of a KeyRange over every attribute of a hash
+// index. The bucket is looked up once on Open; the records are then fetched
+// a batch at a time in block order.
+class HashIndexScan : public Operator {
+private:
+  RecordManager *rm_;
+  Table *tbl_;
+  Index *idx_;
+  TKey key_;
+  std::vector<int> cols_;
+  std::vector<int> vals_;                   // Record ids of the key.
+  unsigned int pos_;                        // Next of them to fetch.
+  std::vector<std::pair<int, int> > order_; // (record id, row) of a batch.
+
+public:
+  HashIndexScan(RecordManager *rm, Table *tbl, Index *idx, KeyRange &range,
+                std::vector<int> &cols);
+  void Open();
+  bool Next(Batch &batch);
+};
+
+// BitmapScan: reads the columns listed in `cols` of the records that the
+// bitmap indexes of the table let through. The conditions on each column
+// with a bitmap index select the bitmaps of the values they accept, or-ed
+// together, and the columns are and-ed. A column tested only with <> is
+// instead and-not-ed with the values it rejects, unless no other column
+// narrows the records first. The records are then fetched in block order,
+// a batch at a time.
+class BitmapScan : public Operator {
+private:
+  RecordManager *rm_;
+  Table *tbl_;
+  std::vector<SQLWhere> wheres_;
+  std::vector<int> cols_;
+  std::vector<int> rids_;                   // Record ids let through.
+  unsigned int pos_;                        // Next of them to fetch.
+  std::vector<std::pair<int, int> > order_; // (record id, row) of a batch.
+
+public:
+  BitmapScan(RecordManager *rm, Table *tbl, std::vector<SQLWhere> &wheres,
+             std::vector<int> &cols);
+  void Open();
+  bool Next(Batch &batch);
+};
+
+// Filter: drops the rows of its child's batches that fail the conditions.
+class Filter : public Operator {
+private:
+  Operator *child_;
+  Predicate pred_;
+  std::vector<uint64_t> mask_;
+
+public:
+  Filter(Operator *child, std::vector<SQLWhere> &wheres);
+  ~Filter() { delete child_; }
+  void Open() { child_->Open(); }
+  bool Next(Batch &batch);
+  void Close() { child_->Close(); }
+};
+
+// Project: keeps and reorders a subset of its child's columns. Column data
+// is handed over, not copied, unless a child column appears twice.
+class Project : public Operator {
+private:
+  Operator *child_;
+  std::vector<int> cols_; // Child column of each output column.
+  Batch in_;
+
+public:
+  Project(Operator *child, std::vector<int> &cols);
+  ~Project() { delete child_; }
+  void Open() { child_->Open(); }
+  bool Next(Batch &batch);
+  void Close() { child_->Close(); }
+};
+
+// Limit: skips the first `offset` rows of its child and passes on at most
+// `limit` of the others, or all of them when `limit` is -1. It stops
+// pulling from its child as soon as it has passed on enough rows, so the
+// plan below does no more work than the batches it has already started.
+class Limit : public Operator {
+private:
+  Operator *child_;
+  long limit_;
+  long offset_;
+  long skipped_; // Rows skipped so far.
+  long emitted_; // Rows passed on so far.
+
+public:
+  Limit(Operator *child, long limit, long offset);
+  ~Limit() { delete child_; }
+  void Open();
+  bool Next(Batch &batch);
+  void Close();
+};
+
+// HashJoin: inner equi-join. On Open one input, the build side, is read
+// into memory and hashed on its join column into HASH_JOIN_PARTITIONS
+// partitions, each with its own bucket array, so that worker threads can
+// scatter and then build the partitions independently. The other input is
+// then probed a group of batches at a time, one batch per worker. Output
+// rows carry all left columns followed by all right columns, whichever side
+// was built.
+//
+// Given a SpillManager, the build side is held within its budget. When it
+// does not fit, both inputs are split by hash into SPILL_FANOUT pairs of
+// temporary files (Grace hash join) and the pairs are joined one at a time;
+// a pair whose build file is still too large is split again.
+class HashJoin : public Operator {
+private:
+  // A build row and the hash of its key.
+  struct Entry {
+    uint32_t hash;
+    int batch;
+    int row;
+  };
+  // The build rows whose hash falls into one partition, chained per bucket.
+  struct Partition {
+    std::vector<Entry> entries;
+    std::vector<int> heads; // First entry of each bucket, or -1.
+    std::vector<int> next;  // Next entry of the same bucket, or -1.
+  };
+  // Build and probe rows of one spilled partition.
+  struct SpillPair {
+    SpillFile *build;
+    SpillFile *probe;
+    int level; // Times the rows have been split.
+  };
+
+  Operator *left_;
+  Operator *right_;
+  int left_col_;
+  int right_col_;
+  bool build_left_;
+  SpillManager *spill_;
+  int num_threads_;
+
+  std::vector<Batch *> build_;
+  size_t reserved_; // Budget held for build_.
+  std::vector<Partition> parts_;
+  std::vector<Batch *> probe_;  // Probe batches of the current group.
+  std::vector<std::vector<Batch *> > out_; // Their output, per batch.
+  unsigned int out_batch_;      // Next probe batch whose output to emit.
+  unsigned int out_pos_;        // Next output batch of that probe batch.
+  bool probe_done_;
+
+  bool grace_;                      // Joining spilled partitions.
+  std::vector<SpillPair> pending_;  // Partitions left to join.
+  SpillFile *probe_file_;           // Probe rows of the current partition.
+
+  Operator *build_input() { return build_left_ ? left_ : right_; }
+  Operator *probe_input() { return build_left_ ? right_ : left_; }
+  int build_col() { return build_left_ ? left_col_ : right_col_; }
+  int probe_col() { return build_left_ ? right_col_ : left_col_; }
+
+  // Read the build input; false if it had to be spilled.
+  bool ReadBuild();
+  void BuildTable();
+  void ProbeBatch(Batch &in, std::vector<Batch *> &out);
+  bool ReadProbe(Batch &batch);
+  // Split the rows of `batch` over `files` by the hash of column `col`.
+  void SpillRows(Batch &batch, int col, int level,
+                 std::vector<SpillFile *> &files);
+  void AddPairs(std::vector<SpillFile *> &build,
+                std::vector<SpillFile *> &probe, int level);
+  // Build the table of the next spilled partition; false when none is left.
+  bool LoadPartition();
+  void ClearBuild();
+  void ClearOutput();
+  void ClearSpill();
+
+public:
+  // `build_left` selects the input to hash; it should be the smaller one.
+  // Without `spill` the build side is kept in memory whatever its size.
+  // `num_threads` 0 uses one thread per hardware thread.
+  HashJoin(Operator *left, Operator *right, int left_col, int right_col,
+           bool build_left, SpillManager *spill = NULL, int num_threads = 0);
+  ~HashJoin();
+  void Open();
+  bool Next(Batch &batch);
+  void Close();
+};
+
+// IndexJoin: inner equi-join that looks the join key of every outer row up
+// in a B+ tree index on the join column of the inner table. The keys of an
+// outer batch are probed in ascending order, so that consecutive lookups
+// stay in the same leaf, and the matching records are then fetched in
+// record order, so that each inner block is visited once per batch. Output
+// rows carry all left columns followed by all right columns; `outer_left`
+// tells which side the outer input is.
+class IndexJoin : public Operator {
+private:
+  Operator *outer_;
+  RecordManager *rm_;
+  Table *tbl_; // Inner table.
+  Index *idx_;
+  int outer_col_;
+  bool outer_left_;
+
+  Batch in_; // Current outer batch.
+  // Record id of the inner match and outer row of each result of in_.
+  std::vector<std::pair<int, int> > matches_;
+  unsigned int pos_; // Next entry of matches_ to emit.
+  bool done_;
+
+  // Read outer batches until one has matches; false at the end of input.
+  bool Probe();
+
+public:
+  IndexJoin(Operator *outer, RecordManager *rm, Table *tbl, Index *idx,
+            int outer_col, bool outer_left);
+  ~IndexJoin() { delete outer_; }
+  void Open();
+  bool Next(Batch &batch);
+  void Close() { outer_->Close(); }
+};
+
+// MergeJoin: inner equi-join of two inputs that both come sorted in
+// ascending order of their join column, such as index order scans or
+// sorts. The inputs are read once, in lockstep; the right rows sharing a
+// key are held while the left rows with that key are paired with them.
+// Output rows carry all left columns followed by all right columns.
+class MergeJoin : public Operator {
+private:
+  // Position in one of the inputs.
+  struct Cursor {
+    Operator *in;
+    Batch batch;
+    int pos; // Next live row of batch.
+    bool done;
+  };
+
+  Cursor left_;
+  Cursor right_;
+  int left_col_;
+  int right_col_;
+
+  std::vector<Batch *> group_; // Right rows with the current key.
+  std::vector<char> key_;      // That key, while group_ is joined.
+  int group_batch_;            // Next group row for the current left row.
+  int group_row_;
+
+  // Make the cursor point at a row, reading a batch if needed; false at
+  // the end of its input.
+  bool Fetch(Cursor &c);
+  // Copy the right rows that have the key of the current right row into
+  // group_.
+  void ReadGroup();
+  void ClearGroup();
+
+public:
+  MergeJoin(Operator *left, Operator *right, int left_col, int right_col);
+  ~MergeJoin();
+  void Open();
+  bool Next(Batch &batch);
+  void Close();
+};
+
+// One key of a Sort.
+struct SortKey {
+  int col;   // Column of the input.
+  bool desc; // Descending order.
+};
+
+// Sort: orders the rows of its input by a list of keys; rows with equal
+// keys keep their input order. The input is read on Open. The buffered rows
+// are compared by normalized keys, bytes whose memcmp order is the sort
+// order: they are split into chunks that are sorted side by side, one per
+// worker, and the chunks are merged k-way. Given a SpillManager, rows are
+// buffered within its budget; every time it runs out the buffered rows are
+// sorted and written to a temporary file as a run, and the runs are merged
+// at the end (external merge sort).
+//
+// Given a limit of at most TOP_N_MAX_ROWS, only the first `limit` rows are
+// wanted: the input is passed through a heap that holds the rows kept so
+// far, the last of them on top, and is never sorted as a whole.
+class Sort : public Operator {
+private:
+  Operator *child_;
+  std::vector<SortKey> keys_;
+  SpillManager *spill_;
+  long limit_; // Rows wanted, -1 for all.
+  int num_threads_;
+  int key_width_; // Bytes of a normalized key.
+
+  std::vector<Batch *> rows_; // Buffered input.
+  size_t reserved_;           // Budget held for rows_.
+  std::vector<std::pair<int, int> > order_; // (batch, row) in sorted order.
+  unsigned int pos_;          // Next entry of order_ to emit.
+  std::vector<char> norm_;    // Normalized key of each buffered row.
+  std::vector<long> seq_;     // Input position of each row in the heap.
+  std::vector<int> top_;      // Heap of the rows kept, as row numbers.
+
+  std::vector<SpillFile *> runs_;
+  std::vector<Batch *> heads_; // Current batch of each run.
+  std::vector<int> head_pos_;  // Current live row of it.
+  std::vector<int> heap_;      // Runs not yet exhausted, smallest row first.
+
+  void MakeKey(Batch &batch, int r, char *key);
+  // Order of two rows: negative, zero or positive.
+  int Compare(Batch &a, int ra, Batch &b, int rb);
+  // True if the current row of run `a` comes after that of run `b`.
+  bool RunAfter(int a, int b);
+  // True if heap row `a` comes before heap row `b`.
+  bool TopBefore(int a, int b);
+  void SortRows();
+  // Read the input, keeping only its first limit_ rows.
+  void ReadTopN();
+  void WriteRun();
+  void ClearRows();
+  void ClearRuns();
+
+public:
+  // Without `spill` every row is kept in memory. `num_threads` 0 uses one
+  // thread per hardware thread.
+  Sort(Operator *child, std::vector<SortKey> &keys, SpillManager *spill = NULL,
+       long limit = -1, int num_threads = 0);
+  ~Sort();
+  void Open();
+  bool Next(Batch &batch);
+  void Close();
+};
+
+// One aggregate computed by an aggregation operator.
+struct AggregateSpec {
+  int func; // AGG_COUNT, AGG_SUM, AGG_MIN, AGG_MAX or AGG_AVG.
+  int col;  // Column of the input, -1 for COUNT(*).
+};
+
+// Aggregate: what HashAggregate and StreamAggregate share. Output rows carry
+// the group columns followed by one column per aggregate: COUNT is an int,
+// AVG a float, and SUM, MIN and MAX have the type of their column. Without
+// group columns a single row is produced, even for an empty input.
+class Aggregate : public Operator {
+protected:
+  // Running state of one aggregate of one group. The value of a MIN or MAX
+  // is kept with the other values of the group, once count > 0.
+  struct AggState {
+    long long count;
+    double sum;
+  };
+
+  Operator *child_;
+  std::vector<int> group_cols_;
+  std::vector<AggregateSpec> aggs_;
+  int key_width_;                 // Bytes of the key of a group.
+  int value_width_;               // Bytes of the MIN and MAX values of one.
+  std::vector<int> value_offset_; // Offset of each of these values.
+
+  // Copy the group columns of row `r` to `key`, with values KeysEqual
+  // treats as equal made the same bytes.
+  void MakeKey(Batch &batch, int r, char *key);
+  void InitStates(AggState *states);
+  // Fold row `r` into the states and values of a group.
+  void Update(AggState *states, char *values, Batch &batch, int r);
+  // Fold the states and values of a group into those of the same group.
+  void Combine(AggState *states, char *values, AggState *from_states,
+               char *from_values);
+  void Emit(const char *key, AggState *states, char *values, Batch &batch);
+
+public:
+  Aggregate(Operator *child, std::vector<int> &group_cols,
+            std::vector<AggregateSpec> &aggs);
+  ~Aggregate() { delete child_; }
+};
+
+// HashAggregate: groups its input in open-addressing hash tables. Batches
+// are read a group at a time and aggregated side by side, one per worker,
+// each worker into a partial table of its own; the partials are merged
+// once the input is done.
+//
+// Given a SpillManager, groups are added while the budget allows. Once it
+// is used up the partials are merged, and the rest of the input is
+// aggregated by one thread: rows of groups already in the table are still
+// aggregated in memory, while rows of new groups are split by hash over
+// temporary files. Each file is aggregated the same way after the table
+// has been emitted.
+class HashAggregate : public Aggregate {
+private:
+  // Groups in a hash table with linear probing.
+  struct GroupTable {
+    std::vector<int> slots;       // Group in each slot, or -1.
+    std::vector<uint32_t> hashes; // Hash of the key of each group.
+    std::vector<char> keys;       // Key of each group.
+    std::vector<AggState> states; // aggs_.size() states per group.
+    std::vector<char> values;     // MIN and MAX values of each group.
+    size_t used;                  // Bytes the groups take.
+    size_t reserved;              // Budget held for them.
+    GroupTable() : used(0), reserved(0) {}
+  };
+  // A spilled file and the times its rows have been split.
+  struct SpillPart {
+    SpillFile *file;
+    int level;
+  };
+
+  SpillManager *spill_;
+  int num_threads_;
+  size_t group_size_; // Bytes a group takes.
+
+  std::vector<GroupTable> partials_; // One per worker.
+  GroupTable table_;                 // Merged groups, emitted from.
+  std::vector<Batch *> in_;          // Input batches of the current group.
+  unsigned int emit_pos_;            // Next group to emit.
+  std::vector<SpillPart> pending_;
+
+  int Find(GroupTable &t, const char *key, uint32_t hash);
+  int AddGroup(GroupTable &t, const char *key, uint32_t hash);
+  // Take budget for one more group of `t`; false when it is used up.
+  bool Reserve(GroupTable &t, int level);
+  // Aggregate the live rows of a batch into a partial table. Returns the
+  // position of the first row left out because the budget ran out, or
+  // sel_count() when none was.
+  int AggregatePartial(GroupTable &t, Batch &batch, int level);
+  // Aggregate the live rows of a batch from position `pos` on into table_,
+  // writing rows of new groups to `files` once the budget is used up.
+  void AggregateSerial(Batch &batch, int pos, int level,
+                       std::vector<SpillFile *> &files);
+  void Merge(GroupTable &from);
+  // Aggregate every row of `in`, or else of `file`, into table_.
+  void Consume(Operator *in, SpillFile *file, int level);
+  void Clear(GroupTable &t);
+  void ClearGroups();
+  void ClearSpill();
+
+public:
+  // Without `spill` every group is kept in memory. `num_threads` 0 uses one
+  // thread per hardware thread.
+  HashAggregate(Operator *child, std::vector<int> &group_cols,
+                std::vector<AggregateSpec> &aggs, SpillManager *spill = NULL,
+                int num_threads = 0);
+  ~HashAggregate();
+  void Open();
+  bool Next(Batch &batch);
+  void Close();
+};
+
+// StreamAggregate: aggregates an input that comes ordered on its group
+// columns, such as an index order scan, so that the rows of a group are
+// adjacent. Only the current group is held, and it is emitted as soon as a
+// row of the next one arrives.
+class StreamAggregate : public Aggregate {
+private:
+  Batch in_;
+  int pos_;  // Next live row of in_.
+  bool done_;
+  bool has_group_;
+  long groups_; // Groups emitted since Open.
+  std::vector<char> key_;
+  std::vector<char> row_key_;
+  std::vector<AggState> states_;
+  std::vector<char> values_;
+
+public:
+  StreamAggregate(Operator *child, std::vector<int> &group_cols,
+                  std::vector<AggregateSpec> &aggs);
+  void Open();
+  bool Next(Batch &batch);
+  void Close() { child_->Close(); }
+};
+
+// Sink: the end of a pipeline. RunPlan pushes the batches of a plan into a
+// sink as soon as they are produced, so a statement holds no more than the
+// batches in flight, and its first rows come out before the last are read.
+class Sink {
+public:
+  virtual ~Sink() {}
+  // Take the live rows of a batch; false when no more rows are wanted.
+  virtual bool Consume(Batch &batch) = 0;
+  // Called after the last batch.
+  virtual void Finish() {}
+};
+
+// PrintSink: writes every row to a stream, flushing it after each batch.
+class PrintSink : public Sink {
+private:
+  std::ostream &out_;
+
+public:
+  PrintSink(std::ostream &out) : out_(out) {}
+  bool Consume(Batch &batch);
+  void Finish() { out_.flush(); }
+};
+
+// RidSink: collects the record id of every row.
+class RidSink : public Sink {
+private:
+  std::vector<int> &rids_;
+
+public:
+  RidSink(std::vector<int> &rids) : rids_(rids) {}
+  bool Consume(Batch &batch);
+};
+
+// CountSink: counts the rows.
+class CountSink : public Sink {
+private:
+  long &count_;
+
+public:
+  CountSink(long &count) : count_(count) {}
+  bool Consume(Batch &batch);
+};
+
+// Open a plan and push its batches into `sink` until either is done.
+void RunPlan(Operator *plan, Sink &sink);
+
+#endif /* MINIDB_EXECUTOR_H_ */
@@ -95,14 +95,15 @@ BlockInfo *FileHandle::RecycleBlock() {
   FileInfo *fp = first_file_;
 
   BlockInfo *oldestbefore = NULL;
-  BlockInfo *oldest = fp->first_block();
+  // The first file may hold no block at all, so start from none.
+  BlockInfo *oldest = NULL;
 
   while (fp != NULL) {
     BlockInfo *bpbefore = NULL;
     BlockInfo *bp = fp->first_block();
     while (bp != NULL) {
 
-      if (bp->age() > oldest->age()) {
+      if (!bp->pinned() && (oldest == NULL || bp->age() > oldest->age())) {
         oldestbefore = bpbefore;
         oldest = bp;
       }
@@ -0,0 +1,466 @@
+#include "filter_kernels.h"
+
+#include <cstring>
+
+#include "commons.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MINIDB_X86_KERNELS 1
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+namespace {
+
+//=======================Scalar=======================//
+
+template <int SIGN, typename T> inline bool Test(T a, T b) {
+  switch (SIGN) {
+  case SIGN_EQ: return a == b;
+  case SIGN_NE: return a != b;
+  case SIGN_LT: return a < b;
+  case SIGN_GT: return a > b;
+  case SIGN_LE: return a <= b;
+  case SIGN_GE: return a >= b;
+  default: return false;
+  }
+}
+
+inline int LoadInt(const char *p) {
+  int a;
+  memcpy(&a, p, 4);
+  return a;
+}
+
+inline float LoadFloat(const char *p) {
+  float a;
+  memcpy(&a, p, 4);
+  return a;
+}
+
+inline void ClearRow(uint64_t *mask, int r) {
+  mask[r >> 6] &= ~((uint64_t)1 << (r & 63));
+}
+
+// Rows [from, count) one at a time; also finishes the SIMD kernels.
+template <int SIGN>
+void IntCmpRows(const char *base, int stride, int from, int count, int value,
+                uint64_t *mask) {
+  for (int r = from; r < count; ++r) {
+    if (!Test<SIGN>(LoadInt(base + r * stride), value)) {
+      ClearRow(mask, r);
+    }
+  }
+}
+
+template <int SIGN>
+void FloatCmpRows(const char *base, int stride, int from, int count,
+                  float value, uint64_t *mask) {
+  for (int r = from; r < count; ++r) {
+    if (!Test<SIGN>(LoadFloat(base + r * stride), value)) {
+      ClearRow(mask, r);
+    }
+  }
+}
+
+void IntRangeRows(const char *base, int stride, int from, int count, int lo,
+                  int hi, uint64_t *mask) {
+  for (int r = from; r < count; ++r) {
+    int a = LoadInt(base + r * stride);
+    if (a < lo || a > hi) {
+      ClearRow(mask, r);
+    }
+  }
+}
+
+void FloatRangeRows(const char *base, int stride, int from, int count,
+                    float lo, bool lo_strict, float hi, bool hi_strict,
+                    uint64_t *mask) {
+  for (int r = from; r < count; ++r) {
+    float a = LoadFloat(base + r * stride);
+    bool pass = (lo_strict ? a > lo : a >= lo) && (hi_strict ? a < hi : a <= hi);
+    if (!pass) {
+      ClearRow(mask, r);
+    }
+  }
+}
+
+template <int SIGN>
+void CharCmpRows(const char *base, int stride, int length, int from,
+                 int count, const char *value, uint64_t *mask) {
+  for (int r = from; r < count; ++r) {
+    if (!Test<SIGN>(strncmp(base + r * stride, value, length), 0)) {
+      ClearRow(mask, r);
+    }
+  }
+}
+
+// Run K<SIGN>::Run(args...) for a sign known only at run time.
+template <template <int> class K, typename... Args>
+void DispatchSign(int sign, Args... args) {
+  switch (sign) {
+  case SIGN_EQ: K<SIGN_EQ>::Run(args...); break;
+  case SIGN_NE: K<SIGN_NE>::Run(args...); break;
+  case SIGN_LT: K<SIGN_LT>::Run(args...); break;
+  case SIGN_GT: K<SIGN_GT>::Run(args...); break;
+  case SIGN_LE: K<SIGN_LE>::Run(args...); break;
+  case SIGN_GE: K<SIGN_GE>::Run(args...); break;
+  }
+}
+
+template <int SIGN> struct ScalarIntCmpK {
+  static void Run(const char *base, int stride, int count, int value,
+                  uint64_t *mask) {
+    IntCmpRows<SIGN>(base, stride, 0, count, value, mask);
+  }
+};
+
+template <int SIGN> struct ScalarFloatCmpK {
+  static void Run(const char *base, int stride, int count, float value,
+                  uint64_t *mask) {
+    FloatCmpRows<SIGN>(base, stride, 0, count, value, mask);
+  }
+};
+
+template <int SIGN> struct ScalarCharCmpK {
+  static void Run(const char *base, int stride, int length, int count,
+                  const char *value, uint64_t *mask) {
+    CharCmpRows<SIGN>(base, stride, length, 0, count, value, mask);
+  }
+};
+
+void ScalarIntCmp(const char *base, int stride, int count, int sign,
+                  int value, uint64_t *mask) {
+  DispatchSign<ScalarIntCmpK>(sign, base, stride, count, value, mask);
+}
+
+void ScalarIntRange(const char *base, int stride, int count, int lo, int hi,
+                    uint64_t *mask) {
+  IntRangeRows(base, stride, 0, count, lo, hi, mask);
+}
+
+void ScalarFloatCmp(const char *base, int stride, int count, int sign,
+                    float value, uint64_t *mask) {
+  DispatchSign<ScalarFloatCmpK>(sign, base, stride, count, value, mask);
+}
+
+void ScalarFloatRange(const char *base, int stride, int count, float lo,
+                      bool lo_strict, float hi, bool hi_strict,
+                      uint64_t *mask) {
+  FloatRangeRows(base, stride, 0, count, lo, lo_strict, hi, hi_strict, mask);
+}
+
+void ScalarCharCmp(const char *base, int stride, int length, int count,
+                   int sign, const char *value, uint64_t *mask) {
+  DispatchSign<ScalarCharCmpK>(sign, base, stride, length, count, value,
+                               mask);
+}
+
+const FilterKernels kScalarKernels = {ScalarIntCmp,   ScalarIntRange,
+                                      ScalarFloatCmp, ScalarFloatRange,
+                                      ScalarCharCmp,  "scalar"};
+
+#ifdef MINIDB_X86_KERNELS
+
+// Clear the rows of a group of `width` rows starting at r whose bit is set
+// in `failed`. Groups never straddle a mask word since width divides 64.
+inline void ClearGroup(uint64_t *mask, int r, uint64_t failed) {
+  mask[r >> 6] &= ~(failed << (r & 63));
+}
+
+//=======================SSE4.2=======================//
+
+TARGET_SSE42 inline __m128i SseLoadInt(const char *p, int stride) {
+  if (stride == 4) {
+    return _mm_loadu_si128((const __m128i *)p);
+  }
+  return _mm_setr_epi32(LoadInt(p), LoadInt(p + stride),
+                        LoadInt(p + 2 * stride), LoadInt(p + 3 * stride));
+}
+
+TARGET_SSE42 inline __m128 SseLoadFloat(const char *p, int stride) {
+  return _mm_castsi128_ps(SseLoadInt(p, stride));
+}
+
+// Lanes that fail `a <SIGN> v`, as a 4-bit mask.
+template <int SIGN>
+TARGET_SSE42 inline uint64_t SseIntFail(__m128i a, __m128i v) {
+  switch (SIGN) {
+  case SIGN_EQ: return 0xF & ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, v)));
+  case SIGN_NE: return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, v)));
+  case SIGN_LT: return 0xF & ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, a)));
+  case SIGN_GT: return 0xF & ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, v)));
+  case SIGN_LE: return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, v)));
+  case SIGN_GE: return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, a)));
+  default: return 0xF;
+  }
+}
+
+template <int SIGN>
+TARGET_SSE42 inline uint64_t SseFloatFail(__m128 a, __m128 v) {
+  switch (SIGN) {
+  case SIGN_EQ: return 0xF & ~_mm_movemask_ps(_mm_cmpeq_ps(a, v));
+  case SIGN_NE: return 0xF & ~_mm_movemask_ps(_mm_cmpneq_ps(a, v));
+  case SIGN_LT: return 0xF & ~_mm_movemask_ps(_mm_cmplt_ps(a, v));
+  case SIGN_GT: return 0xF & ~_mm_movemask_ps(_mm_cmpgt_ps(a, v));
+  case SIGN_LE: return 0xF & ~_mm_movemask_ps(_mm_cmple_ps(a, v));
+  case SIGN_GE: return 0xF & ~_mm_movemask_ps(_mm_cmpge_ps(a, v));
+  default: return 0xF;
+  }
+}
+
+template <int SIGN> struct SseIntCmpK {
+  TARGET_SSE42 static void Run(const char *base, int stride, int count,
+                               int value, uint64_t *mask) {
+    const __m128i v = _mm_set1_epi32(value);
+    int r = 0;
+    for (; r + 4 <= count; r += 4) {
+      ClearGroup(mask, r, SseIntFail<SIGN>(SseLoadInt(base + r * stride, stride), v));
+    }
+    IntCmpRows<SIGN>(base, stride, r, count, value, mask);
+  }
+};
+
+template <int SIGN> struct SseFloatCmpK {
+  TARGET_SSE42 static void Run(const char *base, int stride, int count,
+                               float value, uint64_t *mask) {
+    const __m128 v = _mm_set1_ps(value);
+    int r = 0;
+    for (; r + 4 <= count; r += 4) {
+      ClearGroup(mask, r, SseFloatFail<SIGN>(SseLoadFloat(base + r * stride, stride), v));
+    }
+    FloatCmpRows<SIGN>(base, stride, r, count, value, mask);
+  }
+};
+
+TARGET_SSE42 void SseIntCmp(const char *base, int stride, int count, int sign,
+                            int value, uint64_t *mask) {
+  DispatchSign<SseIntCmpK>(sign, base, stride, count, value, mask);
+}
+
+TARGET_SSE42 void SseIntRange(const char *base, int stride, int count, int lo,
+                              int hi, uint64_t *mask) {
+  const __m128i vlo = _mm_set1_epi32(lo);
+  const __m128i vhi = _mm_set1_epi32(hi);
+  int r = 0;
+  for (; r + 4 <= count; r += 4) {
+    __m128i a = SseLoadInt(base + r * stride, stride);
+    __m128i fail = _mm_or_si128(_mm_cmpgt_epi32(vlo, a), _mm_cmpgt_epi32(a, vhi));
+    ClearGroup(mask, r, _mm_movemask_ps(_mm_castsi128_ps(fail)));
+  }
+  IntRangeRows(base, stride, r, count, lo, hi, mask);
+}
+
+TARGET_SSE42 void SseFloatCmp(const char *base, int stride, int count,
+                              int sign, float value, uint64_t *mask) {
+  DispatchSign<SseFloatCmpK>(sign, base, stride, count, value, mask);
+}
+
+TARGET_SSE42 void SseFloatRange(const char *base, int stride, int count,
+                                float lo, bool lo_strict, float hi,
+                                bool hi_strict, uint64_t *mask) {
+  const __m128 vlo = _mm_set1_ps(lo);
+  const __m128 vhi = _mm_set1_ps(hi);
+  int r = 0;
+  for (; r + 4 <= count; r += 4) {
+    __m128 a = SseLoadFloat(base + r * stride, stride);
+    __m128 plo = lo_strict ? _mm_cmpgt_ps(a, vlo) : _mm_cmpge_ps(a, vlo);
+    __m128 phi = hi_strict ? _mm_cmplt_ps(a, vhi) : _mm_cmple_ps(a, vhi);
+    ClearGroup(mask, r, 0xF & ~_mm_movemask_ps(_mm_and_ps(plo, phi)));
+  }
+  FloatRangeRows(base, stride, r, count, lo, lo_strict, hi, hi_strict, mask);
+}
+
+// strncmp of up to 16 bytes with one PCMPISTRI: both sides are copied into
+// zero padded registers, so the implicit string ends match strncmp.
+template <int SIGN> struct SseCharCmpK {
+  TARGET_SSE42 static void Run(const char *base, int stride, int length,
+                               int count, const char *value, uint64_t *mask) {
+    char vbuf[16] = {0};
+    memcpy(vbuf, value, length);
+    const __m128i v = _mm_loadu_si128((const __m128i *)vbuf);
+    char fbuf[16] = {0};
+    for (int r = 0; r < count; ++r) {
+      memcpy(fbuf, base + r * stride, length);
+      __m128i f = _mm_loadu_si128((const __m128i *)fbuf);
+      int i = _mm_cmpistri(f, v, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH |
+                                     _SIDD_NEGATIVE_POLARITY |
+                                     _SIDD_LEAST_SIGNIFICANT);
+      int cmp = i == 16 ? 0 : (unsigned char)fbuf[i] - (unsigned char)vbuf[i];
+      if (!Test<SIGN>(cmp, 0)) {
+        ClearRow(mask, r);
+      }
+    }
+  }
+};
+
+TARGET_SSE42 void SseCharCmp(const char *base, int stride, int length,
+                             int count, int sign, const char *value,
+                             uint64_t *mask) {
+  if (length > 16) {
+    ScalarCharCmp(base, stride, length, count, sign, value, mask);
+    return;
+  }
+  DispatchSign<SseCharCmpK>(sign, base, stride, length, count, value, mask);
+}
+
+const FilterKernels kSse42Kernels = {SseIntCmp,   SseIntRange, SseFloatCmp,
+                                     SseFloatRange, SseCharCmp, "sse4.2"};
+
+//=======================AVX2=======================//
+
+// Eight values `stride` bytes apart; a plain load when they are packed.
+TARGET_AVX2 inline __m256i AvxLoadInt(const char *p, int stride, __m256i vidx) {
+  if (stride == 4) {
+    return _mm256_loadu_si256((const __m256i *)p);
+  }
+  return _mm256_i32gather_epi32((const int *)p, vidx, 1);
+}
+
+TARGET_AVX2 inline __m256 AvxLoadFloat(const char *p, int stride, __m256i vidx) {
+  return _mm256_castsi256_ps(AvxLoadInt(p, stride, vidx));
+}
+
+TARGET_AVX2 inline __m256i AvxGatherIndex(int stride) {
+  return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                            _mm256_set1_epi32(stride));
+}
+
+TARGET_AVX2 inline uint64_t AvxBits(__m256i m) {
+  return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+template <int SIGN>
+TARGET_AVX2 inline uint64_t AvxIntFail(__m256i a, __m256i v) {
+  switch (SIGN) {
+  case SIGN_EQ: return 0xFF & ~AvxBits(_mm256_cmpeq_epi32(a, v));
+  case SIGN_NE: return AvxBits(_mm256_cmpeq_epi32(a, v));
+  case SIGN_LT: return 0xFF & ~AvxBits(_mm256_cmpgt_epi32(v, a));
+  case SIGN_GT: return 0xFF & ~AvxBits(_mm256_cmpgt_epi32(a, v));
+  case SIGN_LE: return AvxBits(_mm256_cmpgt_epi32(a, v));
+  case SIGN_GE: return AvxBits(_mm256_cmpgt_epi32(v, a));
+  default: return 0xFF;
+  }
+}
+
+template <int SIGN>
+TARGET_AVX2 inline uint64_t AvxFloatFail(__m256 a, __m256 v) {
+  switch (SIGN) {
+  case SIGN_EQ: return 0xFF & ~_mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_EQ_OQ));
+  case SIGN_NE: return 0xFF & ~_mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_NEQ_UQ));
+  case SIGN_LT: return 0xFF & ~_mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_LT_OQ));
+  case SIGN_GT: return 0xFF & ~_mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_GT_OQ));
+  case SIGN_LE: return 0xFF & ~_mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_LE_OQ));
+  case SIGN_GE: return 0xFF & ~_mm256_movemask_ps(_mm256_cmp_ps(a, v, _CMP_GE_OQ));
+  default: return 0xFF;
+  }
+}
+
+template <int SIGN> struct AvxIntCmpK {
+  TARGET_AVX2 static void Run(const char *base, int stride, int count,
+                              int value, uint64_t *mask) {
+    const __m256i vidx = AvxGatherIndex(stride);
+    const __m256i v = _mm256_set1_epi32(value);
+    int r = 0;
+    for (; r + 8 <= count; r += 8) {
+      ClearGroup(mask, r, AvxIntFail<SIGN>(AvxLoadInt(base + r * stride, stride, vidx), v));
+    }
+    IntCmpRows<SIGN>(base, stride, r, count, value, mask);
+  }
+};
+
+template <int SIGN> struct AvxFloatCmpK {
+  TARGET_AVX2 static void Run(const char *base, int stride, int count,
+                              float value, uint64_t *mask) {
+    const __m256i vidx = AvxGatherIndex(stride);
+    const __m256 v = _mm256_set1_ps(value);
+    int r = 0;
+    for (; r + 8 <= count; r += 8) {
+      ClearGroup(mask, r, AvxFloatFail<SIGN>(AvxLoadFloat(base + r * stride, stride, vidx), v));
+    }
+    FloatCmpRows<SIGN>(base, stride, r, count, value, mask);
+  }
+};
+
+TARGET_AVX2 void AvxIntCmp(const char *base, int stride, int count, int sign,
+                           int value, uint64_t *mask) {
+  DispatchSign<AvxIntCmpK>(sign, base, stride, count, value, mask);
+}
+
+TARGET_AVX2 void AvxIntRange(const char *base, int stride, int count, int lo,
+                             int hi, uint64_t *mask) {
+  const __m256i vidx = AvxGatherIndex(stride);
+  const __m256i vlo = _mm256_set1_epi32(lo);
+  const __m256i vhi = _mm256_set1_epi32(hi);
+  int r = 0;
+  for (; r + 8 <= count; r += 8) {
+    __m256i a = AvxLoadInt(base + r * stride, stride, vidx);
+    __m256i fail = _mm256_or_si256(_mm256_cmpgt_epi32(vlo, a), _mm256_cmpgt_epi32(a, vhi));
+    ClearGroup(mask, r, AvxBits(fail));
+  }
+  IntRangeRows(base, stride, r, count, lo, hi, mask);
+}
+
+TARGET_AVX2 void AvxFloatCmp(const char *base, int stride, int count, int sign,
+                             float value, uint64_t *mask) {
+  DispatchSign<AvxFloatCmpK>(sign, base, stride, count, value, mask);
+}
+
+TARGET_AVX2 void AvxFloatRange(const char *base, int stride, int count,
+                               float lo, bool lo_strict, float hi,
+                               bool hi_strict, uint64_t *mask) {
+  const __m256i vidx = AvxGatherIndex(stride);
+  const __m256 vlo = _mm256_set1_ps(lo);
+  const __m256 vhi = _mm256_set1_ps(hi);
+  int r = 0;
+  for (; r + 8 <= count; r += 8) {
+    __m256 a = AvxLoadFloat(base + r * stride, stride, vidx);
+    __m256 plo = lo_strict ? _mm256_cmp_ps(a, vlo, _CMP_GT_OQ)
+                           : _mm256_cmp_ps(a, vlo, _CMP_GE_OQ);
+    __m256 phi = hi_strict ? _mm256_cmp_ps(a, vhi, _CMP_LT_OQ)
+                           : _mm256_cmp_ps(a, vhi, _CMP_LE_OQ);
+    ClearGroup(mask, r, 0xFF & ~_mm256_movemask_ps(_mm256_and_ps(plo, phi)));
+  }
+  FloatRangeRows(base, stride, r, count, lo, lo_strict, hi, hi_strict, mask);
+}
+
+// Strings are compared with the SSE4.2 kernel, every AVX2 CPU has it.
+const FilterKernels kAvx2Kernels = {AvxIntCmp,     AvxIntRange, AvxFloatCmp,
+                                    AvxFloatRange, SseCharCmp,  "avx2"};
+
+#endif // MINIDB_X86_KERNELS
+
+} // namespace
+
+const FilterKernels &GetFilterKernels() {
+  static const FilterKernels *kernels = GetSupportedFilterKernels().front();
+  return *kernels;
+}
+
+const FilterKernels &GetScalarFilterKernels() { return kScalarKernels; }
+
+std::vector<const FilterKernels *> GetSupportedFilterKernels() {
+  std::vector<const FilterKernels *> kernels;
+#ifdef MINIDB_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back(&kAvx2Kernels);
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    kernels.push_back(&kSse42Kernels);
+  }
+#endif
+  kernels.push_back(&kScalarKernels);
+  return kernels;
+}
+
+void FillSelectionMask(uint64_t *mask, int count) {
+  int words = (count + 63) / 64;
+  for (int w = 0; w < words; ++w) {
+    mask[w] = ~(uint64_t)0;
+  }
+  if (count % 64 != 0) {
+    mask[words - 1] = ((uint64_t)1 << (count % 64)) - 1;
+  }
+}
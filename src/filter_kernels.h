@@ -0,0 +1,48 @@
+#ifndef MINIDB_FILTER_KERNELS_H_
+#define MINIDB_FILTER_KERNELS_H_
+
+#include <stdint.h>
+#include <vector>
+
+// Filter kernels test one column over a block's worth of rows at a time.
+// The values are read `stride` bytes apart starting at `base`, so the same
+// kernel works on records inside a page (stride = record length) and on
+// packed columns (stride = field length). Each kernel clears, in `mask`, the
+// bit of every row that fails the test (bit r of mask[r / 64]); bits that
+// are already clear are left alone, so terms are AND-ed by running their
+// kernels one after another.
+struct FilterKernels {
+  // field <sign> value
+  void (*int_cmp)(const char *base, int stride, int count, int sign,
+                  int value, uint64_t *mask);
+  // lo <= field <= hi
+  void (*int_range)(const char *base, int stride, int count, int lo, int hi,
+                    uint64_t *mask);
+  // field <sign> value
+  void (*float_cmp)(const char *base, int stride, int count, int sign,
+                    float value, uint64_t *mask);
+  // lo <(=) field <(=) hi, a strict flag makes that bound exclusive
+  void (*float_range)(const char *base, int stride, int count, float lo,
+                      bool lo_strict, float hi, bool hi_strict,
+                      uint64_t *mask);
+  // strncmp(field, value, length) <sign> 0
+  void (*char_cmp)(const char *base, int stride, int length, int count,
+                   int sign, const char *value, uint64_t *mask);
+  const char *name; // "avx2", "sse4.2" or "scalar"
+};
+
+// Kernels for the best instruction set supported by the running CPU,
+// selected once on first use.
+const FilterKernels &GetFilterKernels();
+
+// Portable kernels, always available.
+const FilterKernels &GetScalarFilterKernels();
+
+// Every set of kernels the running CPU supports, best first; the first is
+// the one GetFilterKernels returns and the last the scalar one.
+std::vector<const FilterKernels *> GetSupportedFilterKernels();
+
+// Set the first `count` bits of `mask` and clear the rest of its last word.
+void FillSelectionMask(uint64_t *mask, int count);
+
+#endif /* MINIDB_FILTER_KERNELS_H_ */
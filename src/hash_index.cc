@@ -0,0 +1,241 @@
+#include "hash_index.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+HashIndex::HashIndex(Index *idx, BufferManager *hdl, std::string db_name)
+    : idx_(idx), hdl_(hdl), db_name_(db_name) {
+  capacity_ = (4 * 1024 - 12) / (4 + idx->key_len());
+  prefix_len_ = idx->unique() ? idx->key_len() : idx->key_len() - 4;
+}
+
+BlockInfo *HashIndex::GetPage(int block_num) {
+  return hdl_->GetFileBlock(db_name_, idx_->name(), FORMAT_INDEX, block_num);
+}
+
+int HashIndex::NewPage() {
+  int block_num = idx_->rubbish();
+  if (block_num != -1) {
+    idx_->set_rubbish(GetPage(block_num)->GetNextBlockNum());
+  } else {
+    block_num = idx_->IncreaseMaxCount();
+  }
+  BlockInfo *page = GetPage(block_num);
+  page->SetPrevBlockNum(-1);
+  page->SetNextBlockNum(-1);
+  page->SetRecordCount(0);
+  page->set_dirty(true);
+  return block_num;
+}
+
+void HashIndex::FreePage(int block_num) {
+  BlockInfo *page = GetPage(block_num);
+  page->SetNextBlockNum(idx_->rubbish());
+  page->set_dirty(true);
+  idx_->set_rubbish(block_num);
+}
+
+uint32_t HashIndex::Hash(const char *key) {
+  // FNV-1a, then the final mix of MurmurHash3 so that the low bits, which
+  // pick the bucket, depend on every byte.
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < prefix_len_; ++i) {
+    h = (h ^ (unsigned char)key[i]) * 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+int HashIndex::GetBucket(uint32_t hash) {
+  // With n buckets and m the largest power of two up to n, the buckets
+  // below n - m have been split into themselves and their images from m
+  // on; the others still take the hashes of their images.
+  uint32_t n = idx_->buckets().size();
+  uint32_t m = 1;
+  while (m * 2 <= n) {
+    m *= 2;
+  }
+  uint32_t bucket = hash & (m - 1);
+  if (bucket < n - m) {
+    bucket = hash & (2 * m - 1);
+  }
+  return bucket;
+}
+
+void HashIndex::AddEntry(int block_num, const char *entry) {
+  int size = 4 + idx_->key_len();
+  for (;;) {
+    BlockInfo *page = GetPage(block_num);
+    int count = page->GetRecordCount();
+    if (count < capacity_) {
+      memcpy(page->GetContentAddress() + count * size, entry, size);
+      page->SetRecordCount(count + 1);
+      page->set_dirty(true);
+      return;
+    }
+    int next = page->GetNextBlockNum();
+    if (next == -1) {
+      // Getting the new page may push this one out of the buffer.
+      next = NewPage();
+      page = GetPage(block_num);
+      page->SetNextBlockNum(next);
+      page->set_dirty(true);
+    }
+    block_num = next;
+  }
+}
+
+void HashIndex::Split() {
+  vector<int> &buckets = idx_->buckets();
+  int n = buckets.size();
+  int m = 1;
+  while (m * 2 <= n) {
+    m *= 2;
+  }
+  int size = 4 + idx_->key_len();
+
+  // Take the entries out of the bucket, keeping only its first page.
+  vector<char> entries;
+  int block_num = buckets[n - m];
+  while (block_num != -1) {
+    BlockInfo *page = GetPage(block_num);
+    char *content = page->GetContentAddress();
+    entries.insert(entries.end(), content,
+                   content + page->GetRecordCount() * size);
+    int next = page->GetNextBlockNum();
+    if (block_num == buckets[n - m]) {
+      page->SetRecordCount(0);
+      page->SetNextBlockNum(-1);
+      page->set_dirty(true);
+    } else {
+      FreePage(block_num);
+    }
+    block_num = next;
+  }
+
+  // Each entry goes back to the bucket or to its new image.
+  int image = NewPage();
+  buckets.push_back(image);
+  for (size_t i = 0; i < entries.size(); i += size) {
+    AddEntry(buckets[GetBucket(Hash(&entries[i] + 4))], &entries[i]);
+  }
+}
+
+void HashIndex::Init(long keys) {
+  long n = (long)ceil(keys / (HASH_LOAD_FACTOR * capacity_));
+  for (long i = max(1L, n); i > 0; --i) {
+    idx_->buckets().push_back(NewPage());
+  }
+}
+
+void HashIndex::Add(TKey &key, int block_num, int offset) {
+  if (idx_->buckets().empty()) {
+    Init(0);
+  }
+  vector<char> entry(4 + idx_->key_len());
+  int val = (block_num << 16) | offset;
+  memcpy(&entry[0], &val, 4);
+  memcpy(&entry[4], key.key(), idx_->key_len());
+  AddEntry(idx_->buckets()[GetBucket(Hash(key.key()))], &entry[0]);
+  idx_->IncreaseKeyCount();
+
+  if (idx_->key_count() >
+      HASH_LOAD_FACTOR * capacity_ * idx_->buckets().size()) {
+    Split();
+  }
+}
+
+bool HashIndex::Remove(TKey &key) {
+  if (idx_->buckets().empty()) {
+    return false;
+  }
+  int size = 4 + idx_->key_len();
+  int prev = -1;
+  int block_num = idx_->buckets()[GetBucket(Hash(key.key()))];
+  while (block_num != -1) {
+    BlockInfo *page = GetPage(block_num);
+    char *content = page->GetContentAddress();
+    int count = page->GetRecordCount();
+    for (int i = 0; i < count; ++i) {
+      if (memcmp(content + i * size + 4, key.key(), idx_->key_len()) != 0) {
+        continue;
+      }
+      // The last entry of the page fills the gap.
+      memmove(content + i * size, content + (count - 1) * size, size);
+      page->SetRecordCount(count - 1);
+      page->set_dirty(true);
+      idx_->DecreaseKeyCount();
+      // An emptied overflow page leaves the chain.
+      if (count == 1 && prev != -1) {
+        int next = page->GetNextBlockNum();
+        BlockInfo *prev_page = GetPage(prev);
+        prev_page->SetNextBlockNum(next);
+        prev_page->set_dirty(true);
+        FreePage(block_num);
+      }
+      return true;
+    }
+    prev = block_num;
+    block_num = page->GetNextBlockNum();
+  }
+  return false;
+}
+
+bool HashIndex::SetVal(TKey &key, int block_num, int offset) {
+  if (idx_->buckets().empty()) {
+    return false;
+  }
+  int size = 4 + idx_->key_len();
+  int num = idx_->buckets()[GetBucket(Hash(key.key()))];
+  while (num != -1) {
+    BlockInfo *page = GetPage(num);
+    char *content = page->GetContentAddress();
+    for (int i = 0; i < page->GetRecordCount(); ++i) {
+      if (memcmp(content + i * size + 4, key.key(), idx_->key_len()) == 0) {
+        int val = (block_num << 16) | offset;
+        memcpy(content + i * size, &val, 4);
+        page->set_dirty(true);
+        return true;
+      }
+    }
+    num = page->GetNextBlockNum();
+  }
+  return false;
+}
+
+void HashIndex::Lookup(const char *key, std::vector<int> &vals) {
+  if (idx_->buckets().empty()) {
+    return;
+  }
+  int size = 4 + idx_->key_len();
+  int block_num = idx_->buckets()[GetBucket(Hash(key))];
+  while (block_num != -1) {
+    BlockInfo *page = GetPage(block_num);
+    char *content = page->GetContentAddress();
+    for (int i = 0; i < page->GetRecordCount(); ++i) {
+      if (memcmp(content + i * size + 4, key, prefix_len_) == 0) {
+        int val;
+        memcpy(&val, content + i * size, 4);
+        vals.push_back(val);
+        // A unique key is held once.
+        if (idx_->unique()) {
+          return;
+        }
+      }
+    }
+    block_num = page->GetNextBlockNum();
+  }
+}
+
+void HashIndex::Print() {
+  printf("*****************************************************\n");
+  printf("KeyCount: %d, Buckets: %d \n", idx_->key_count(),
+         (int)idx_->buckets().size());
+}
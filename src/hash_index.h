@@ -0,0 +1,65 @@
+#ifndef MINIDB_HASH_INDEX_H_
+#define MINIDB_HASH_INDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "buffer_manager.h"
+#include "catalog_manager.h"
+#include "sql_statement.h"
+
+// Share of the bucket pages the entries fill before a bucket is split.
+#define HASH_LOAD_FACTOR 0.75
+
+// HashIndex: a linear hashing index over the blocks of an index file. A
+// bucket is a page, chained to overflow pages through the block header,
+// whose entries are a value followed by the key, as in a B+ tree leaf; the
+// catalog holds the first page of each bucket. Once the entries fill the
+// pages past HASH_LOAD_FACTOR the next bucket in turn is split in two, so
+// the chains stay about one page long and a lookup reads one page, or two.
+//
+// Keys are of type T_BYTES, made by MakeIndexKey. Only the fields are
+// hashed, not the record id a non-unique key ends with, so a lookup finds
+// every entry of a value in one bucket. Pages are fetched by number each
+// time they are used, as the buffer does not pin them.
+class HashIndex {
+private:
+  Index *idx_;
+  BufferManager *hdl_;
+  std::string db_name_;
+  int capacity_;   // Entries a page holds.
+  int prefix_len_; // Bytes of a key hashed: the fields.
+
+  BlockInfo *GetPage(int block_num);
+  int NewPage();
+  void FreePage(int block_num);
+  uint32_t Hash(const char *key);
+  int GetBucket(uint32_t hash);
+  // Append an entry of 4 + key_len bytes to the chain starting at
+  // `block_num`.
+  void AddEntry(int block_num, const char *entry);
+  void Split();
+
+public:
+  HashIndex(Index *idx, BufferManager *hdl, std::string db_name);
+
+  Index *idx() { return idx_; }
+  int prefix_len() { return prefix_len_; }
+
+  // Give an empty index enough buckets for `keys` entries, so that they
+  // are added without splitting.
+  void Init(long keys);
+  void Add(TKey &key, int block_num, int offset);
+  // Remove the entry of `key`, record id included; false if it is absent.
+  bool Remove(TKey &key);
+  // Point an existing key at a new record; false if the key is absent.
+  bool SetVal(TKey &key, int block_num, int offset);
+  // Append to `vals` the values of the entries whose first prefix_len()
+  // bytes are those of `key`.
+  void Lookup(const char *key, std::vector<int> &vals);
+
+  void Print();
+};
+
+#endif
@@ -1,10 +1,16 @@
 #include "index_manager.h"
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <stdint.h>
 
 #include "commons.h"
+#include "bitmap_index.h"
 #include "exceptions.h"
+#include "hash_index.h"
 #include "record_manager.h"
 #include "sql_statement.h"
 
@@ -21,52 +27,147 @@ void IndexManager::CreateIndex(SQLCreateIndex &st) {
     throw TableNotExistException();
   }
 
-  if (tbl->GetIndexNum() != 0) {
-    throw OneIndexEachTableException();
+  // The key attributes, and the primary key, which an index over the same
+  // attributes holds once each.
+  vector<int> cols;
+  int key_len = 0;
+  for (unsigned int i = 0; i < st.col_names().size(); ++i) {
+    int col = tbl->GetAttributeIndex(st.col_names()[i]);
+    if (col == -1) {
+      throw AttributeNotExistException();
+    }
+    cols.push_back(col);
+    key_len += tbl->ats()[col].length();
+  }
+  vector<int> pk;
+  for (unsigned int i = 0; i < tbl->GetAttributeNum(); ++i) {
+    if (tbl->ats()[i].attr_type() == 1) {
+      pk.push_back(i);
+    }
+  }
+  vector<int> sorted_cols = cols;
+  sort(sorted_cols.begin(), sorted_cols.end());
+  // A bitmap index is on one column and always carries the record id, as
+  // it keeps records by their value.
+  if (st.method() == INDEX_BITMAP && cols.size() != 1) {
+    throw SyntaxErrorException();
+  }
+  bool unique = sorted_cols == pk && st.method() != INDEX_BITMAP;
+  // Hash keys are always bytes, so that equal values hash alike, and so
+  // are keys followed by included attributes.
+  int key_type = T_BYTES;
+  if (unique && cols.size() == 1 && st.method() == INDEX_BTREE &&
+      st.include_names().empty()) {
+    key_type = tbl->ats()[cols[0]].data_type();
+  } else if (!unique) {
+    key_len += 4;
   }
 
-  Attribute *attr = tbl->GetAttribute(st.col_name());
-  if (attr->attr_type() != 1) {
-    throw IndexMustBeCreatedOnPKException();
+  // The included attributes are read along with the key ones. They only
+  // ride in the entries of a B+ tree, which a scan can answer from.
+  vector<int> read_cols = cols;
+  if (!st.include_names().empty() && st.method() != INDEX_BTREE) {
+    throw SyntaxErrorException();
+  }
+  for (unsigned int i = 0; i < st.include_names().size(); ++i) {
+    int col = tbl->GetAttributeIndex(st.include_names()[i]);
+    if (col == -1) {
+      throw AttributeNotExistException();
+    }
+    read_cols.push_back(col);
+    key_len += tbl->ats()[col].length();
+  }
+  int rank = (4 * 1024 - 12) / (4 + key_len) / 2 - 1;
+  if (rank < 1) {
+    throw BPlusTreeException();
   }
 
   string file_name = cm_->path() + db_name_ + "/" + st.index_name() + ".index";
   std::ofstream ofs(file_name.c_str(), std::ios::binary);
   ofs.close();
 
-  Index idx(st.index_name(), st.col_name(), attr->data_type(), attr->length(),
-            (4 * 1024 - 12) / (4 + attr->length()) / 2 - 1);
+  Index idx(st.index_name(), st.col_names(), key_type, key_len, rank, unique,
+            st.method());
+  idx.set_include_names(st.include_names());
 
   tbl->AddIndex(idx);
 
-  BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
+  BPlusTree tree(tbl->GetIndex(tbl->GetIndexNum() - 1), hdl_, cm_, db_name_);
+  HashIndex hash(tree.idx(), hdl_, db_name_);
+  BitmapIndex bitmap(tbl, tree.idx(), hdl_, db_name_);
 
   RecordManager *rm = new RecordManager(cm_, hdl_, db_name_);
 
-  int col_idx = tbl->GetAttributeIndex(st.col_name());
-
-  int block_num = tbl->first_block_num();
-  for (int i = 0; i < tbl->block_count(); ++i) {
-    BlockInfo *bp = rm->GetBlockInfo(tbl, block_num);
+  // A hash index gets its buckets up front, for as many keys as the blocks
+  // of the table can hold.
+  if (st.method() == INDEX_HASH) {
+    hash.Init((long)rm->GetBlocks(tbl).size() * tbl->GetMaxRecordCount());
+  }
 
-    for (int j = 0; j < bp->GetRecordCount(); ++j) {
-      vector<TKey> tkey_value = rm->GetRecord(tbl, block_num, j);
-      tree.Add(tkey_value[col_idx], block_num, j);
+  // Only the key and included columns are read. The keys of each batch are
+  // added before the next one is read; the index goes through the locked
+  // GetFileBlock path, which a parallel scan allows while it is open.
+  vector<SQLWhere> wheres;
+  Operator *scan = rm->ScanTable(tbl, wheres, read_cols, false);
+  Batch batch;
+  batch.Init(scan->schema());
+  vector<const char *> fields(read_cols.size());
+  try {
+    scan->Open();
+    while (scan->Next(batch)) {
+      for (int i = 0; i < batch.sel_count(); ++i) {
+        int r = batch.sel(i);
+        for (unsigned int c = 0; c < read_cols.size(); ++c) {
+          fields[c] = batch.col(c).At(r);
+        }
+        int rid = batch.rid(r);
+        TKey key = MakeIndexKey(tbl, tree.idx(), fields.data(), rid);
+        if (st.method() == INDEX_HASH) {
+          hash.Add(key, (rid >> 16) & 0xffff, rid & 0xffff);
+        } else if (st.method() == INDEX_BITMAP) {
+          bitmap.Add(key, (rid >> 16) & 0xffff, rid & 0xffff);
+        } else {
+          tree.Add(key, (rid >> 16) & 0xffff, rid & 0xffff);
+        }
+      }
     }
-
-    block_num = bp->GetNextBlockNum();
+  } catch (...) {
+    delete scan;
+    throw;
   }
+  scan->Close();
+  delete scan;
 
   delete rm;
 
   hdl_->WriteToDisk();
   cm_->WriteArchiveFile();
 
-  tree.Print();
+  if (st.method() == INDEX_HASH) {
+    hash.Print();
+  } else if (st.method() == INDEX_BITMAP) {
+    bitmap.Print();
+  } else {
+    tree.Print();
+  }
 }
 
 //=======================BPlusTree=======================//
 
+namespace {
+
+// Keeps the nodes `tree` fetches in the buffer while it is in scope.
+class NodePins {
+public:
+  explicit NodePins(BPlusTree *tree) : tree_(tree) { tree_->StartPinning(); }
+  ~NodePins() { tree_->StopPinning(); }
+
+private:
+  BPlusTree *tree_;
+};
+
+} // namespace
+
 void BPlusTree::InitTree() {
   BPlusTreeNode *root_node =
       new BPlusTreeNode(true, this, GetNewBlockNum(), true);
@@ -76,9 +177,11 @@ void BPlusTree::InitTree() {
   idx_->set_node_count(1);
   idx_->set_level(1);
   root_node->SetNextLeaf(-1);
+  root_node->SetPrevLeaf(-1);
 }
 
 bool BPlusTree::Add(TKey &key, int block_num, int offset) {
+  NodePins pins(this);
   int value = (block_num << 16) | offset;
 
   if (idx_->root() == -1) {
@@ -200,6 +303,34 @@ BPlusTreeNode *BPlusTree::GetNode(int num) {
   return pnode;
 }
 
+BlockInfo *BPlusTree::GetNodeBlock(int num) {
+  BlockInfo *block = hdl_->GetFileBlock(db_name_, idx_->name(), FORMAT_INDEX,
+                                        num, pinning_);
+  if (pinning_) {
+    pinned_.push_back(block);
+  }
+  return block;
+}
+
+void BPlusTree::ReleaseNodeBlock(BlockInfo *block) {
+  for (unsigned int i = 0; i < pinned_.size(); ++i) {
+    if (pinned_[i] == block) {
+      hdl_->UnpinBlock(block);
+      pinned_[i] = pinned_.back();
+      pinned_.pop_back();
+      return;
+    }
+  }
+}
+
+void BPlusTree::StopPinning() {
+  for (unsigned int i = 0; i < pinned_.size(); ++i) {
+    hdl_->UnpinBlock(pinned_[i]);
+  }
+  pinned_.clear();
+  pinning_ = false;
+}
+
 void BPlusTree::Print() {
   printf("*****************************************************\n");
   printf("KeyCount: %d, NodeCount: %d, Level: %d, Root: %d \n",
@@ -231,11 +362,57 @@ int BPlusTree::GetVal(TKey key) {
   return ret;
 }
 
+void BPlusTree::GetVals(std::vector<TKey> &keys, std::vector<int> &vals) {
+  vals.assign(keys.size(), -1);
+  if (idx_->root() == -1) {
+    return;
+  }
+  BPlusTreeNode *leaf = NULL;
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    TKey &key = keys[i];
+    // The previous key was not past this leaf, so this one belongs to it
+    // unless it is larger than its last key.
+    if (leaf == NULL || leaf->GetCount() == 0 ||
+        leaf->GetKeys(leaf->GetCount() - 1) < key) {
+      BPlusTreeNode *next = NULL;
+      if (leaf != NULL && leaf->GetNextLeaf() != -1) {
+        next = GetNode(leaf->GetNextLeaf());
+        if (next->GetCount() == 0 ||
+            next->GetKeys(next->GetCount() - 1) < key) {
+          delete next;
+          next = NULL;
+        }
+      }
+      delete leaf;
+      leaf = next != NULL ? next : Search(idx_->root(), key).pnode;
+    }
+    int index;
+    if (leaf->Search(key, index)) {
+      vals[i] = leaf->GetValues(index);
+    }
+  }
+  delete leaf;
+}
+
+bool BPlusTree::SetVal(TKey &key, int block_num, int offset) {
+  if (idx_->root() == -1) {
+    return false;
+  }
+  FindNodeParam fnp = Search(idx_->root(), key);
+  if (!fnp.flag) {
+    return false;
+  }
+  fnp.pnode->SetValues(fnp.index, (block_num << 16) | offset);
+  return true;
+}
+
 bool BPlusTree::Remove(TKey key) {
 
   if (idx_->root() == -1)
     return false;
 
+  NodePins pins(this);
+
   BPlusTreeNode *rootnode = GetNode(idx_->root());
   FindNodeParam fnp = Search(idx_->root(), key);
 
@@ -273,7 +450,9 @@ bool BPlusTree::AdjustAfterRemove(int node) {
     if (pnode->GetCount() == 0) {
       if (!pnode->GetIsLeaf()) {
         idx_->set_root(pnode->GetValues(0));
-        GetNode(pnode->GetValues(0))->SetParent(-1);
+        BPlusTreeNode *child = GetNode(pnode->GetValues(0));
+        child->SetParent(-1);
+        delete child;
       } else {
         idx_->set_root(-1);
         idx_->set_leaf_head(-1);
@@ -331,8 +510,10 @@ bool BPlusTree::AdjustAfterRemove(int node) {
 
         if (pbrother->GetValues(pbrother->GetCount()) >= 0) {
 
-          GetNode(pbrother->GetValues(pbrother->GetCount()))
-              ->SetParent(pnode->block_num());
+          BPlusTreeNode *child =
+              GetNode(pbrother->GetValues(pbrother->GetCount()));
+          child->SetParent(pnode->block_num());
+          delete child;
           pbrother->SetValues(pbrother->GetCount(), -1);
         }
         pbrother->SetCount(pbrother->GetCount() - 1);
@@ -352,6 +533,11 @@ bool BPlusTree::AdjustAfterRemove(int node) {
 
         pbrother->SetCount(pbrother->GetCount() + pnode->GetCount());
         pbrother->SetNextLeaf(pnode->GetNextLeaf());
+        if (pnode->GetNextLeaf() != -1) {
+          BPlusTreeNode *next = GetNode(pnode->GetNextLeaf());
+          next->SetPrevLeaf(pbrother->block_num());
+          delete next;
+        }
         delete pnode;
         idx_->DecreaseNodeCount();
 
@@ -367,7 +553,9 @@ bool BPlusTree::AdjustAfterRemove(int node) {
 
         for (int i = 0; i <= pnode->GetCount(); i++) {
           pbrother->SetValues(pbrother->GetCount() + i, pnode->GetValues(i));
-          GetNode(pnode->GetValues(i))->SetParent(pbrother->block_num());
+          BPlusTreeNode *child = GetNode(pnode->GetValues(i));
+          child->SetParent(pbrother->block_num());
+          delete child;
         }
 
         pbrother->SetCount(2 * idx_->rank());
@@ -400,7 +588,9 @@ bool BPlusTree::AdjustAfterRemove(int node) {
         pnode->SetValues(pnode->GetCount() + 1, pbrother->GetValues(0));
         pnode->SetCount(pnode->GetCount() + 1);
         pparent->SetKeys(pos, pbrother->GetKeys(0));
-        GetNode(pbrother->GetValues(0))->SetParent(pnode->block_num());
+        BPlusTreeNode *child = GetNode(pbrother->GetValues(0));
+        child->SetParent(pnode->block_num());
+        delete child;
 
         pbrother->RemoveAt(0);
         return true;
@@ -417,6 +607,12 @@ bool BPlusTree::AdjustAfterRemove(int node) {
         }
 
         pnode->SetCount(pnode->GetCount() + idx_->rank());
+        pnode->SetNextLeaf(pbrother->GetNextLeaf());
+        if (pbrother->GetNextLeaf() != -1) {
+          BPlusTreeNode *next = GetNode(pbrother->GetNextLeaf());
+          next->SetPrevLeaf(pnode->block_num());
+          delete next;
+        }
         delete pbrother;
         idx_->DecreaseNodeCount();
 
@@ -438,7 +634,9 @@ bool BPlusTree::AdjustAfterRemove(int node) {
 
         for (int i = 0; i <= idx_->rank(); i++) {
           pnode->SetValues(pnode->GetCount() + i, pbrother->GetValues(i));
-          GetNode(pbrother->GetValues(i))->SetParent(pnode->block_num());
+          BPlusTreeNode *child = GetNode(pbrother->GetValues(i));
+          child->SetParent(pnode->block_num());
+          delete child;
         }
 
         pnode->SetCount(pnode->GetCount() + idx_->rank());
@@ -493,6 +691,16 @@ int BPlusTreeNode::GetNextLeaf() {
   return val;
 }
 
+// The previous leaf link follows the next leaf link. A leaf never holds
+// more than degree - 1 entries for long, so both fit after its entries.
+int BPlusTreeNode::GetPrevLeaf() {
+  int val;
+  int base = 12;
+  int lenR = 4 + tree_->idx()->key_len();
+  val = *((int *)(&buffer_[base + tree_->degree() * lenR + 4]));
+  return val;
+}
+
 int BPlusTreeNode::GetParent() {
   int val;
   val = *((int *)(&buffer_[8]));
@@ -525,6 +733,12 @@ void BPlusTreeNode::SetNextLeaf(int val) {
   *((int *)(&buffer_[base + tree_->degree() * len])) = val;
 }
 
+void BPlusTreeNode::SetPrevLeaf(int val) {
+  int base = 12;
+  int len = 4 + tree_->idx()->key_len();
+  *((int *)(&buffer_[base + tree_->degree() * len + 4])) = val;
+}
+
 void BPlusTreeNode::SetParent(int val) { *((int *)(&buffer_[8])) = val; }
 
 void BPlusTreeNode::SetNodeType(int val) { *((int *)(&buffer_[0])) = val; }
@@ -534,10 +748,9 @@ void BPlusTreeNode::SetCount(int val) { *((int *)(&buffer_[4])) = val; }
 void BPlusTreeNode::SetIsLeaf(bool val) { SetNodeType(val ? 1 : 0); }
 
 void BPlusTreeNode::GetBuffer() {
-  BlockInfo *block = tree_->hdl()->GetFileBlock(
-      tree_->db_name(), tree_->idx()->name(), FORMAT_INDEX, block_num_);
-  buffer_ = block->data();
-  block->set_dirty(true);
+  block_ = tree_->GetNodeBlock(block_num_);
+  buffer_ = block_->data();
+  block_->set_dirty(true);
 }
 
 bool BPlusTreeNode::Search(TKey key, int &index) {
@@ -685,6 +898,12 @@ BPlusTreeNode *BPlusTreeNode::Split(TKey &key) {
     newnode->SetCount(rank_);
     SetCount(rank_ + 1);
     newnode->SetNextLeaf(GetNextLeaf());
+    newnode->SetPrevLeaf(block_num_);
+    if (GetNextLeaf() != -1) {
+      BPlusTreeNode *next = tree_->GetNode(GetNextLeaf());
+      next->SetPrevLeaf(newnode->block_num());
+      delete next;
+    }
     SetNextLeaf(newnode->block_num());
     newnode->SetParent(GetParent());
 
@@ -704,6 +923,7 @@ BPlusTreeNode *BPlusTreeNode::Split(TKey &key) {
       BPlusTreeNode *node = tree_->GetNode(childnode_num);
       if (node) {
         node->SetParent(newnode->block_num());
+        delete node;
       }
     }
 
@@ -767,3 +987,238 @@ void BPlusTreeNode::Print() {
     printf("}\n");
   }
 }
+
+//=======================KeyRange=======================//
+
+bool KeyRange::Narrow(int sign_type, std::string value) {
+  TKey key(low.key_type(), low.length());
+  key.ReadValue(value);
+  bool lower = sign_type == SIGN_EQ || sign_type == SIGN_GT ||
+               sign_type == SIGN_GE;
+  bool upper = sign_type == SIGN_EQ || sign_type == SIGN_LT ||
+               sign_type == SIGN_LE;
+  if (lower && (!has_low || key > low)) {
+    low = key;
+    has_low = true;
+  }
+  if (upper && (!has_high || key < high)) {
+    high = key;
+    has_high = true;
+  }
+  return lower || upper;
+}
+
+//=======================Index keys=======================//
+
+void NormalizeKey(int data_type, const char *key, int len, char *out) {
+  if (data_type == T_CHAR) {
+    int n = strnlen(key, len);
+    memcpy(out, key, n);
+    memset(out + n, 0, len - n);
+    return;
+  }
+  uint32_t u;
+  memcpy(&u, key, 4);
+  if (data_type == T_INT) {
+    u ^= 0x80000000u;
+  } else {
+    float f;
+    memcpy(&f, key, 4);
+    if (f == 0) {
+      u = 0;
+    }
+    // Negative floats order backwards, and below the positive ones.
+    u = (u & 0x80000000u) ? ~u : u | 0x80000000u;
+  }
+  for (int i = 0; i < 4; ++i) {
+    out[i] = (char)(u >> (24 - 8 * i));
+  }
+}
+
+void DenormalizeKey(int data_type, const char *key, int len, char *out) {
+  if (data_type == T_CHAR) {
+    memcpy(out, key, len);
+    return;
+  }
+  uint32_t u = 0;
+  for (int i = 0; i < 4; ++i) {
+    u = (u << 8) | (unsigned char)key[i];
+  }
+  if (data_type == T_INT) {
+    u ^= 0x80000000u;
+  } else {
+    u = (u & 0x80000000u) ? u & 0x7fffffffu : ~u;
+  }
+  memcpy(out, &u, 4);
+}
+
+TKey MakeIndexKey(Table *tbl, Index *idx, const char *const *fields, int rid) {
+  TKey key(idx->key_type(), idx->key_len());
+  if (idx->key_type() != T_BYTES) {
+    memcpy(key.key(), fields[0], key.length());
+    return key;
+  }
+  int len = 0;
+  for (unsigned int i = 0; i < idx->attr_names().size(); ++i) {
+    Attribute *attr = tbl->GetAttribute(idx->attr_names()[i]);
+    NormalizeKey(attr->data_type(), fields[i], attr->length(), key.key() + len);
+    len += attr->length();
+  }
+  if (!idx->unique()) {
+    for (int i = 0; i < 4; ++i, ++len) {
+      key.key()[len] = (char)((uint32_t)rid >> (24 - 8 * i));
+    }
+  }
+  std::vector<std::string> &includes = idx->include_names();
+  for (unsigned int i = 0; i < includes.size(); ++i) {
+    Attribute *attr = tbl->GetAttribute(includes[i]);
+    memcpy(key.key() + len, fields[idx->attr_names().size() + i],
+           attr->length());
+    len += attr->length();
+  }
+  return key;
+}
+
+int MakeKeyRange(Table *tbl, Index *idx, std::vector<SQLWhere> &wheres,
+                 KeyRange &range) {
+  std::vector<std::string> &names = idx->attr_names();
+  std::string low, high; // Normalized bounds of the key.
+  int rank = 0;
+  for (unsigned int i = 0; i < names.size(); ++i) {
+    Attribute *attr = tbl->GetAttribute(names[i]);
+    KeyRange values(attr->data_type(), attr->length());
+    bool bounded = false;
+    for (unsigned int j = 0; j < wheres.size(); ++j) {
+      if (names[i] == wheres[j].key &&
+          values.Narrow(wheres[j].sign_type, wheres[j].value)) {
+        bounded = true;
+      }
+    }
+    if (!bounded) {
+      break;
+    }
+    if (idx->key_type() != T_BYTES) {
+      range = values;
+      return values.has_low && values.has_high && values.low == values.high
+                 ? 2
+                 : 1;
+    }
+    std::string field(attr->length(), '\0');
+    if (values.has_low && values.has_high && values.low == values.high) {
+      NormalizeKey(attr->data_type(), values.low.key(), attr->length(),
+                   &field[0]);
+      low += field;
+      high += field;
+      rank += 2;
+      continue;
+    }
+    // The attribute is only bounded: the key is not fixed any further.
+    if (values.has_low) {
+      NormalizeKey(attr->data_type(), values.low.key(), attr->length(),
+                   &field[0]);
+      low += field;
+    }
+    if (values.has_high) {
+      NormalizeKey(attr->data_type(), values.high.key(), attr->length(),
+                   &field[0]);
+      high += field;
+    }
+    rank += 1;
+    break;
+  }
+  // The rest of a bound takes in every key of that prefix.
+  if (!low.empty()) {
+    low.resize(idx->key_len(), '\0');
+    memcpy(range.low.key(), low.data(), idx->key_len());
+    range.has_low = true;
+  }
+  if (!high.empty()) {
+    high.resize(idx->key_len(), '\xff');
+    memcpy(range.high.key(), high.data(), idx->key_len());
+    range.has_high = true;
+  }
+  return rank;
+}
+
+//=======================BPlusTreeRange=======================//
+
+void BPlusTreeRange::Seek() {
+  Index *idx = tree_->idx();
+  pos_ = 0;
+  if (idx->root() == -1) {
+    leaf_ = -1;
+  } else if (!descending_ && !range_.has_low) {
+    leaf_ = idx->leaf_head();
+  } else if (!descending_) {
+    // The position of the lower bound may be past the last key of its leaf;
+    // Next then goes on to the following leaf.
+    FindNodeParam fnp = tree_->Search(idx->root(), range_.low);
+    leaf_ = fnp.pnode->block_num();
+    pos_ = fnp.index;
+    delete fnp.pnode;
+  } else if (!range_.has_high) {
+    // Start from the last entry of the last leaf.
+    BPlusTreeNode *pnode = tree_->GetNode(idx->root());
+    while (!pnode->GetIsLeaf()) {
+      BPlusTreeNode *child = tree_->GetNode(pnode->GetValues(pnode->GetCount()));
+      delete pnode;
+      pnode = child;
+    }
+    leaf_ = pnode->block_num();
+    pos_ = INT_MAX;
+    delete pnode;
+  } else {
+    // Start from the upper bound, or the key before where it would be,
+    // which may be in the previous leaf.
+    FindNodeParam fnp = tree_->Search(idx->root(), range_.high);
+    leaf_ = fnp.pnode->block_num();
+    pos_ = fnp.flag ? fnp.index : fnp.index - 1;
+    delete fnp.pnode;
+  }
+}
+
+bool BPlusTreeRange::Next(std::vector<int> &vals, int max,
+                          std::vector<char> *keys) {
+  int added = 0;
+  while (leaf_ != -1 && added < max) {
+    BPlusTreeNode *leaf = tree_->GetNode(leaf_);
+    if (descending_) {
+      pos_ = std::min(pos_, leaf->GetCount() - 1);
+      for (; pos_ >= 0 && added < max; --pos_) {
+        if (range_.has_low && leaf->GetKeys(pos_) < range_.low) {
+          leaf_ = -1;
+          break;
+        }
+        vals.push_back(leaf->GetValues(pos_));
+        if (keys != NULL) {
+          TKey key = leaf->GetKeys(pos_);
+          keys->insert(keys->end(), key.key(), key.key() + key.length());
+        }
+        ++added;
+      }
+      if (leaf_ != -1 && pos_ < 0) {
+        leaf_ = leaf->GetPrevLeaf();
+        pos_ = INT_MAX;
+      }
+    } else {
+      for (; pos_ < leaf->GetCount() && added < max; ++pos_) {
+        if (range_.has_high && leaf->GetKeys(pos_) > range_.high) {
+          leaf_ = -1;
+          break;
+        }
+        vals.push_back(leaf->GetValues(pos_));
+        if (keys != NULL) {
+          TKey key = leaf->GetKeys(pos_);
+          keys->insert(keys->end(), key.key(), key.key() + key.length());
+        }
+        ++added;
+      }
+      if (leaf_ != -1 && pos_ == leaf->GetCount()) {
+        leaf_ = leaf->GetNextLeaf();
+        pos_ = 0;
+      }
+    }
+    delete leaf;
+  }
+  return added > 0;
+}
@@ -2,6 +2,7 @@
 #define MINIDB_INDEX_MANAGER_H_
 
 #include <string>
+#include <vector>
 
 #include "buffer_manager.h"
 #include "catalog_manager.h"
@@ -39,6 +40,8 @@ private:
   BufferManager *hdl_;
   CatalogManager *cm_;
   std::string db_name_;
+  bool pinning_;
+  std::vector<BlockInfo *> pinned_; // One entry for each pin held.
 
 public:
   BPlusTree(Index *idx, BufferManager *hdl, CatalogManager *cm,
@@ -48,8 +51,9 @@ public:
     idx_ = idx;
     degree_ = 2 * idx_->rank() + 1;
     db_name_ = db_name;
+    pinning_ = false;
   }
-  ~BPlusTree() {}
+  ~BPlusTree() { StopPinning(); }
 
   Index *idx() { return idx_; }
   int degree() { return degree_; }
@@ -67,9 +71,26 @@ public:
   FindNodeParam SearchBranch(int node, TKey &key);
   BPlusTreeNode *GetNode(int num);
   int GetVal(TKey key);
+  // Look up keys given in ascending order: vals[i] is the value of keys[i],
+  // or -1. A key is first looked for in the leaf of the key before it, or
+  // in the next leaf, and the tree is only descended when it lies further.
+  void GetVals(std::vector<TKey> &keys, std::vector<int> &vals);
+  // Point an existing key at a new record; false if the key is absent.
+  bool SetVal(TKey &key, int block_num, int offset);
 
   int GetNewBlockNum() { return idx_->IncreaseMaxCount(); }
 
+  // Add and Remove hold several nodes while they fetch others, which could
+  // evict the blocks of the nodes held. Between StartPinning and
+  // StopPinning, the block of every node fetched stays in the buffer until
+  // the node is deleted.
+  void StartPinning() { pinning_ = true; }
+  void StopPinning();
+  // The block of node `num`, pinned while pinning.
+  BlockInfo *GetNodeBlock(int num);
+  // Drop a pin GetNodeBlock took on `block`, if it is still held.
+  void ReleaseNodeBlock(BlockInfo *block);
+
   void Print();
   void PrintNode(int num);
 
@@ -82,6 +103,7 @@ private:
   BPlusTree *tree_;
   int block_num_;
   int rank_;
+  BlockInfo *block_;
   char *buffer_;
   bool is_leaf_;
   bool is_new_node_;
@@ -89,13 +111,14 @@ private:
 public:
   BPlusTreeNode(bool isnew, BPlusTree *tree, int blocknum,
                 bool newleaf = false);
-  ~BPlusTreeNode() {}
+  ~BPlusTreeNode() { tree_->ReleaseNodeBlock(block_); }
 
   int block_num() { return block_num_; }
 
   TKey GetKeys(int i);
   int GetValues(int i);
   int GetNextLeaf();
+  int GetPrevLeaf();
   int GetParent();
   int GetNodeType();
   int GetCount();
@@ -104,6 +127,7 @@ public:
   void SetKeys(int i, TKey key);
   void SetValues(int i, int val);
   void SetNextLeaf(int val);
+  void SetPrevLeaf(int val);
   void SetParent(int val);
   void SetNodeType(int val);
   void SetCount(int val);
@@ -127,4 +151,71 @@ public:
   void Print();
 };
 
+// KeyRange: the keys of an index that conditions on its column allow. Both
+// bounds are optional and include the bound itself; the conditions are
+// still checked on the records, so the range only has to hold every key
+// they accept.
+struct KeyRange {
+  TKey low;
+  TKey high;
+  bool has_low;
+  bool has_high;
+
+  KeyRange(int key_type, int key_len)
+      : low(key_type, key_len), high(key_type, key_len), has_low(false),
+        has_high(false) {}
+  // Narrow the range by the condition "column sign_type value"; false if
+  // the sign bounds no range, as <> does.
+  bool Narrow(int sign_type, std::string value);
+};
+
+// Write a `len` byte field of type `data_type` as bytes whose memcmp order
+// is the order of the values: numbers big-endian with the sign handled,
+// strings up to their NUL and padded with zeros.
+void NormalizeKey(int data_type, const char *key, int len, char *out);
+// The field NormalizeKey wrote as `key`, back as it is stored.
+void DenormalizeKey(int data_type, const char *key, int len, char *out);
+
+// The entry in `idx` of the record whose id is `rid` and whose key fields,
+// in the order of the index attributes and then of the included ones, are
+// `fields`. A unique index on one attribute holds the field as it is.
+// Other keys are of type T_BYTES: the fields normalized and concatenated,
+// which orders them field by field, and for an index that may hold a value
+// many times the record id, big endian, which orders the records sharing a
+// value; the included fields follow as they are stored.
+TKey MakeIndexKey(Table *tbl, Index *idx, const char *const *fields, int rid);
+
+// Narrow `range`, made for the keys of `idx`, by the conditions comparing
+// key attributes with a value: equalities on the leading attributes fix a
+// prefix of the key, and the conditions on the attribute after them bound
+// the rest. Returns 0 if no condition bounds the range, else 2 for each
+// attribute fixed plus 1 for the one bounded after them.
+int MakeKeyRange(Table *tbl, Index *idx, std::vector<SQLWhere> &wheres,
+                 KeyRange &range);
+
+// BPlusTreeRange: walks the values of the keys within a KeyRange in
+// ascending key order, or descending. The leaf of the bound it starts from
+// is found from the root, and from there the leaf chain is followed, along
+// the next or the previous leaf links, up to the other bound. Only a leaf
+// number and a position are held between calls, as nodes are not pinned in
+// the buffer.
+class BPlusTreeRange {
+private:
+  BPlusTree *tree_;
+  KeyRange range_;
+  bool descending_;
+  int leaf_; // Leaf to go on from, or -1 once the range is done.
+  int pos_;  // Next entry of that leaf; past the end for its last.
+
+public:
+  BPlusTreeRange(BPlusTree *tree, KeyRange &range, bool descending = false)
+      : tree_(tree), range_(range), descending_(descending), leaf_(-1),
+        pos_(0) {}
+  // Go back to the first key of the range.
+  void Seek();
+  // Append the values of up to `max` more keys to `vals`, and the keys
+  // themselves to `keys` if given; false once none are left.
+  bool Next(std::vector<int> &vals, int max, std::vector<char> *keys = NULL);
+};
+
 #endif
@@ -132,6 +132,9 @@ void Interpreter::TellSQLType() {
   } else if (sql_vector_[0] == "select") {
     cout << "SQL TYPE: #SELECT#" << endl;
     sql_type_ = 90;
+  } else if (sql_vector_[0] == "explain") {
+    cout << "SQL TYPE: #EXPLAIN#" << endl;
+    sql_type_ = 91;
   } else if (sql_vector_[0] == "delete") {
     cout << "SQL TYPE: #DELETE#" << endl;
     sql_type_ = 100;
@@ -219,7 +222,8 @@ void Interpreter::Run() {
       }
       delete st;
     } break;
-    case 90: {
+    case 90:
+    case 91: {
       SQLSelect *st = new SQLSelect(sql_vector_);
       api->Select(*st);
       delete st;
@@ -233,12 +237,12 @@ void Interpreter::Run() {
       SQLUpdate *st = new SQLUpdate(sql_vector_);
       api->Update(*st);
       delete st;
-    }
+    } break;
     case 120: {
       SQLJoin *st = new SQLJoin(sql_vector_);
-      //JOIN FUNCTION
-    }
-    break;
+      api->Join(*st);
+      delete st;
+    } break;
     default:
       break;
     }
@@ -252,8 +256,8 @@ void Interpreter::Run() {
     cerr << "Database already exists!" << endl;
   } catch (TableNotExistException &e) {
     cerr << "Table doesn't exist!" << endl;
-  } catch (OneIndexEachTableException &e) {
-    cerr << "Each table could only have one index!" << endl;
+  } catch (AttributeNotExistException &e) {
+    cerr << "Attribute doesn't exist!" << endl;
   } catch (BPlusTreeException &e) {
     cerr << "BPlusTree exception!" << endl;
   } catch (TableAlreadyExistsException &e) {
@@ -262,10 +266,12 @@ void Interpreter::Run() {
     cerr << "Index already exists!" << endl;
   } catch (IndexNotExistException &e) {
     cerr << "Index doesn't exist!" << endl;
-  } catch (IndexMustBeCreatedOnPKException &e) {
-    cerr << "Index must be created on primary key!" << endl;
   } catch (PrimaryKeyConflictException &e) {
     cerr << "Primary key conflicts!" << endl;
+  } catch (IndexEntryInvalidException &e) {
+    cerr << "Index entry points to no record!" << endl;
+  } catch (SpillFileException &e) {
+    cerr << "Temporary file error!" << endl;
   }
 }
 
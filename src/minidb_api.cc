@@ -1,5 +1,6 @@
 #include "minidb_api.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
@@ -14,12 +15,23 @@
 
 using namespace std;
 
-MiniDBAPI::MiniDBAPI(std::string p) : path_(p) { cm_ = new CatalogManager(p); }
+MiniDBAPI::MiniDBAPI(std::string p) : path_(p) {
+  cm_ = new CatalogManager(p);
+  // MINIDB_SPILL_BUDGET, in bytes, overrides the memory operators may hold
+  // before they spill, so that tests can make them spill on small tables.
+  size_t budget = SPILL_BUDGET;
+  const char *env = getenv("MINIDB_SPILL_BUDGET");
+  if (env != NULL) {
+    budget = strtoul(env, NULL, 10);
+  }
+  spill_ = new SpillManager(p + ".spill/", budget);
+}
 
 MiniDBAPI::~MiniDBAPI() {
   // hdl_ is initialized in #Use#
   delete hdl_;
   delete cm_;
+  delete spill_;
 }
 
 void MiniDBAPI::Quit() {
@@ -44,6 +56,7 @@ void MiniDBAPI::Help() {
   std::cout << "#CREATE INDEX#" << std::endl;
   std::cout << "#DROP INDEX#" << std::endl;
   std::cout << "#SELECT#" << std::endl;
+  std::cout << "#EXPLAIN#" << std::endl;
   std::cout << "#INSERT#" << std::endl;
   std::cout << "#DELETE#" << std::endl;
   std::cout << "#UPDATE#" << std::endl;
@@ -196,7 +209,7 @@ void MiniDBAPI::Insert(SQLInsert &st) {
     throw DatabaseNotExistException();
   }
 
-  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_);
+  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_, spill_);
   rm->Insert(st);
   delete rm;
 }
@@ -212,7 +225,7 @@ void MiniDBAPI::Select(SQLSelect &st) {
     throw TableNotExistException();
   }
 
-  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_);
+  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_, spill_);
   rm->Select(st);
   delete rm;
 }
@@ -323,7 +336,7 @@ void MiniDBAPI::Delete(SQLDelete &st) {
     throw TableNotExistException();
   }
 
-  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_);
+  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_, spill_);
   rm->Delete(st);
   delete rm;
 }
@@ -344,14 +357,13 @@ void MiniDBAPI::Update(SQLUpdate &st) {
     throw TableNotExistException();
   }
 
-  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_);
+  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_, spill_);
   rm->Update(st);
   delete rm;
 }
 void MiniDBAPI::Join(SQLJoin &st){
   
-  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_);
+  RecordManager *rm = new RecordManager(cm_, hdl_, curr_db_, spill_);
   rm->Join(st);
-  
-  //JOIN FUNCTION
+  delete rm;
 }
@@ -5,6 +5,7 @@
 
 #include "buffer_manager.h"
 #include "catalog_manager.h"
+#include "spill_manager.h"
 #include "sql_statement.h"
 
 class MiniDBAPI {
@@ -12,6 +13,7 @@ private:
   std::string path_;
   CatalogManager *cm_;
   BufferManager *hdl_;
+  SpillManager *spill_; // Temporary files of large joins, sorts, groupings.
   std::string curr_db_;
 
 public:
@@ -0,0 +1,252 @@
+#include "predicate.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "exceptions.h"
+#include "filter_kernels.h"
+
+using namespace std;
+
+namespace {
+
+template <int SIGN, typename T> bool Test(T a, T b) {
+  switch (SIGN) {
+  case SIGN_EQ: return a == b;
+  case SIGN_NE: return a != b;
+  case SIGN_LT: return a < b;
+  case SIGN_GT: return a > b;
+  case SIGN_LE: return a <= b;
+  case SIGN_GE: return a >= b;
+  default: return false;
+  }
+}
+
+template <int SIGN> bool CompareInt(const char *field, const PredicateTerm &t) {
+  int a;
+  memcpy(&a, field, 4);
+  return Test<SIGN>(a, t.ival);
+}
+
+template <int SIGN>
+bool CompareFloat(const char *field, const PredicateTerm &t) {
+  float a;
+  memcpy(&a, field, 4);
+  return Test<SIGN>(a, t.fval);
+}
+
+template <int SIGN> bool CompareChar(const char *field, const PredicateTerm &t) {
+  return Test<SIGN>(strncmp(field, &t.cval[0], t.length), 0);
+}
+
+bool CompareIntRange(const char *field, const PredicateTerm &t) {
+  int a;
+  memcpy(&a, field, 4);
+  return a >= t.ilo && a <= t.ihi;
+}
+
+bool CompareFloatRange(const char *field, const PredicateTerm &t) {
+  float a;
+  memcpy(&a, field, 4);
+  return (t.lo_strict ? a > t.flo : a >= t.flo) &&
+         (t.hi_strict ? a < t.fhi : a <= t.fhi);
+}
+
+bool IsRangeSign(int sign_type) {
+  return sign_type == SIGN_LT || sign_type == SIGN_GT ||
+         sign_type == SIGN_LE || sign_type == SIGN_GE;
+}
+
+PredicateFunc SelectFunc(int data_type, int sign_type) {
+  static const PredicateFunc int_funcs[] = {
+      CompareInt<SIGN_EQ>, CompareInt<SIGN_NE>, CompareInt<SIGN_LT>,
+      CompareInt<SIGN_GT>, CompareInt<SIGN_LE>, CompareInt<SIGN_GE>};
+  static const PredicateFunc float_funcs[] = {
+      CompareFloat<SIGN_EQ>, CompareFloat<SIGN_NE>, CompareFloat<SIGN_LT>,
+      CompareFloat<SIGN_GT>, CompareFloat<SIGN_LE>, CompareFloat<SIGN_GE>};
+  static const PredicateFunc char_funcs[] = {
+      CompareChar<SIGN_EQ>, CompareChar<SIGN_NE>, CompareChar<SIGN_LT>,
+      CompareChar<SIGN_GT>, CompareChar<SIGN_LE>, CompareChar<SIGN_GE>};
+
+  if (sign_type < SIGN_EQ || sign_type > SIGN_GE) {
+    throw SyntaxErrorException();
+  }
+  switch (data_type) {
+  case T_INT: return int_funcs[sign_type];
+  case T_FLOAT: return float_funcs[sign_type];
+  case T_CHAR: return char_funcs[sign_type];
+  default: throw SyntaxErrorException();
+  }
+}
+
+} // namespace
+
+Predicate::Predicate(Table *tbl, std::vector<SQLWhere> &wheres) {
+  Compile(tbl->ats(), wheres);
+}
+
+Predicate::Predicate(std::vector<Attribute> &schema,
+                     std::vector<SQLWhere> &wheres) {
+  Compile(schema, wheres);
+}
+
+void Predicate::Compile(std::vector<Attribute> &schema,
+                        std::vector<SQLWhere> &wheres) {
+  vector<int> offsets;
+  int offset = 0;
+  for (unsigned int i = 0; i < schema.size(); ++i) {
+    offsets.push_back(offset);
+    offset += schema[i].length();
+  }
+
+  for (unsigned int i = 0; i < wheres.size(); ++i) {
+    SQLWhere &where = wheres[i];
+    int idx = -1;
+    for (unsigned int j = 0; j < schema.size(); ++j) {
+      if (schema[j].attr_name() == where.key) {
+        idx = j;
+        break;
+      }
+    }
+    if (idx == -1) {
+      throw AttributeNotExistException();
+    }
+    Attribute &attr = schema[idx];
+
+    PredicateTerm t;
+    t.attr = idx;
+    t.offset = offsets[idx];
+    t.length = attr.length();
+    t.data_type = attr.data_type();
+    t.sign_type = where.sign_type;
+    t.ival = 0;
+    t.fval = 0;
+    t.is_range = false;
+    switch (t.data_type) {
+    case T_INT:
+      t.ival = atoi(where.value.c_str());
+      break;
+    case T_FLOAT:
+      t.fval = atof(where.value.c_str());
+      break;
+    case T_CHAR:
+      t.cval.assign(t.length, 0);
+      memcpy(&t.cval[0], where.value.c_str(),
+             (int)where.value.size() < t.length ? where.value.size()
+                                                : t.length);
+      break;
+    }
+    t.fn = SelectFunc(t.data_type, t.sign_type);
+    terms_.push_back(t);
+  }
+  FuseRanges();
+}
+
+void Predicate::FuseRanges() {
+  vector<PredicateTerm> fused;
+  vector<bool> done(terms_.size(), false);
+  for (unsigned int i = 0; i < terms_.size(); ++i) {
+    if (done[i]) {
+      continue;
+    }
+    PredicateTerm &t = terms_[i];
+    vector<int> group;
+    if (t.data_type != T_CHAR && IsRangeSign(t.sign_type)) {
+      for (unsigned int j = i; j < terms_.size(); ++j) {
+        if (!done[j] && terms_[j].attr == t.attr &&
+            IsRangeSign(terms_[j].sign_type)) {
+          group.push_back(j);
+        }
+      }
+    }
+    if (group.size() < 2) {
+      fused.push_back(t);
+      continue;
+    }
+
+    PredicateTerm r = t;
+    r.is_range = true;
+    r.flo = -numeric_limits<float>::infinity();
+    r.fhi = numeric_limits<float>::infinity();
+    r.lo_strict = false;
+    r.hi_strict = false;
+    // Integer bounds are kept inclusive: x > c becomes x >= c + 1, computed
+    // in long long so c + 1 cannot overflow.
+    long long lo = INT_MIN;
+    long long hi = INT_MAX;
+    // Intersect the bounds of the group.
+    for (unsigned int k = 0; k < group.size(); ++k) {
+      PredicateTerm &g = terms_[group[k]];
+      done[group[k]] = true;
+      bool lower = g.sign_type == SIGN_GT || g.sign_type == SIGN_GE;
+      bool strict = g.sign_type == SIGN_GT || g.sign_type == SIGN_LT;
+      if (r.data_type == T_INT) {
+        long long v = (long long)g.ival + (strict ? (lower ? 1 : -1) : 0);
+        if (lower && v > lo) {
+          lo = v;
+        } else if (!lower && v < hi) {
+          hi = v;
+        }
+      } else if (lower) {
+        if (g.fval > r.flo || (g.fval == r.flo && strict)) {
+          r.flo = g.fval;
+          r.lo_strict = strict;
+        }
+      } else {
+        if (g.fval < r.fhi || (g.fval == r.fhi && strict)) {
+          r.fhi = g.fval;
+          r.hi_strict = strict;
+        }
+      }
+    }
+    if (lo > hi) {
+      // Contradictory bounds, nothing qualifies.
+      r.ilo = 1;
+      r.ihi = 0;
+    } else {
+      r.ilo = (int)lo;
+      r.ihi = (int)hi;
+    }
+    r.fn = r.data_type == T_INT ? CompareIntRange : CompareFloatRange;
+    fused.push_back(r);
+  }
+  terms_.swap(fused);
+}
+
+void Predicate::EvaluateBlock(const char *base, int stride, int count,
+                              uint64_t *mask) const {
+  FillSelectionMask(mask, count);
+  if (count == 0) {
+    return;
+  }
+  for (unsigned int i = 0; i < terms_.size(); ++i) {
+    ApplyTerm(terms_[i], base + terms_[i].offset, stride, count, mask);
+  }
+}
+
+void Predicate::ApplyTerm(const PredicateTerm &t, const char *field,
+                          int stride, int count, uint64_t *mask) {
+  const FilterKernels &k = GetFilterKernels();
+  switch (t.data_type) {
+  case T_INT:
+    if (t.is_range) {
+      k.int_range(field, stride, count, t.ilo, t.ihi, mask);
+    } else {
+      k.int_cmp(field, stride, count, t.sign_type, t.ival, mask);
+    }
+    break;
+  case T_FLOAT:
+    if (t.is_range) {
+      k.float_range(field, stride, count, t.flo, t.lo_strict, t.fhi,
+                    t.hi_strict, mask);
+    } else {
+      k.float_cmp(field, stride, count, t.sign_type, t.fval, mask);
+    }
+    break;
+  case T_CHAR:
+    k.char_cmp(field, stride, t.length, count, t.sign_type, &t.cval[0], mask);
+    break;
+  }
+}
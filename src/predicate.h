@@ -0,0 +1,82 @@
+#ifndef MINIDB_PREDICATE_H_
+#define MINIDB_PREDICATE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "catalog_manager.h"
+#include "commons.h"
+#include "sql_statement.h"
+
+struct PredicateTerm;
+
+// Specialized comparison of one field against the constant of a term.
+typedef bool (*PredicateFunc)(const char *field, const PredicateTerm &term);
+
+// One WHERE condition resolved against a table: the column offset is looked
+// up and the constant is parsed once, when the statement is compiled.
+struct PredicateTerm {
+  int attr;           // Position of the attribute in the table.
+  int offset;         // Byte offset of the attribute inside a record.
+  int length;         // Length of the attribute in bytes.
+  int data_type;      // T_INT, T_FLOAT or T_CHAR.
+  int sign_type;      // SIGN_EQ, SIGN_NE, ...
+  int ival;           // Constant for T_INT.
+  float fval;         // Constant for T_FLOAT.
+  std::vector<char> cval; // Constant for T_CHAR, zero padded to length.
+  bool is_range;      // Fused lower and upper bound on the same column.
+  int ilo, ihi;       // Inclusive bounds of a T_INT range.
+  float flo, fhi;     // Bounds of a T_FLOAT range.
+  bool lo_strict;     // T_FLOAT range excludes flo.
+  bool hi_strict;     // T_FLOAT range excludes fhi.
+  PredicateFunc fn;   // Comparison chosen for data_type and sign_type.
+
+  PredicateTerm()
+      : attr(0), offset(0), length(0), data_type(0), sign_type(0), ival(0),
+        fval(0), is_range(false), ilo(0), ihi(0), flo(0), fhi(0),
+        lo_strict(false), hi_strict(false), fn(NULL) {}
+};
+
+// Predicate: the compiled form of a list of AND-ed SQLWhere conditions.
+// Two or more <, >, <= or >= conditions on one numeric column are fused into
+// a single range term.
+class Predicate {
+private:
+  std::vector<PredicateTerm> terms_;
+
+  void Compile(std::vector<Attribute> &schema, std::vector<SQLWhere> &wheres);
+  void FuseRanges();
+
+public:
+  Predicate(Table *tbl, std::vector<SQLWhere> &wheres);
+  // Compile against a list of columns, e.g. the output of an operator.
+  Predicate(std::vector<Attribute> &schema, std::vector<SQLWhere> &wheres);
+  ~Predicate() {}
+
+  std::vector<PredicateTerm> &terms() { return terms_; }
+  bool empty() { return terms_.empty(); }
+
+  // True if the record satisfies every term.
+  bool Evaluate(const char *record) const {
+    for (unsigned int i = 0; i < terms_.size(); ++i) {
+      const PredicateTerm &t = terms_[i];
+      if (!t.fn(record + t.offset, t)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Evaluate `count` records laid out `stride` bytes apart from `base` with
+  // the filter kernels, writing one bit per qualifying record into `mask`.
+  // `mask` must hold (count + 63) / 64 words.
+  void EvaluateBlock(const char *base, int stride, int count,
+                     uint64_t *mask) const;
+
+  // Run the kernel of one term over `count` values of its column, `stride`
+  // bytes apart from `field`, clearing failing rows in `mask`.
+  static void ApplyTerm(const PredicateTerm &t, const char *field, int stride,
+                        int count, uint64_t *mask);
+};
+
+#endif /* MINIDB_PREDICATE_H_ */
@@ -1,12 +1,109 @@
 #include "record_manager.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <set>
 
+#include "bitmap_index.h"
+#include "hash_index.h"
 #include "index_manager.h"
+#include "zone_map.h"
 
 using namespace std;
 
+namespace {
+
+// The text of a value, as conditions give it.
+string ValueString(TKey &key) {
+  char buf[32];
+  switch (key.key_type()) {
+  case T_INT:
+    snprintf(buf, sizeof(buf), "%d", *(int *)key.key());
+    return buf;
+  case T_FLOAT:
+    snprintf(buf, sizeof(buf), "%.9g", *(float *)key.key());
+    return buf;
+  default:
+    return string(key.key(), strnlen(key.key(), key.length()));
+  }
+}
+
+// The table columns a scan reads: `cols`, then the other columns the
+// conditions test.
+vector<int> ScanColumns(Table *tbl, vector<SQLWhere> &wheres,
+                        vector<int> &cols) {
+  vector<int> fetch = cols;
+  for (unsigned int k = 0; k < wheres.size(); ++k) {
+    int col = tbl->GetAttributeIndex(wheres[k].key);
+    if (col != -1 && find(fetch.begin(), fetch.end(), col) == fetch.end()) {
+      fetch.push_back(col);
+    }
+  }
+  return fetch;
+}
+
+// True if the entries of `idx`, a B+ tree, hold all the table columns
+// listed in `cols`, in the key or included.
+bool Covers(Table *tbl, Index *idx, vector<int> &cols) {
+  if (idx->method() != INDEX_BTREE) {
+    return false;
+  }
+  vector<int> held;
+  for (unsigned int i = 0; i < idx->attr_names().size(); ++i) {
+    held.push_back(tbl->GetAttributeIndex(idx->attr_names()[i]));
+  }
+  for (unsigned int i = 0; i < idx->include_names().size(); ++i) {
+    held.push_back(tbl->GetAttributeIndex(idx->include_names()[i]));
+  }
+  for (unsigned int i = 0; i < cols.size(); ++i) {
+    if (find(held.begin(), held.end(), cols[i]) == held.end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+std::vector<int> &RecordManager::GetBlocks(Table *tbl) {
+  if (!tbl->has_blocks()) {
+    vector<int> blocks;
+    int block_num = tbl->first_block_num();
+    while (block_num != -1) {
+      blocks.push_back(block_num);
+      block_num = GetBlockInfo(tbl, block_num)->GetNextBlockNum();
+    }
+    tbl->set_blocks(blocks);
+  }
+  return tbl->blocks();
+}
+
+void RecordManager::SkipBlocks(Table *tbl, Predicate &pred,
+                               std::vector<int> &blocks) {
+  if (pred.empty()) {
+    return;
+  }
+  if (!tbl->has_zones()) {
+    tbl->set_has_zones(true);
+    vector<int> &all = GetBlocks(tbl);
+    for (unsigned int i = 0; i < all.size(); ++i) {
+      ComputeZone(tbl, all[i]);
+    }
+  }
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < blocks.size(); ++i) {
+    if (ZoneMayMatch(tbl, tbl->GetZone(blocks[i]), pred)) {
+      blocks[kept++] = blocks[i];
+    }
+  }
+  blocks_skipped_ += blocks.size() - kept;
+  blocks.resize(kept);
+}
+
 BlockInfo *RecordManager::GetBlockInfo(Table *tbl, int block_num) {
   if (block_num == -1) {
     return NULL;
@@ -27,10 +124,10 @@ void RecordManager::Insert(SQLInsert &st) {
   }
 
   // Calculate the maximum number of records that can be stored in one block
-  int max_count = (4096 - 12) / (tbl->record_length());
+  int max_count = tbl->GetMaxRecordCount();
 
   vector<TKey> tkey_values;
-  int pk_index = -1; // Index for primary key in the record
+  bool has_pk = false; // The table has a primary key.
 
   // Convert each input value into the TKey format and check if it is a primary key
   for (int i = 0; i < values_size; i++) {
@@ -42,41 +139,20 @@ void RecordManager::Insert(SQLInsert &st) {
     tmp.ReadValue(value.c_str());
     tkey_values.push_back(tmp);
 
-    // If the attribute is the primary key (type = 1), record its index.
+    // Attributes of type 1 make up the primary key.
     if (tbl->ats()[i].attr_type() == 1) {
-      pk_index = i;
+      has_pk = true;
     }
   }
 
   // If there's a primary key, check for conflicts.
-  if (pk_index != -1) {
-    if (tbl->GetIndexNum() != 0) {
-      // If an index exists, use the B+ tree to quickly check for duplicate keys.
-      BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
-      int value = tree.GetVal(tkey_values[pk_index]);
-      if (value != -1) {
-        throw PrimaryKeyConflictException();
-      }
-    } else {
-      // If no index exists, iterate through each block and record to check for a duplicate.
-      int block_num = tbl->first_block_num();
-      for (int i = 0; i < tbl->block_count(); ++i) {
-        BlockInfo *bp = GetBlockInfo(tbl, block_num);
-        for (int j = 0; j < bp->GetRecordCount(); ++j) {
-          vector<TKey> tkey_value = GetRecord(tbl, block_num, j);
-          if (tkey_value[pk_index] == tkey_values[pk_index]) { 
-            throw PrimaryKeyConflictException();
-          }
-        }
-        block_num = bp->GetNextBlockNum();
-      }
-    }
+  if (has_pk && HasPrimaryKey(tbl, tkey_values)) {
+    throw PrimaryKeyConflictException();
   }
 
-  char *content;
   int ub = tbl->first_block_num();    // The first "useful" block.
   int frb = tbl->first_rubbish_num();   // The first "rubbish" (reusable) block.
-  int lastub;
+  int lastub = -1;
   int blocknum, offset;
 
   // Search for a useful block with free space.
@@ -88,13 +164,8 @@ void RecordManager::Insert(SQLInsert &st) {
       ub = bp->GetNextBlockNum();
       continue;
     }
-    // Calculate where the new record should be stored within the block.
-    content = bp->GetContentAddress() + bp->GetRecordCount() * tbl->record_length(); 
-    // Copy each key's data into the block.
-    for (vector<TKey>::iterator iter = tkey_values.begin(); iter != tkey_values.end(); ++iter) {
-      memcpy(content, iter->key(), iter->length());
-      content += iter->length();
-    }
+    // Store the new record after the last one of the block.
+    WriteRecord(tbl, bp, bp->GetRecordCount(), tkey_values);
     // Increase the record count for the block.
     bp->SetRecordCount(1 + bp->GetRecordCount());
 
@@ -102,16 +173,9 @@ void RecordManager::Insert(SQLInsert &st) {
     offset = bp->GetRecordCount() - 1;
     hdl_->WriteBlock(bp);
 
-    // Update the index with the new record if an index exists.
-    if (tbl->GetIndexNum() != 0) {
-      BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
-      for (int i = 0; i < tbl->ats().size(); ++i) {
-        if (tbl->GetIndex(0)->attr_name() == tbl->GetIndex(i)->attr_name()) {
-          tree.Add(tkey_values[i], blocknum, offset);
-          break;
-        }
-      }
-    }
+    // Enter the new record in the zone map and the indexes.
+    AddToZone(tbl, blocknum, offset);
+    AddToIndexes(tbl, blocknum, offset);
 
     hdl_->WriteToDisk();
     cm_->WriteArchiveFile();
@@ -120,27 +184,29 @@ void RecordManager::Insert(SQLInsert &st) {
 
   // If no useful block has free space, try using a rubbish block.
   if (frb != -1) {
-    BlockInfo *bp = GetBlockInfo(tbl, frb);
-    content = bp->GetContentAddress();
-    for (vector<TKey>::iterator iter = tkey_values.begin(); iter != tkey_values.end(); ++iter) {
-      memcpy(content, iter->key(), iter->length());
-      content += iter->length();
+    // Link the rubbish block into the chain of useful blocks, as its head
+    // if the chain is empty. The last useful block is updated first, so
+    // that loading it cannot push the reused block out of the buffer.
+    if (lastub == -1) {
+      tbl->set_first_block_num(frb);
+    } else {
+      BlockInfo *lastubp = GetBlockInfo(tbl, lastub);
+      lastubp->SetNextBlockNum(frb);
+      hdl_->WriteBlock(lastubp);
     }
-    bp->SetRecordCount(1);
 
-    // Link the rubbish block into the chain of useful blocks.
-    BlockInfo *lastubp = GetBlockInfo(tbl, lastub);
-    lastubp->SetNextBlockNum(frb);
+    BlockInfo *bp = GetBlockInfo(tbl, frb);
+    WriteRecord(tbl, bp, 0, tkey_values);
+    bp->SetRecordCount(1);
     tbl->set_first_rubbish_num(bp->GetNextBlockNum());
-
     bp->SetPrevBlockNum(lastub);
     bp->SetNextBlockNum(-1);
 
     blocknum = frb;
     offset = 0;
+    tbl->AddBlock(frb);
 
     hdl_->WriteBlock(bp);
-    hdl_->WriteBlock(lastubp);
   } else {
     // If no rubbish block is available, add a new block 
     int next_block = tbl->first_block_num();
@@ -156,132 +222,163 @@ void RecordManager::Insert(SQLInsert &st) {
     bp->SetNextBlockNum(next_block);
     bp->SetRecordCount(1);
 
-    content = bp->GetContentAddress();
-    for (vector<TKey>::iterator iter = tkey_values.begin(); iter != tkey_values.end(); ++iter) {
-      memcpy(content, iter->key(), iter->length());
-      content += iter->length();
-    }
+    WriteRecord(tbl, bp, 0, tkey_values);
 
     blocknum = tbl->block_count();
     offset = 0;
+    tbl->AddBlock(blocknum);
     hdl_->WriteBlock(bp);
 
     tbl->IncreaseBlockCount();
   }
 
-  // After inserting, update the index with the new record if an index exists.
-  if (tbl->GetIndexNum() != 0) {
-    BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
-    for (int i = 0; i < tbl->ats().size(); ++i) {
-      if (tbl->GetIndex(0)->attr_name() == tbl->GetIndex(i)->name()) {
-        tree.Add(tkey_values[i], blocknum, offset);
-        break;
-      }
-    }
-  }
+  // After inserting, enter the new record in the indexes. The block held
+  // no record before, so its zone is bounded by this one alone.
+  ComputeZone(tbl, blocknum);
+  AddToIndexes(tbl, blocknum, offset);
   cm_->WriteArchiveFile();
   hdl_->WriteToDisk();
 }
 
 
 void RecordManager::Select(SQLSelect &st) {
-  // Get the table object and print column headers.
+  // Get the table object and the columns to return.
   Table *tbl = cm_->GetDB(db_name_)->GetTable(st.tb_name());
-  for (int i = 0; i < tbl->GetAttributeNum(); ++i) {
-    cout << setw(9) << left << tbl->ats()[i].attr_name();
+  vector<SQLSelectItem> items = st.items();
+  if (items.empty()) {
+    for (unsigned int i = 0; i < tbl->GetAttributeNum(); ++i) {
+      SQLSelectItem item;
+      item.func = -1;
+      item.col = tbl->ats()[i].attr_name();
+      items.push_back(item);
+    }
   }
-  cout << endl;
 
-  vector<vector<TKey>> tkey_values;
-  bool has_index = false;
-  int index_idx, where_idx;
-
-  // Check if any index can be used based on WHERE conditions
-  if (tbl->GetIndexNum() != 0) {
-    for (int i = 0; i < tbl->GetIndexNum(); ++i) {
-      Index *idx = tbl->GetIndex(i);
-      for (int j = 0; j < st.wheres().size(); ++j) {
-        if (idx->attr_name() == st.wheres()[j].key &&
-            st.wheres()[j].sign_type == SIGN_EQ) {
-          has_index = true;
-          index_idx = i;
-          where_idx = j;
-        }
-      }
+  // ORDER BY keys not in the select list are produced after it and dropped
+  // once the rows are sorted.
+  unsigned int shown = items.size();
+  vector<SortKey> keys;
+  for (unsigned int i = 0; i < st.order().size(); ++i) {
+    SQLSelectItem &item = st.order()[i].item;
+    unsigned int j = 0;
+    while (j < items.size() &&
+           (items[j].func != item.func || items[j].col != item.col)) {
+      ++j;
+    }
+    if (j == items.size()) {
+      items.push_back(item);
     }
+    SortKey key;
+    key.col = j;
+    key.desc = st.order()[i].desc;
+    keys.push_back(key);
   }
 
-  // Full table scan if no index is applicable.
-  if (!has_index) {
-    int block_num = tbl->first_block_num();
-    for (int i = 0; i < tbl->block_count(); ++i) {
-      BlockInfo *bp = GetBlockInfo(tbl, block_num);
-      for (int j = 0; j < bp->GetRecordCount(); ++j) {
-        vector<TKey> tkey_value = GetRecord(tbl, block_num, j);
-        //The sats variable is used to check whether a record satisfies all WHERE conditions in the SQL SELECT query.
-        bool sats = true;
-        for (int k = 0; k < st.wheres().size(); ++k) {
-          if (!SatisfyWhere(tbl, tkey_value, st.wheres()[k])) {
-            sats = false;
-          }
-        }
-        if (sats) {
-          tkey_values.push_back(tkey_value);
-        }
-      }
-
-      block_num = bp->GetNextBlockNum();
-    }
-  } 
-  else { // Use index search
-    // Create a B+ Tree object for the indexed column
-    BPlusTree tree(tbl->GetIndex(index_idx), hdl_, cm_, db_name_);
-
-    // Retrieve the type and length of the indexed key
-    int type = tbl->GetIndex(index_idx)->key_type();
-    int length = tbl->GetIndex(index_idx)->key_len();
-    // Extract the search value from the WHERE condition
-    std::string value = st.wheres()[where_idx].value;
-
-    TKey dest_key(type, length);
-    dest_key.ReadValue(value); // Convert the string value into the appropriate key format
-    // Search for the value in the B+ Tree index
-    int blocknum = tree.GetVal(dest_key);
-    // If the value exists in the index
-    if (blocknum != -1) {
-        int blockoffset = blocknum; // Store the original blocknum
-        blocknum = (blocknum >> 16) & 0xffff;  // Extract the block number
-        blockoffset = blockoffset & 0xffff;    // Extract the offset within the block
-
-        // Retrieve the record from the table based on the found block and offset
-        vector<TKey> tkey_value = GetRecord(tbl, blocknum, blockoffset);
-        
-        // Check if the record satisfies all WHERE conditions
-        bool sats = true;
-        for (int k = 0; k < st.wheres().size(); ++k) {
-            if (!SatisfyWhere(tbl, tkey_value, st.wheres()[k])) {
-                sats = false;
-            }
-        }
-
-        // If the record matches all conditions, add it to the result set
-        if (sats) {
-            tkey_values.push_back(tkey_value);
-        }
+  bool aggregate = !st.group_cols().empty();
+  for (unsigned int i = 0; i < items.size(); ++i) {
+    if (items[i].func != -1) {
+      aggregate = true;
     }
   }
+  if (aggregate && st.items().empty()) {
+    throw SyntaxErrorException();
+  }
 
-
-  // Print the matching records.
-  for (int i = 0; i < tkey_values.size(); ++i) {
-    for (int j = 0; j < tkey_values[i].size(); ++j) {
-      cout << tkey_values[i][j];
+  // Only the listed columns are copied out of the records; the WHERE
+  // conditions are tested where they lie. Rows are printed batch by batch
+  // as the plan produces them.
+  Operator *plan;
+  if (aggregate) {
+    plan = PlanAggregate(tbl, items, st);
+  } else {
+    vector<int> cols;
+    for (unsigned int i = 0; i < items.size(); ++i) {
+      int col = tbl->GetAttributeIndex(items[i].col);
+      if (col == -1) {
+        throw AttributeNotExistException();
+      }
+      cols.push_back(col);
+    }
+    // Rows ordered by the leading attributes of a B+ tree index, all one
+    // way, are read along it, forward or backward, instead of being sorted;
+    // the keys after a whole primary key never matter. A limit then stops
+    // the walk early.
+    Index *idx = NULL;
+    for (unsigned int i = 0; !keys.empty() && i < tbl->GetIndexNum(); ++i) {
+      Index *cand = tbl->GetIndex(i);
+      if (cand->method() != INDEX_BTREE ||
+          (keys[0].desc && !cand->back_links())) {
+        continue;
+      }
+      vector<string> &names = cand->attr_names();
+      unsigned int n = 0;
+      while (n < keys.size() && n < names.size() &&
+             items[keys[n].col].col == names[n] &&
+             keys[n].desc == keys[0].desc) {
+        ++n;
+      }
+      if (n == keys.size() || (n == names.size() && cand->unique())) {
+        idx = cand;
+      }
+    }
+    if (idx != NULL) {
+      plan = PlanIndexScan(tbl, idx, st.wheres(), cols, keys[0].desc);
+      keys.clear();
+    } else {
+      plan = PlanScan(tbl, st.wheres(), cols, keys.empty());
     }
-    cout << endl;
   }
-
-  // Optionally print the B+ tree structure for the first index for debugging.
-  if (tbl->GetIndexNum() != 0) {
+  if (!keys.empty()) {
+    // With a limit only the rows up to it are kept while sorting.
+    long limit = st.limit() == -1 ? -1 : st.limit() + st.offset();
+    plan = new Sort(plan, keys, spill_, limit);
+  }
+  if (items.size() > shown) {
+    vector<int> out;
+    for (unsigned int i = 0; i < shown; ++i) {
+      out.push_back(i);
+    }
+    plan = new Project(plan, out);
+  }
+  if (st.limit() != -1 || st.offset() != 0) {
+    plan = new Limit(plan, st.limit(), st.offset());
+  }
+  if (st.explain()) {
+    long rows = 0;
+    try {
+      CountSink sink(rows);
+      RunPlan(plan, sink);
+    } catch (...) {
+      delete plan;
+      throw;
+    }
+    delete plan;
+    cout << "Rows: " << rows << ", blocks read: " << blocks_read_
+         << ", blocks skipped: " << blocks_skipped_ << endl;
+    return;
+  }
+  for (unsigned int i = 0; i < plan->schema().size(); ++i) {
+    cout << setw(9) << left << plan->schema()[i].attr_name();
+  }
+  cout << endl;
+  try {
+    PrintSink sink(cout);
+    RunPlan(plan, sink);
+  } catch (...) {
+    delete plan;
+    throw;
+  }
+  delete plan;
+
+  // Optionally print the structure of the first index for debugging.
+  if (tbl->GetIndexNum() != 0 && tbl->GetIndex(0)->method() == INDEX_HASH) {
+    HashIndex hash(tbl->GetIndex(0), hdl_, db_name_);
+    hash.Print();
+  } else if (tbl->GetIndexNum() != 0 &&
+             tbl->GetIndex(0)->method() == INDEX_BITMAP) {
+    BitmapIndex bitmap(tbl, tbl->GetIndex(0), hdl_, db_name_);
+    bitmap.Print();
+  } else if (tbl->GetIndexNum() != 0) {
     BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
     tree.Print();
   }
@@ -290,95 +387,38 @@ void RecordManager::Select(SQLSelect &st) {
 
 void RecordManager::Delete(SQLDelete &st) {
   Table *tbl = cm_->GetDB(db_name_)->GetTable(st.tb_name());
-  
-  bool has_index = false;
-  int index_idx;  
-  int where_idx;  
-
-  // Determine if an applicable index exists for an equality condition.
-  if (tbl->GetIndexNum() != 0) {
-    for (int i = 0; i < tbl->GetIndexNum(); ++i) {
-      Index *idx = tbl->GetIndex(i);
-      for (int j = 0; j < st.wheres().size(); ++j) {
-        if (idx->attr_name() == st.wheres()[j].key) {
-          index_idx = i;
-          // Use the index only when the where condition is an equality.
-          if (st.wheres()[j].sign_type == SIGN_EQ) {
-            has_index = true;
-            where_idx = j;
-          }
-        }
-      }
+
+  // Find every qualifying record before changing any block. Only the record
+  // ids are needed, so no column is copied out.
+  vector<int> rids;
+  vector<int> no_cols;
+  Operator *plan = PlanScan(tbl, st.wheres(), no_cols, false);
+  RidSink sink(rids);
+  RunPlan(plan, sink);
+  delete plan;
+
+  // DeleteRecord moves the last record of the block into the freed slot.
+  // Deleting the highest offsets first means the record moved has always
+  // been passed over already, so the ids still to visit stay valid.
+  sort(rids.begin(), rids.end(), greater<int>());
+  for (unsigned int i = 0; i < rids.size(); ++i) {
+    int block_num = (rids[i] >> 16) & 0xffff;
+    int offset = rids[i] & 0xffff;
+    // Copy the index keys out before the slot is overwritten.
+    vector<TKey> keys = GetIndexKeys(tbl, block_num, offset);
+    for (unsigned int j = 0; j < keys.size(); ++j) {
+      RemoveFromIndex(tbl, tbl->GetIndex(j), keys[j]);
     }
+    DeleteRecord(tbl, block_num, offset);
   }
 
-  // If no suitable index exists, perform a full table scan.
-  if (!has_index) {
-    // Iterate through all blocks in the table.
-    int block_num = tbl->first_block_num();
-    for (int i = 0; i < tbl->block_count(); ++i) {
-      BlockInfo *bp = GetBlockInfo(tbl, block_num);
-      int count = bp->GetRecordCount();
-      // For each record in the block, check if it satisfies all conditions.
-      for (int j = 0; j < count; ++j) {
-        vector<TKey> tkey_value = GetRecord(tbl, block_num, j);
-        bool sats = true;
-        for (int k = 0; k < st.wheres().size(); ++k) {
-          if (!SatisfyWhere(tbl, tkey_value, st.wheres()[k])) {
-            sats = false;
-          }
-        }
-        // If record meets all conditions, delete it.
-        if (sats) {
-          DeleteRecord(tbl, block_num, j);
-          // Additionally update the index (if it exists) by removing the corresponding key.
-          if (tbl->GetIndexNum() != 0) {
-            BPlusTree tree(tbl->GetIndex(index_idx), hdl_, cm_, db_name_);
-            int idx = -1;
-            for (int i = 0; i < tbl->GetAttributeNum(); ++i) {
-              if (tbl->ats()[i].attr_name() == tbl->GetIndex(index_idx)->attr_name()) {
-                idx = i;
-              }
-            }
-            tree.Remove(tkey_value[idx]);
-          }
-        }
-      }
-      // Move to the next block.
-      block_num = bp->GetNextBlockNum();
-    }
-  } else {  
-    // Use the index to quickly locate the record matching the equality condition.
-    BPlusTree tree(tbl->GetIndex(index_idx), hdl_, cm_, db_name_);
-
-    // Build a TKey from the where clause value for the indexed attribute.
-    int type = tbl->GetIndex(index_idx)->key_type();
-    int length = tbl->GetIndex(index_idx)->key_len();
-    std::string value = st.wheres()[where_idx].value;
-    TKey dest_key(type, length);
-    dest_key.ReadValue(value);
-
-    // Use the B+ tree to get the encoded block number where the record is located.
-    int blocknum = tree.GetVal(dest_key);
-    if (blocknum != -1) {
-      // Decode the combined block number and offset.
-      int blockoffset = blocknum;
-      blocknum = (blocknum >> 16) & 0xffff;
-      blockoffset = blockoffset & 0xffff;
-      
-      // Retrieve the record using the decoded block number and offset.
-      vector<TKey> tkey_value = GetRecord(tbl, blocknum, blockoffset);
-      bool sats = true;
-      for (int k = 0; k < st.wheres().size(); ++k) {
-        if (!SatisfyWhere(tbl, tkey_value, st.wheres()[k])) {
-          sats = false;
-        }
-      }
-      // If the record satisfies all conditions, delete it and update the index.
-      if (sats) {
-        DeleteRecord(tbl, blocknum, blockoffset);
-        tree.Remove(dest_key);
-      }
+  // The bounds of the blocks may be tighter without the records deleted.
+  // Each block is summarized once, after its last delete: the ids are in
+  // descending order, so its deletes are consecutive.
+  for (unsigned int i = 0; i < rids.size(); ++i) {
+    int block_num = (rids[i] >> 16) & 0xffff;
+    if (i + 1 == rids.size() || ((rids[i + 1] >> 16) & 0xffff) != block_num) {
+      ComputeZone(tbl, block_num);
     }
   }
 
@@ -392,15 +432,7 @@ void RecordManager::Update(SQLUpdate &st) {
 
   vector<int> indices;    // Attribute indices to be updated.
   vector<TKey> values;    // New values for the attributes.
-  int pk_index = -1;      // Primary key attribute index.
-  int affect_index = -1;  // Index in the keyvalues vector for the primary key update.
-
-  // Find the primary key attribute.
-  for (int i = 0; i < tbl->ats().size(); ++i) {
-    if (tbl->ats()[i].attr_type() == 1) {
-      pk_index = i;
-    }
-  }
+  bool pk_changed = false; // Some primary key attribute is assigned.
 
   // Build indices and new values; also record if the primary key is affected.
   for (int i = 0; i < st.keyvalues().size(); ++i) {
@@ -409,82 +441,82 @@ void RecordManager::Update(SQLUpdate &st) {
     TKey value(tbl->ats()[index].data_type(), tbl->ats()[index].length());
     value.ReadValue(st.keyvalues()[i].value);
     values.push_back(value);
-    if (index == pk_index) {
-      affect_index = i;
+    if (tbl->ats()[index].attr_type() == 1) {
+      pk_changed = true;
     }
   }
 
-  // Check for primary key conflicts if the primary key is being updated.
-  if (affect_index != -1) {
-    // If an index exists, use it to quickly check for conflicts.
-    if (tbl->GetIndexNum() != 0) {
-      BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
-      int value = tree.GetVal(values[affect_index]);
-      if (value != -1) {  // A record with the new primary key already exists.
-        throw PrimaryKeyConflictException();
+  // Find the records to update.
+  vector<int> rids;
+  vector<int> no_cols;
+  Operator *scan = PlanScan(tbl, st.wheres(), no_cols, false);
+  RidSink sink(rids);
+  RunPlan(scan, sink);
+  delete scan;
+
+  // Each record has to keep a primary key of its own: the new keys may
+  // neither be in the table already nor repeat among the records.
+  if (pk_changed) {
+    set<string> seen;
+    for (unsigned int i = 0; i < rids.size(); ++i) {
+      vector<TKey> record =
+          GetRecord(tbl, (rids[i] >> 16) & 0xffff, rids[i] & 0xffff);
+      for (unsigned int j = 0; j < indices.size(); ++j) {
+        record[indices[j]] = values[j];
       }
-    } else {
-      // No index available, so perform a full scan to detect conflicts.
-      int block_num = tbl->first_block_num();
-      for (int i = 0; i < tbl->block_count(); ++i) {
-        BlockInfo *bp = GetBlockInfo(tbl, block_num);
-        for (int j = 0; j < bp->GetRecordCount(); ++j) {
-          vector<TKey> tkey_value = GetRecord(tbl, block_num, j);
-          if (tkey_value[pk_index] == values[affect_index]) {
-            throw PrimaryKeyConflictException();
-          }
+      string key;
+      for (unsigned int j = 0; j < tbl->GetAttributeNum(); ++j) {
+        if (tbl->ats()[j].attr_type() == 1) {
+          key += ValueString(record[j]) + '\0';
         }
-        block_num = bp->GetNextBlockNum();
+      }
+      if (!seen.insert(key).second || HasPrimaryKey(tbl, record)) {
+        throw PrimaryKeyConflictException();
       }
     }
   }
 
-  // Iterate through the table blocks to update matching records.
-  int block_num = tbl->first_block_num();
-  for (int i = 0; i < tbl->block_count(); ++i) {
-    BlockInfo *bp = GetBlockInfo(tbl, block_num);
-    for (int j = 0; j < bp->GetRecordCount(); ++j) {
-      vector<TKey> tkey_value = GetRecord(tbl, block_num, j);
-      bool sats = true;
-      // Check if the record meets all where conditions.
-      for (int k = 0; k < st.wheres().size(); ++k) {
-        if (!SatisfyWhere(tbl, tkey_value, st.wheres()[k])) {
-          sats = false;
-        }
-      }
-      if (sats) {
-        // If an index exists, remove the old key value.
-        if (tbl->GetIndexNum() != 0) {
-          BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
-          int idx = -1;
-          for (int i = 0; i < tbl->GetAttributeNum(); ++i) {
-            if (tbl->ats()[i].attr_name() == tbl->GetIndex(0)->attr_name()) {
-              idx = i;
-            }
-          }
-          tree.Remove(tkey_value[idx]);
-        }
-
-        // Update the record with the new values.
-        UpdateRecord(tbl, block_num, j, indices, values);
-
-        // After update, get the new record values.
-        tkey_value = GetRecord(tbl, block_num, j);
-
-        // If an index exists, add the new key value back into the index.
-        if (tbl->GetIndexNum() != 0) {
-          BPlusTree tree(tbl->GetIndex(0), hdl_, cm_, db_name_);
-          int idx = -1;
-          for (int i = 0; i < tbl->GetAttributeNum(); ++i) {
-            if (tbl->ats()[i].attr_name() == tbl->GetIndex(0)->attr_name()) {
-              idx = i;
-            }
-          }
-          tree.Add(tkey_value[idx], block_num, j);
-        }
+  // An index is only kept up to date when a column it holds, in the key or
+  // included, is assigned; the record ids do not change, so otherwise its
+  // entries still hold.
+  vector<int> changed;
+  for (unsigned int i = 0; i < tbl->GetIndexNum(); ++i) {
+    vector<string> names = tbl->GetIndex(i)->attr_names();
+    names.insert(names.end(), tbl->GetIndex(i)->include_names().begin(),
+                 tbl->GetIndex(i)->include_names().end());
+    for (unsigned int j = 0; j < names.size(); ++j) {
+      int col = tbl->GetAttributeIndex(names[j]);
+      if (find(indices.begin(), indices.end(), col) != indices.end()) {
+        changed.push_back(i);
+        break;
       }
     }
-    block_num = bp->GetNextBlockNum();
+  }
+  for (unsigned int i = 0; i < rids.size(); ++i) {
+    int block_num = (rids[i] >> 16) & 0xffff;
+    int offset = rids[i] & 0xffff;
+    if (changed.empty()) {
+      UpdateRecord(tbl, block_num, offset, indices, values);
+      continue;
+    }
+    vector<TKey> old_keys = GetIndexKeys(tbl, block_num, offset);
+    UpdateRecord(tbl, block_num, offset, indices, values);
+    vector<TKey> new_keys = GetIndexKeys(tbl, block_num, offset);
+    for (unsigned int j = 0; j < changed.size(); ++j) {
+      Index *idx = tbl->GetIndex(changed[j]);
+      RemoveFromIndex(tbl, idx, old_keys[changed[j]]);
+      AddToIndex(tbl, idx, new_keys[changed[j]], block_num, offset);
+    }
+  }
+
+  // UpdateRecord only widened the bounds to the new values; without the
+  // old ones they may be narrower.
+  set<int> blocks;
+  for (unsigned int i = 0; i < rids.size(); ++i) {
+    blocks.insert((rids[i] >> 16) & 0xffff);
+  }
+  for (set<int>::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+    ComputeZone(tbl, *it);
   }
 
   // Write changes to disk.
@@ -524,60 +556,83 @@ void RecordManager::Join(SQLJoin &st) {
     throw SyntaxErrorException();
   }
 
-  vector<vector<TKey>> tkey_values;
-
-  // Match values and store the inner join in tkey_values.
-  int block1 = tbl1->first_block_num();
-  for (int b1 = 0; b1 < tbl1->block_count() && block1 != -1; ++b1) {
-    BlockInfo *bp1 = GetBlockInfo(tbl1, block1);
-    for (int r1 = 0; r1 < bp1->GetRecordCount(); ++r1) {
-      vector<TKey> rec1 = GetRecord(tbl1, block1, r1);
-      TKey key1 = rec1[colIndex1];
-
-      int block2 = tbl2->first_block_num();
-      for (int b2 = 0; b2 < tbl2->block_count() && block2 != -1; ++b2) {
-        BlockInfo *bp2 = GetBlockInfo(tbl2, block2);
-        for (int r2 = 0; r2 < bp2->GetRecordCount(); ++r2) {
-          vector<TKey> rec2 = GetRecord(tbl2, block2, r2);
-          TKey key2 = rec2[colIndex2];
-
-          if (key1 == key2) {
-            vector<TKey> joinRow;
-            // Add all columns from the first table.
-            for (int i = 0; i < rec1.size(); ++i) {
-              joinRow.push_back(rec1[i]);
-            }
-            // Add columns from the second table except the join column.
-            for (int i = 0; i < rec2.size(); ++i) {
-              if (i == colIndex2) continue;
-              joinRow.push_back(rec2[i]);
-            }
-            tkey_values.push_back(joinRow);
-          }
-        }
-        block2 = bp2->GetNextBlockNum();
-      }
+  if (tbl1->ats()[colIndex1].data_type() != tbl2->ats()[colIndex2].data_type()) {
+    throw SyntaxErrorException();
+  }
+
+  // With an index on the join column of one table, the rows of the other
+  // are looked up in it while they are no more numerous. When both columns
+  // are indexed that is only done for a table with fewer rows than the
+  // other has blocks; otherwise both leaf chains are merged, which reads
+  // each table once in key order. A larger table without an index is
+  // sorted and merged with the indexed one. Without an index, both tables
+  // are scanned and hash joined on the smaller one. Then the duplicate join
+  // column is dropped.
+  vector<SQLWhere> no_wheres;
+  vector<int> cols1, cols2;
+  for (unsigned int i = 0; i < tbl1->GetAttributeNum(); ++i) {
+    cols1.push_back(i);
+  }
+  for (unsigned int i = 0; i < tbl2->GetAttributeNum(); ++i) {
+    cols2.push_back(i);
+  }
+  long blocks1 = GetBlocks(tbl1).size();
+  long blocks2 = GetBlocks(tbl2).size();
+  long rows1 = blocks1 * tbl1->GetMaxRecordCount();
+  long rows2 = blocks2 * tbl2->GetMaxRecordCount();
+  Index *idx1 = NULL;
+  Index *idx2 = NULL;
+  for (unsigned int i = 0; i < tbl1->GetIndexNum(); ++i) {
+    if (tbl1->GetIndex(i)->attr_name() == st.col_name1() &&
+        tbl1->GetIndex(i)->method() == INDEX_BTREE) {
+      idx1 = tbl1->GetIndex(i);
+    }
+  }
+  for (unsigned int i = 0; i < tbl2->GetIndexNum(); ++i) {
+    if (tbl2->GetIndex(i)->attr_name() == st.col_name2() &&
+        tbl2->GetIndex(i)->method() == INDEX_BTREE) {
+      idx2 = tbl2->GetIndex(i);
     }
-    block1 = bp1->GetNextBlockNum();
   }
+  // Lookups need an index holding each value of the column once, as it is;
+  // any B+ tree index led by the column gives the rows in order for a merge.
+  Operator *join;
+  if (idx2 != NULL && idx2->key_type() != T_BYTES && rows1 <= rows2 &&
+      (idx1 == NULL || rows1 < blocks2)) {
+    join = new IndexJoin(ScanTable(tbl1, no_wheres, cols1, false), this, tbl2,
+                         idx2, colIndex1, true);
+  } else if (idx1 != NULL && idx1->key_type() != T_BYTES && rows2 < rows1 &&
+             (idx2 == NULL || rows2 < blocks1)) {
+    join = new IndexJoin(ScanTable(tbl2, no_wheres, cols2, false), this, tbl1,
+                         idx1, colIndex2, false);
+  } else if (idx1 != NULL || idx2 != NULL) {
+    Operator *in1 = ScanInOrder(tbl1, idx1, colIndex1, cols1);
+    Operator *in2 = ScanInOrder(tbl2, idx2, colIndex2, cols2);
+    join = new MergeJoin(in1, in2, colIndex1, colIndex2);
+  } else {
+    Operator *scan1 = ScanTable(tbl1, no_wheres, cols1, false);
+    Operator *scan2 = ScanTable(tbl2, no_wheres, cols2, false);
+    join = new HashJoin(scan1, scan2, colIndex1, colIndex2, rows1 <= rows2,
+                        spill_);
+  }
+  vector<int> cols;
+  for (unsigned int i = 0;
+       i < tbl1->GetAttributeNum() + tbl2->GetAttributeNum(); ++i) {
+    if (i != tbl1->GetAttributeNum() + colIndex2) {
+      cols.push_back(i);
+    }
+  }
+  Limit plan(new Project(join, cols), st.limit(), st.offset());
 
   // Print the header. We print all columns from tbl1 and only the non-join column from tbl2.
-  for (int i = 0; i < tbl1->GetAttributeNum(); ++i) {
-    cout << setw(12) << left << tbl1->ats()[i].attr_name();
-  }
-  for (int i = 0; i < tbl2->GetAttributeNum(); ++i) {
-    if (i == colIndex2) continue; // Skip the duplicate join column.
-    cout << setw(12) << left << tbl2->ats()[i].attr_name();
+  for (unsigned int i = 0; i < plan.schema().size(); ++i) {
+    cout << setw(9) << left << plan.schema()[i].attr_name();
   }
   cout << endl;
 
-  // Print all joined rows stored in tkey_values.
-  for (auto &row : tkey_values) {
-    for (auto &field : row) {
-      cout << setw(12) << left << field;
-    }
-    cout << endl;
-  }
+  // Print all joined rows as they are produced.
+  PrintSink sink(cout);
+  RunPlan(&plan, sink);
 }
 
 
@@ -585,38 +640,359 @@ void RecordManager::Join(SQLJoin &st) {
 //-------------------------------END OF JOIN FUNCTION---------------------------//
 
 
-std::vector<TKey> RecordManager::GetRecord(Table *tbl, int block_num,
-                                           int offset) {
-  vector<TKey> keys;
-  BlockInfo *bp = GetBlockInfo(tbl, block_num);
+Operator *RecordManager::PlanScan(Table *tbl, std::vector<SQLWhere> &wheres,
+                                  std::vector<int> &cols, bool keep_order) {
+  // An index that holds every column read answers from its leaves alone,
+  // so it is preferred; it is even read whole, without conditions on its
+  // key, when its entries are at most half as wide as the records.
+  //
+  // Conditions on columns with a bitmap index are answered by combining
+  // the bitmaps, unless a unique index finds the one record.
+  vector<int> fetch = ScanColumns(tbl, wheres, cols);
+  Index *best = NULL;
+  int best_rank = 0;
+  Index *bitmap = NULL;
+  for (unsigned int i = 0; i < tbl->GetIndexNum(); ++i) {
+    Index *idx = tbl->GetIndex(i);
+    if (idx->method() == INDEX_BITMAP) {
+      for (unsigned int j = 0; j < wheres.size(); ++j) {
+        if (wheres[j].key == idx->attr_name()) {
+          bitmap = idx;
+        }
+      }
+      continue;
+    }
+    KeyRange range(idx->key_type(), idx->key_len());
+    int fixed = MakeKeyRange(tbl, idx, wheres, range);
+    bool covers = Covers(tbl, idx, fetch);
+    // A hash index only finds keys whose every attribute is given; it is
+    // then preferred, as a lookup reads a page or two.
+    if (idx->method() == INDEX_HASH &&
+        fixed != 2 * (int)idx->attr_names().size()) {
+      continue;
+    }
+    if (fixed == 0 &&
+        (!covers || 2 * (4 + idx->key_len()) > tbl->record_length())) {
+      continue;
+    }
+    int rank = 8 * fixed;
+    if (idx->unique()) {
+      rank += 4;
+    }
+    if (covers) {
+      rank += 2;
+    }
+    if (idx->method() == INDEX_HASH) {
+      rank++;
+    }
+    if (rank > best_rank) {
+      best = idx;
+      best_rank = rank;
+    }
+  }
+  if (bitmap != NULL &&
+      (best == NULL || !best->unique() ||
+       best_rank < 16 * (int)best->attr_names().size())) {
+    best = bitmap;
+  }
+  if (best != NULL) {
+    return PlanIndexScan(tbl, best, wheres, cols, false);
+  }
+  return ScanTable(tbl, wheres, cols, keep_order);
+}
 
-  char *content = bp->data() + offset * tbl->record_length() + 12;
+Operator *RecordManager::PlanIndexScan(Table *tbl, Index *idx,
+                                       std::vector<SQLWhere> &wheres,
+                                       std::vector<int> &cols,
+                                       bool descending) {
+  // The conditions comparing the indexed column with a value are merged
+  // into one key range.
+  KeyRange range(idx->key_type(), idx->key_len());
+  MakeKeyRange(tbl, idx, wheres, range);
+  // All the conditions are checked by the filter on the records in the
+  // range. The records, or the entries of an index holding them all, give
+  // the requested columns followed by the other columns the conditions
+  // test.
+  vector<int> fetch = ScanColumns(tbl, wheres, cols);
+  Operator *plan;
+  if (idx->method() == INDEX_BITMAP) {
+    plan = new BitmapScan(this, tbl, wheres, fetch);
+  } else if (idx->method() == INDEX_HASH) {
+    plan = new HashIndexScan(this, tbl, idx, range, fetch);
+  } else {
+    plan = new IndexScan(this, tbl, idx, range, fetch, descending);
+  }
+  try {
+    plan = new Filter(plan, wheres);
+  } catch (...) {
+    delete plan;
+    throw;
+  }
+  vector<int> out;
+  for (unsigned int k = 0; k < cols.size(); ++k) {
+    out.push_back(k);
+  }
+  return new Project(plan, out);
+}
 
-  for (int i = 0; i < tbl->GetAttributeNum(); ++i) {
-    int value_type = tbl->ats()[i].data_type();
-    int length = tbl->ats()[i].length();
+Operator *RecordManager::PlanAggregate(Table *tbl,
+                                       std::vector<SQLSelectItem> &items,
+                                       SQLSelect &st) {
+  // The input carries the group columns first, then the other columns the
+  // aggregates and the WHERE conditions read, each once.
+  vector<int> in;
+  vector<int> group_cols;
+  for (unsigned int i = 0; i < st.group_cols().size(); ++i) {
+    int col = tbl->GetAttributeIndex(st.group_cols()[i]);
+    if (col == -1) {
+      throw AttributeNotExistException();
+    }
+    group_cols.push_back(find(in.begin(), in.end(), col) - in.begin());
+    if (group_cols.back() == (int)in.size()) {
+      in.push_back(col);
+    }
+  }
 
-    TKey tmp(value_type, length);
- //memcpy is used for efficient copying of blocks of memory in situations where you know that the source and destination regions do not intersect
-    memcpy(tmp.key(), content, length);
+  // Output column of each select list entry: a group column, or the
+  // aggregate computed for it.
+  vector<AggregateSpec> aggs;
+  vector<int> out;
+  for (unsigned int i = 0; i < items.size(); ++i) {
+    SQLSelectItem &item = items[i];
+    int col = -1;
+    if (item.col != "*") {
+      col = tbl->GetAttributeIndex(item.col);
+      if (col == -1) {
+        throw AttributeNotExistException();
+      }
+    }
+    if (item.func == -1) {
+      // A plain column has one value per group only if it is grouped on.
+      unsigned int g = 0;
+      while (g < group_cols.size() && in[group_cols[g]] != col) {
+        ++g;
+      }
+      if (g == group_cols.size()) {
+        throw SyntaxErrorException();
+      }
+      out.push_back(g);
+      continue;
+    }
+    if ((item.func == AGG_SUM || item.func == AGG_AVG) &&
+        tbl->ats()[col].data_type() == T_CHAR) {
+      throw SyntaxErrorException();
+    }
+    AggregateSpec agg;
+    agg.func = item.func;
+    agg.col = -1;
+    if (col != -1) {
+      agg.col = find(in.begin(), in.end(), col) - in.begin();
+      if (agg.col == (int)in.size()) {
+        in.push_back(col);
+      }
+    }
+    out.push_back(group_cols.size() + aggs.size());
+    aggs.push_back(agg);
+  }
+  for (unsigned int i = 0; i < st.wheres().size(); ++i) {
+    int col = tbl->GetAttributeIndex(st.wheres()[i].key);
+    if (col != -1 && find(in.begin(), in.end(), col) == in.end()) {
+      in.push_back(col);
+    }
+  }
 
-    keys.push_back(tmp);
+  // An index led by the group columns, in any order, hands the rows over
+  // group by group, unless an equality on its leading column makes a lookup
+  // cheaper.
+  Index *idx = NULL;
+  for (unsigned int i = 0; i < tbl->GetIndexNum(); ++i) {
+    if (tbl->GetIndex(i)->method() != INDEX_BTREE) {
+      continue;
+    }
+    vector<string> &names = tbl->GetIndex(i)->attr_names();
+    unsigned int n = 0;
+    while (n < group_cols.size() && n < names.size() &&
+           find(in.begin(), in.begin() + group_cols.size(),
+                tbl->GetAttributeIndex(names[n])) !=
+               in.begin() + group_cols.size()) {
+      ++n;
+    }
+    if (n > 0 && n == group_cols.size()) {
+      idx = tbl->GetIndex(i);
+    }
+  }
+  if (idx != NULL) {
+    for (unsigned int i = 0; i < st.wheres().size(); ++i) {
+      if (st.wheres()[i].key == idx->attr_name() &&
+          st.wheres()[i].sign_type == SIGN_EQ) {
+        idx = NULL;
+        break;
+      }
+    }
+  }
 
-    content += length;
+  Operator *plan;
+  if (idx != NULL) {
+    KeyRange all(idx->key_type(), idx->key_len());
+    plan = new Filter(new IndexScan(this, tbl, idx, all, in), st.wheres());
+    plan = new StreamAggregate(plan, group_cols, aggs);
+  } else {
+    plan = new HashAggregate(PlanScan(tbl, st.wheres(), in, false), group_cols,
+                             aggs, spill_);
   }
+  return new Project(plan, out);
+}
 
+Operator *RecordManager::ScanInOrder(Table *tbl, Index *idx, int col,
+                                     std::vector<int> &cols) {
+  if (idx != NULL) {
+    KeyRange all(idx->key_type(), idx->key_len());
+    return new IndexScan(this, tbl, idx, all, cols);
+  }
+  vector<SQLWhere> no_wheres;
+  vector<SortKey> keys(1);
+  keys[0].col = find(cols.begin(), cols.end(), col) - cols.begin();
+  keys[0].desc = false;
+  return new Sort(ScanTable(tbl, no_wheres, cols, false), keys, spill_);
+}
+
+Operator *RecordManager::ScanTable(Table *tbl, std::vector<SQLWhere> &wheres,
+                                   std::vector<int> &cols, bool keep_order) {
+  // A few morsels are not worth starting threads for.
+  if (GetBlocks(tbl).size() >= 2 * MORSEL_BLOCKS &&
+      thread::hardware_concurrency() > 1) {
+    return new ParallelTableScan(this, tbl, wheres, cols, keep_order);
+  }
+  return new TableScan(this, tbl, wheres, cols);
+}
+
+bool RecordManager::HasPrimaryKey(Table *tbl, std::vector<TKey> &record) {
+  vector<SQLWhere> wheres;
+  for (unsigned int i = 0; i < tbl->GetAttributeNum(); ++i) {
+    if (tbl->ats()[i].attr_type() == 1) {
+      SQLWhere where;
+      where.key = tbl->ats()[i].attr_name();
+      where.sign_type = SIGN_EQ;
+      where.value = ValueString(record[i]);
+      wheres.push_back(where);
+    }
+  }
+  vector<int> no_cols;
+
+  Operator *plan = PlanScan(tbl, wheres, no_cols, false);
+  Batch batch;
+  batch.Init(plan->schema());
+  plan->Open();
+  bool found = plan->Next(batch);
+  plan->Close();
+  delete plan;
+  return found;
+}
+
+std::vector<TKey> RecordManager::GetIndexKeys(Table *tbl, int block_num,
+                                              int offset) {
+  vector<TKey> keys;
+  if (tbl->GetIndexNum() == 0) {
+    return keys;
+  }
+  TupleView tuple = GetTuple(tbl, GetBlockInfo(tbl, block_num), offset);
+  vector<const char *> fields;
+  for (unsigned int i = 0; i < tbl->GetIndexNum(); ++i) {
+    Index *idx = tbl->GetIndex(i);
+    fields.clear();
+    for (unsigned int j = 0; j < idx->attr_names().size(); ++j) {
+      fields.push_back(
+          tuple.GetField(tbl->GetAttributeIndex(idx->attr_names()[j])));
+    }
+    for (unsigned int j = 0; j < idx->include_names().size(); ++j) {
+      fields.push_back(
+          tuple.GetField(tbl->GetAttributeIndex(idx->include_names()[j])));
+    }
+    keys.push_back(
+        MakeIndexKey(tbl, idx, fields.data(), (block_num << 16) | offset));
+  }
   return keys;
 }
 
+void RecordManager::AddToIndexes(Table *tbl, int block_num, int offset) {
+  vector<TKey> keys = GetIndexKeys(tbl, block_num, offset);
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    AddToIndex(tbl, tbl->GetIndex(i), keys[i], block_num, offset);
+  }
+}
+
+void RecordManager::AddToIndex(Table *tbl, Index *idx, TKey &key,
+                               int block_num, int offset) {
+  if (idx->method() == INDEX_BITMAP) {
+    BitmapIndex bitmap(tbl, idx, hdl_, db_name_);
+    bitmap.Add(key, block_num, offset);
+  } else if (idx->method() == INDEX_HASH) {
+    HashIndex hash(idx, hdl_, db_name_);
+    hash.Add(key, block_num, offset);
+  } else {
+    BPlusTree tree(idx, hdl_, cm_, db_name_);
+    tree.Add(key, block_num, offset);
+  }
+}
+
+void RecordManager::RemoveFromIndex(Table *tbl, Index *idx, TKey &key) {
+  if (idx->method() == INDEX_BITMAP) {
+    BitmapIndex bitmap(tbl, idx, hdl_, db_name_);
+    bitmap.Remove(key);
+  } else if (idx->method() == INDEX_HASH) {
+    HashIndex hash(idx, hdl_, db_name_);
+    hash.Remove(key);
+  } else {
+    BPlusTree tree(idx, hdl_, cm_, db_name_);
+    tree.Remove(key);
+  }
+}
+
+void RecordManager::MoveInIndex(Index *idx, TKey &key, int block_num,
+                                int offset) {
+  if (idx->method() == INDEX_HASH) {
+    HashIndex hash(idx, hdl_, db_name_);
+    hash.SetVal(key, block_num, offset);
+  } else {
+    BPlusTree tree(idx, hdl_, cm_, db_name_);
+    tree.SetVal(key, block_num, offset);
+  }
+}
+
+TupleView RecordManager::GetTuple(Table *tbl, BlockInfo *bp, int offset) {
+  return TupleView(tbl, bp->GetContentAddress(), offset);
+}
+
+std::vector<TKey> RecordManager::GetRecord(Table *tbl, int block_num,
+                                           int offset) {
+  BlockInfo *bp = GetBlockInfo(tbl, block_num);
+  return GetTuple(tbl, bp, offset).Materialize();
+}
+
 void RecordManager::DeleteRecord(Table *tbl, int block_num, int offset) {
   BlockInfo *bp = GetBlockInfo(tbl, block_num);
 
-  char *content = bp->data() + offset * tbl->record_length() + 12;
-  char *replace =
-      bp->data() + (bp->GetRecordCount() - 1) * tbl->record_length() + 12;
-  memcpy(content, replace, tbl->record_length());
+  // The last record of the block moves into the freed slot, so its index
+  // entries have to follow it.
+  int last = bp->GetRecordCount() - 1;
+  vector<TKey> old_keys;
+  if (offset != last) {
+    old_keys = GetIndexKeys(tbl, block_num, last);
+  }
+
+  char *content = bp->GetContentAddress();
+  for (unsigned int i = 0; i < tbl->GetAttributeNum(); ++i) {
+    int base = tbl->GetFieldBase(i);
+    int stride = tbl->GetFieldStride(i);
+    memcpy(content + base + offset * stride, content + base + last * stride,
+           tbl->ats()[i].length());
+  }
 
   bp->DecreaseRecordCount();
+  vector<TKey> new_keys;
+  if (offset != last) {
+    new_keys = GetIndexKeys(tbl, block_num, offset);
+  }
 
   // add the block to rubbish block chain
   if (bp->GetRecordCount() == 0) { 
@@ -628,6 +1004,8 @@ void RecordManager::DeleteRecord(Table *tbl, int block_num, int offset) {
       BlockInfo *pbp = GetBlockInfo(tbl, prevnum);
       pbp->SetNextBlockNum(nextnum);
       hdl_->WriteBlock(pbp);
+    } else {
+      tbl->set_first_block_num(nextnum);
     }
 
     if (nextnum != -1) {
@@ -637,16 +1015,35 @@ void RecordManager::DeleteRecord(Table *tbl, int block_num, int offset) {
     }
 
     BlockInfo *firstrubbish = GetBlockInfo(tbl, tbl->first_rubbish_num());
-    bp->SetNextBlockNum(-1);
-    bp->SetPrevBlockNum(-1);
     if (firstrubbish != NULL) {
       firstrubbish->SetPrevBlockNum(block_num);
-      bp->SetNextBlockNum(firstrubbish->block_num());
+      hdl_->WriteBlock(firstrubbish);
     }
+    // Loading the neighbours may have pushed the block out of the buffer.
+    bp = GetBlockInfo(tbl, block_num);
+    bp->SetNextBlockNum(tbl->first_rubbish_num());
+    bp->SetPrevBlockNum(-1);
     tbl->set_first_rubbish_num(block_num);
+    tbl->RemoveBlock(block_num);
+    if (tbl->has_zones()) {
+      tbl->ClearZone(block_num);
+    }
   }
 
   hdl_->WriteBlock(bp);
+
+  // Only now: walking the trees may push this block out of the buffer. The
+  // keys of a unique index stay and point at the new slot; the other keys
+  // hold the record id, so they are replaced.
+  for (unsigned int i = 0; i < old_keys.size(); ++i) {
+    Index *idx = tbl->GetIndex(i);
+    if (idx->unique()) {
+      MoveInIndex(idx, old_keys[i], block_num, offset);
+    } else {
+      RemoveFromIndex(tbl, idx, old_keys[i]);
+      AddToIndex(tbl, idx, new_keys[i], block_num, offset);
+    }
+  }
 }
 
 void RecordManager::UpdateRecord(Table *tbl, int block_num, int offset,
@@ -655,50 +1052,48 @@ void RecordManager::UpdateRecord(Table *tbl, int block_num, int offset,
 
   BlockInfo *bp = GetBlockInfo(tbl, block_num);
 
-  char *content = bp->data() + offset * tbl->record_length() + 12;
+  char *content = bp->GetContentAddress();
 
   for (int i = 0; i < tbl->GetAttributeNum(); i++) {
     vector<int>::iterator iter = find(indices.begin(), indices.end(), i);
     if (iter != indices.end()) {
-      memcpy(content, values[iter - indices.begin()].key(),
+      memcpy(content + tbl->GetFieldBase(i) + offset * tbl->GetFieldStride(i),
+             values[iter - indices.begin()].key(),
              values[iter - indices.begin()].length());
     }
-
-    content += tbl->ats()[i].length();
   }
 
   hdl_->WriteBlock(bp);
+  AddToZone(tbl, block_num, offset);
 }
 
-bool RecordManager::SatisfyWhere(Table *tbl, std::vector<TKey> keys, SQLWhere where) {
-  // Find the index of the attribute that matches the condition's key
-  int idx = -1;
-  for (int i = 0; i < tbl->GetAttributeNum(); ++i) {
-    if (tbl->ats()[i].attr_name() == where.key) {
-      idx = i;
-    }
-  }
-  
-  // Create a temporary key based on the attribute's type and length.
-  TKey tmp(tbl->ats()[idx].data_type(), tbl->ats()[idx].length());
-  // Convert the WHERE clause value to the appropriate format.
-  tmp.ReadValue(where.value.c_str());
-  
-  switch (where.sign_type) {
-    case SIGN_EQ:  // Equality check.
-      return keys[idx] == tmp;
-    case SIGN_NE:  // Not-equal check.
-      return keys[idx] != tmp;
-    case SIGN_LT:  // Less-than check.
-      return keys[idx] < tmp;
-    case SIGN_GT:  // Greater-than check.
-      return keys[idx] > tmp;
-    case SIGN_LE:  // Less-than or equal check.
-      return keys[idx] <= tmp;
-    case SIGN_GE:  // Greater-than or equal check.
-      return keys[idx] >= tmp;
-    default:
-      return false;
+void RecordManager::WriteRecord(Table *tbl, BlockInfo *bp, int offset,
+                                std::vector<TKey> &values) {
+  char *content = bp->GetContentAddress();
+  for (unsigned int i = 0; i < tbl->GetAttributeNum(); ++i) {
+    memcpy(content + tbl->GetFieldBase(i) + offset * tbl->GetFieldStride(i),
+           values[i].key(), values[i].length());
   }
 }
 
+void RecordManager::AddToZone(Table *tbl, int block_num, int offset) {
+  if (!tbl->has_zones()) {
+    return;
+  }
+  BlockInfo *bp = GetBlockInfo(tbl, block_num);
+  TupleView record = GetTuple(tbl, bp, offset);
+  WidenZone(tbl, tbl->GetZone(block_num), record);
+}
+
+void RecordManager::ComputeZone(Table *tbl, int block_num) {
+  if (!tbl->has_zones()) {
+    return;
+  }
+  tbl->ClearZone(block_num);
+  char *zone = tbl->GetZone(block_num);
+  BlockInfo *bp = GetBlockInfo(tbl, block_num);
+  for (int i = 0; i < bp->GetRecordCount(); ++i) {
+    TupleView record = GetTuple(tbl, bp, i);
+    WidenZone(tbl, zone, record);
+  }
+}
@@ -1,6 +1,8 @@
 #ifndef MINIDB_RECORD_MANAGER_H_
 #define MINIDB_RECORD_MANAGER_H_
 
+#include <stdint.h>
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -8,31 +10,112 @@
 #include "buffer_manager.h"
 #include "catalog_manager.h"
 #include "exceptions.h"
+#include "executor.h"
+#include "predicate.h"
+#include "spill_manager.h"
 #include "sql_statement.h"
+#include "tuple_view.h"
 
 class RecordManager {
 private:
   BufferManager *hdl_;
   CatalogManager *cm_;
   std::string db_name_;
+  SpillManager *spill_; // NULL keeps every operator in memory.
+  std::atomic<long> blocks_read_;    // Table blocks the plans have read.
+  std::atomic<long> blocks_skipped_; // Blocks their zone maps passed over.
+
+  // Build the access path for the WHERE conditions of a single table
+  // statement: an index range scan when an indexed column is compared with
+  // a value, preferring an equality and then the primary key, a hash
+  // index lookup when all its columns are given, or the bitmap indexes of
+  // the columns tested, otherwise a table scan with the conditions pushed
+  // down. The plan produces the table columns listed in `cols`, in key
+  // order from a B+ tree index, else in table order if `keep_order` is
+  // set.
+  Operator *PlanScan(Table *tbl, std::vector<SQLWhere> &wheres,
+                     std::vector<int> &cols, bool keep_order);
+  // The table columns listed in `cols` of the records the WHERE conditions
+  // keep, read along `idx` in ascending key order, or descending. The
+  // conditions on the indexed column bound the walk; for a hash index they
+  // give the key looked up, and the rows come in no particular order. For
+  // a bitmap index, the bitmap indexes of all the columns tested are
+  // combined, and the rows come in table order.
+  Operator *PlanIndexScan(Table *tbl, Index *idx,
+                          std::vector<SQLWhere> &wheres,
+                          std::vector<int> &cols, bool descending);
+  // The table columns listed in `cols`, in ascending order of table column
+  // `col`: read along `idx`, an index on that column, or else scanned and
+  // sorted.
+  Operator *ScanInOrder(Table *tbl, Index *idx, int col,
+                        std::vector<int> &cols);
+  // Plan a SELECT with aggregates or GROUP BY: the rows the WHERE
+  // conditions keep are grouped, streamed when read in index order of the
+  // only group column, hashed otherwise. The plan produces `items` in order.
+  Operator *PlanAggregate(Table *tbl, std::vector<SQLSelectItem> &items,
+                          SQLSelect &st);
+  // Store the fields of a record in slot `offset` of a block.
+  void WriteRecord(Table *tbl, BlockInfo *bp, int offset,
+                   std::vector<TKey> &values);
+  // The entries in every index of the table of the record in slot `offset`
+  // of `block_num`, in the order of the indexes.
+  std::vector<TKey> GetIndexKeys(Table *tbl, int block_num, int offset);
+  // Enter the record in slot `offset` of `block_num` in every index.
+  void AddToIndexes(Table *tbl, int block_num, int offset);
+  // Enter `key` in `idx`, an index of `tbl` of any method, for slot
+  // `offset` of `block_num`; remove it; or point it at that slot instead,
+  // for a unique index.
+  void AddToIndex(Table *tbl, Index *idx, TKey &key, int block_num,
+                  int offset);
+  void RemoveFromIndex(Table *tbl, Index *idx, TKey &key);
+  void MoveInIndex(Index *idx, TKey &key, int block_num, int offset);
+  // Widen the zone of `block_num` to the record in slot `offset`, or bound
+  // it anew by the records the block holds.
+  void AddToZone(Table *tbl, int block_num, int offset);
+  void ComputeZone(Table *tbl, int block_num);
+  // True if some record of the table has the primary key of `record`, the
+  // values of a whole record.
+  bool HasPrimaryKey(Table *tbl, std::vector<TKey> &record);
 
 public:
-  RecordManager(CatalogManager *cm, BufferManager *hdl, std::string db)
-      : cm_(cm), hdl_(hdl), db_name_(db) {}
+  RecordManager(CatalogManager *cm, BufferManager *hdl, std::string db,
+                SpillManager *spill = NULL)
+      : cm_(cm), hdl_(hdl), db_name_(db), spill_(spill), blocks_read_(0),
+        blocks_skipped_(0) {}
   ~RecordManager() {}
+
+  BufferManager *hdl() { return hdl_; }
+  CatalogManager *cm() { return cm_; }
+  std::string db_name() { return db_name_; }
+  SpillManager *spill() { return spill_; }
+
   void Insert(SQLInsert &st);
   void Select(SQLSelect &st);
   void Delete(SQLDelete &st);
   void Update(SQLUpdate &st);
   void Join(SQLJoin &st);
 
+  // Scan of the table columns listed in `cols`, spread over worker threads
+  // when the table is large enough. Without `keep_order` batches come out
+  // in whatever order the workers finish them.
+  Operator *ScanTable(Table *tbl, std::vector<SQLWhere> &wheres,
+                      std::vector<int> &cols, bool keep_order);
+
+  // The block directory of a table, rebuilt from the block chain for
+  // tables created before it existed.
+  std::vector<int> &GetBlocks(Table *tbl);
+  // Drop from `blocks`, blocks of the directory of `tbl`, those whose zone
+  // shows that none of their records satisfies `pred`. The zone map of a
+  // table from an old catalog is built first.
+  void SkipBlocks(Table *tbl, Predicate &pred, std::vector<int> &blocks);
+  // Count table blocks read by an operator; scan workers may call it.
+  void CountBlocksRead(long count) { blocks_read_ += count; }
   BlockInfo *GetBlockInfo(Table *tbl, int block_num);
+  TupleView GetTuple(Table *tbl, BlockInfo *bp, int offset);
   std::vector<TKey> GetRecord(Table *tbl, int block_num, int offset);
   void DeleteRecord(Table *tbl, int block_num, int offset);
   void UpdateRecord(Table *tbl, int block_num, int offset,
                     std::vector<int> &indices, std::vector<TKey> &values);
-
-  bool SatisfyWhere(Table *tbl, std::vector<TKey> keys, SQLWhere where);
 };
 
 #endif /* MINIDB_RECORD_MANAGER_H_ */
@@ -0,0 +1,138 @@
+#include "spill_manager.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+
+using namespace std;
+
+//=======================SpillFile=======================//
+
+SpillFile::SpillFile(std::string path, std::vector<Attribute> &schema)
+    : path_(path), row_width_(0), rows_(0), read_(0) {
+  for (unsigned int i = 0; i < schema.size(); ++i) {
+    widths_.push_back(schema[i].length());
+    row_width_ += schema[i].length();
+  }
+  file_.open(path_.c_str(), ios::in | ios::out | ios::binary | ios::trunc);
+  if (!file_) {
+    throw SpillFileException();
+  }
+}
+
+SpillFile::~SpillFile() {
+  file_.close();
+  remove(path_.c_str());
+}
+
+void SpillFile::Flush() {
+  if (!buf_.empty()) {
+    file_.write(&buf_[0], buf_.size());
+    buf_.clear();
+    if (!file_) {
+      throw SpillFileException();
+    }
+  }
+}
+
+void SpillFile::WriteRow(Batch &batch, int r) {
+  size_t pos = buf_.size();
+  buf_.resize(pos + row_width_);
+  for (unsigned int i = 0; i < widths_.size(); ++i) {
+    memcpy(&buf_[pos], batch.col(i).At(r), widths_[i]);
+    pos += widths_[i];
+  }
+  ++rows_;
+  if (buf_.size() >= 64 * 1024) {
+    Flush();
+  }
+}
+
+void SpillFile::Write(Batch &batch) {
+  for (int i = 0; i < batch.sel_count(); ++i) {
+    WriteRow(batch, batch.sel(i));
+  }
+}
+
+void SpillFile::Rewind() {
+  Flush();
+  file_.flush();
+  if (!file_) {
+    throw SpillFileException();
+  }
+  file_.clear();
+  file_.seekg(0);
+  if (!file_) {
+    throw SpillFileException();
+  }
+  read_ = 0;
+}
+
+bool SpillFile::Read(Batch &batch) {
+  batch.Reset();
+  int n = (int)min((long)BATCH_SIZE, rows_ - read_);
+  if (n <= 0) {
+    return false;
+  }
+  buf_.resize((size_t)n * row_width_);
+  file_.read(&buf_[0], buf_.size());
+  // A short read would hand back rows that were never written.
+  if (!file_ || file_.gcount() != (streamsize)buf_.size()) {
+    throw SpillFileException();
+  }
+  read_ += n;
+  for (int r = 0; r < n; ++r) {
+    batch.AddRow(-1);
+  }
+  int offset = 0;
+  for (unsigned int i = 0; i < widths_.size(); ++i) {
+    ColumnVector &col = batch.col(i);
+    for (int r = 0; r < n; ++r) {
+      memcpy(col.At(r), &buf_[r * row_width_ + offset], widths_[i]);
+    }
+    offset += widths_[i];
+  }
+  buf_.clear();
+  return true;
+}
+
+//=======================SpillManager=======================//
+
+SpillManager::~SpillManager() {
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(dir_, ec);
+}
+
+bool SpillManager::Reserve(size_t bytes) {
+  lock_guard<mutex> lock(mutex_);
+  if (used_ + bytes > budget_) {
+    return false;
+  }
+  used_ += bytes;
+  return true;
+}
+
+void SpillManager::Release(size_t bytes) {
+  lock_guard<mutex> lock(mutex_);
+  used_ -= min(bytes, used_);
+}
+
+SpillFile *SpillManager::CreateFile(std::vector<Attribute> &schema) {
+  int num;
+  {
+    lock_guard<mutex> lock(mutex_);
+    num = next_file_++;
+  }
+  try {
+    boost::filesystem::create_directories(dir_);
+  } catch (boost::filesystem::filesystem_error &e) {
+    throw SpillFileException();
+  }
+  ostringstream name;
+  name << dir_ << "spill_" << num << ".tmp";
+  return new SpillFile(name.str(), schema);
+}
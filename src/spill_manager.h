@@ -0,0 +1,84 @@
+#ifndef MINIDB_SPILL_MANAGER_H_
+#define MINIDB_SPILL_MANAGER_H_
+
+#include <stddef.h>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "catalog_manager.h"
+#include "executor.h"
+
+// Memory the operators of all running statements may hold before they
+// start writing rows to temporary files.
+#define SPILL_BUDGET (64 << 20)
+// Number of files a spilling operator splits its input into.
+#define SPILL_FANOUT 32
+
+// SpillFile: a temporary file of rows laid out for one schema. Rows are
+// appended, then read back in batches after Rewind. The file is removed
+// when the object is deleted. A file that cannot be opened, written or
+// read back whole raises SpillFileException.
+class SpillFile {
+private:
+  std::string path_;
+  std::vector<int> widths_; // Width of each column.
+  int row_width_;
+  std::fstream file_;
+  std::vector<char> buf_; // Rows waiting to be written.
+  long rows_;             // Rows appended.
+  long read_;             // Rows read back since Rewind.
+
+  void Flush();
+
+public:
+  SpillFile(std::string path, std::vector<Attribute> &schema);
+  ~SpillFile();
+
+  long rows() { return rows_; }
+  // Bytes the rows of the file take once read back into batches.
+  size_t GetMemorySize() {
+    return (size_t)((rows_ + BATCH_SIZE - 1) / BATCH_SIZE) * BATCH_SIZE *
+           row_width_;
+  }
+
+  // Append row `r` of a batch laid out for the schema of the file.
+  void WriteRow(Batch &batch, int r);
+  // Append every live row of a batch.
+  void Write(Batch &batch);
+  // Finish writing and read from the first row on.
+  void Rewind();
+  // Read the next rows into a batch laid out for the schema of the file.
+  // Returns false when every row has been read.
+  bool Read(Batch &batch);
+};
+
+// SpillManager: hands out temporary files and keeps the memory budget that
+// spilling operators share. An operator reserves memory before it buffers
+// more rows and, when the reservation fails, writes rows out instead.
+class SpillManager {
+private:
+  std::string dir_; // Directory of the temporary files.
+  size_t budget_;
+  size_t used_;
+  int next_file_;
+  std::mutex mutex_; // Guards used_ and next_file_.
+
+public:
+  SpillManager(std::string dir, size_t budget = SPILL_BUDGET)
+      : dir_(dir), budget_(budget), used_(0), next_file_(0) {}
+  ~SpillManager();
+
+  size_t budget() { return budget_; }
+
+  // Take `bytes` from the budget. Returns false, taking nothing, when that
+  // would exceed it.
+  bool Reserve(size_t bytes);
+  void Release(size_t bytes);
+
+  // A new empty file for rows of `schema`, owned by the caller.
+  SpillFile *CreateFile(std::vector<Attribute> &schema);
+};
+
+#endif /* MINIDB_SPILL_MANAGER_H_ */
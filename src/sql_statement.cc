@@ -16,26 +16,169 @@ std::ostream &operator<<(std::ostream &out, const TKey &object) {
   case 0: {
     int a;
     memcpy(&a, object.key_, object.length_);
-    cout << setw(9) << left << a;
+    out << setw(9) << left << a;
   } break;
   case 1: {
     float a;
     memcpy(&a, object.key_, object.length_);
-    cout << setw(9) << left << a;
+    out << setw(9) << left << a;
   } break;
   case 2: {
-    cout << setw(9) << left << object.key_;
+    // A value filling the whole field has no terminator.
+    out << setw(9) << left
+        << std::string(object.key_, strnlen(object.key_, object.length_));
+  } break;
+  case 3: {
+    for (int i = 0; i < object.length_; ++i) {
+      out << hex << setw(2) << setfill('0') << (int)(unsigned char)object.key_[i];
+    }
+    out << dec << setfill(' ') << ' ';
   } break;
   }
 
   return out;
 }
 
+namespace {
+
+// A row count written in a statement: digits only.
+long ParseCount(std::string &str) {
+  if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos) {
+    throw SyntaxErrorException();
+  }
+  return atol(str.c_str());
+}
+
+// Parse "LIMIT n [OFFSET m]", which must end the statement, from `pos` on.
+void ParseLimit(std::vector<std::string> &sql_vector, unsigned int pos,
+                long &limit, long &offset) {
+  if (sql_vector.size() != pos + 2 && sql_vector.size() != pos + 4) {
+    throw SyntaxErrorException();
+  }
+  if (to_lower_copy(sql_vector[pos]) != "limit") {
+    throw SyntaxErrorException();
+  }
+  limit = ParseCount(sql_vector[pos + 1]);
+  if (sql_vector.size() == pos + 4) {
+    if (to_lower_copy(sql_vector[pos + 2]) != "offset") {
+      throw SyntaxErrorException();
+    }
+    offset = ParseCount(sql_vector[pos + 3]);
+  }
+}
+
+// Strip the quotes around a value written in a statement.
+std::string Unquote(std::string value) {
+  if (value.at(0) == '\'' || value.at(0) == '\"') {
+    value.assign(value, 1, value.length() - 2);
+  }
+  return value;
+}
+
+// Parse the conditions of a WHERE clause from `pos` on, up to the end of the
+// statement or a LIMIT, GROUP BY or ORDER BY clause. "col BETWEEN a AND b"
+// gives the two conditions col >= a and col <= b.
+void ParseWheres(std::vector<std::string> &sql_vector, unsigned int &pos,
+                 std::vector<SQLWhere> &wheres) {
+  while (true) {
+    if (sql_vector.size() <= pos + 2) {
+      throw SyntaxErrorException();
+    }
+    SQLWhere where;
+
+    where.key = sql_vector[pos];
+    pos++;
+
+    if (to_lower_copy(sql_vector[pos]) == "between") {
+      if (sql_vector.size() <= pos + 3 ||
+          to_lower_copy(sql_vector[pos + 2]) != "and") {
+        throw SyntaxErrorException();
+      }
+      where.sign_type = SIGN_GE;
+      where.value = Unquote(sql_vector[pos + 1]);
+      wheres.push_back(where);
+      cout << where.key << " " << where.sign_type << " " << where.value << endl;
+      where.sign_type = SIGN_LE;
+      where.value = Unquote(sql_vector[pos + 3]);
+      pos += 4;
+    } else {
+      if (sql_vector[pos] == "=") {
+        where.sign_type = SIGN_EQ;
+      } else if (sql_vector[pos] == "<") {
+        where.sign_type = SIGN_LT;
+      } else if (sql_vector[pos] == ">") {
+        where.sign_type = SIGN_GT;
+      } else if (sql_vector[pos] == "<=") {
+        where.sign_type = SIGN_LE;
+      } else if (sql_vector[pos] == ">=") {
+        where.sign_type = SIGN_GE;
+      } else if (sql_vector[pos] == "<>") {
+        where.sign_type = SIGN_NE;
+      } else {
+        throw SyntaxErrorException();
+      }
+      pos++;
+
+      where.value = Unquote(sql_vector[pos]);
+      pos++;
+    }
+
+    wheres.push_back(where);
+    cout << where.key << " " << where.sign_type << " " << where.value << endl;
+
+    if (sql_vector.size() == pos || to_lower_copy(sql_vector[pos]) == "limit" ||
+        to_lower_copy(sql_vector[pos]) == "group" ||
+        to_lower_copy(sql_vector[pos]) == "order") {
+      break;
+    }
+
+    if (sql_vector[pos] != "and") {
+      throw SyntaxErrorException();
+    }
+    pos++;
+  }
+}
+
+// Parse one entry of a select list from `pos` on: a column name, or
+// "func ( col )" for COUNT, SUM, MIN, MAX or AVG. Only COUNT takes *.
+SQLSelectItem ParseSelectItem(std::vector<std::string> &sql_vector,
+                              unsigned int &pos) {
+  static const char *funcs[] = {"count", "sum", "min", "max", "avg"};
+  SQLSelectItem item;
+  item.func = -1;
+  if (sql_vector.size() > pos + 1 && sql_vector[pos + 1] == "(") {
+    std::string func = to_lower_copy(sql_vector[pos]);
+    for (int i = 0; i < 5; ++i) {
+      if (func == funcs[i]) {
+        item.func = i;
+      }
+    }
+    if (item.func == -1 || sql_vector.size() <= pos + 3 ||
+        sql_vector[pos + 3] != ")" ||
+        (sql_vector[pos + 2] == "*" && item.func != AGG_COUNT)) {
+      throw SyntaxErrorException();
+    }
+    item.col = sql_vector[pos + 2];
+    pos += 4;
+    return item;
+  }
+  if (sql_vector[pos] == "*" || sql_vector[pos] == "(" ||
+      sql_vector[pos] == ")") {
+    throw SyntaxErrorException();
+  }
+  item.col = sql_vector[pos];
+  pos++;
+  return item;
+}
+
+} // namespace
+
 bool TKey::operator<(const TKey t1) {
   switch (t1.key_type_) {
     case 0: return *(int *)key_ < *(int *)t1.key_;
     case 1: return *(float *)key_ < *(float *)t1.key_;
     case 2: return strncmp(key_, t1.key_, length_) < 0;
+    case 3: return memcmp(key_, t1.key_, length_) < 0;
     default: return false;
   }
 }
@@ -45,6 +188,7 @@ bool TKey::operator>(const TKey t1) {
     case 0: return *(int *)key_ > *(int *)t1.key_;
     case 1: return *(float *)key_ > *(float *)t1.key_;
     case 2: return strncmp(key_, t1.key_, length_) > 0;
+    case 3: return memcmp(key_, t1.key_, length_) > 0;
     default: return false;
   }
 }
@@ -62,6 +206,7 @@ bool TKey::operator==(const TKey t1) {
     case 0: return *(int *)key_ == *(int *)t1.key_;
     case 1: return *(float *)key_ == *(float *)t1.key_;
     case 2: return strncmp(key_, t1.key_, length_) == 0;
+    case 3: return memcmp(key_, t1.key_, length_) == 0;
     default: return false;
   }
 }
@@ -71,6 +216,7 @@ bool TKey::operator!=(const TKey t1) {
     case 0: return *(int *)key_ != *(int *)t1.key_;
     case 1: return *(float *)key_ != *(float *)t1.key_;
     case 2: return strncmp(key_, t1.key_, length_) != 0;
+    case 3: return memcmp(key_, t1.key_, length_) != 0;
     default: return false;
   }
 }
@@ -193,14 +339,20 @@ void SQLCreateTable::Parse(std::vector<std::string> sql_vector) {
       if (sql_vector[pos] != "(") {
         throw SyntaxErrorException();
       }
-      pos++;
-      for (unsigned int i = 0; i < attrs_.size(); ++i) {
-        if (attrs_[i].attr_name() == sql_vector[pos]) {
-          attrs_[i].set_attr_type(1); 
-          std::cout << "PRIMARY KEY: " << sql_vector[pos] << std::endl;
+      // The key may span several columns: ( col1 , col2 , ... ).
+      do {
+        pos++;
+        if (pos + 1 >= sql_vector.size()) {
+          throw SyntaxErrorException();
         }
-      }
-      pos++;
+        for (unsigned int i = 0; i < attrs_.size(); ++i) {
+          if (attrs_[i].attr_name() == sql_vector[pos]) {
+            attrs_[i].set_attr_type(1);
+            std::cout << "PRIMARY KEY: " << sql_vector[pos] << std::endl;
+          }
+        }
+        pos++;
+      } while (sql_vector[pos] == ",");
       if (sql_vector[pos] != ")") {
         throw SyntaxErrorException();
       }
@@ -220,6 +372,26 @@ void SQLCreateTable::Parse(std::vector<std::string> sql_vector) {
       }
     }
   }
+
+  // Optional storage clause after the column list:
+  // WITH ( layout = row | columnar )
+  while (pos < sql_vector.size() && to_lower_copy(sql_vector[pos]) != "with") {
+    pos++;
+  }
+  if (pos < sql_vector.size()) {
+    if (sql_vector.size() != pos + 6 || sql_vector[pos + 1] != "(" ||
+        to_lower_copy(sql_vector[pos + 2]) != "layout" ||
+        sql_vector[pos + 3] != "=" || sql_vector[pos + 5] != ")") {
+      throw SyntaxErrorException();
+    }
+    std::string layout = to_lower_copy(sql_vector[pos + 4]);
+    if (layout == "columnar") {
+      layout_ = LAYOUT_COLUMNAR;
+    } else if (layout != "row") {
+      throw SyntaxErrorException();
+    }
+    std::cout << "LAYOUT: " << layout << std::endl;
+  }
 }
 
 void SQLInsert::Parse(std::vector<std::string> sql_vector) {
@@ -283,17 +455,43 @@ void SQLExec::Parse(std::vector<std::string> sql_vector) {
 void SQLSelect::Parse(std::vector<std::string> sql_vector) {
   sql_type_ = 90; //SELECT
   unsigned int pos = 1;
+  limit_ = -1;
+  offset_ = 0;
+
+  // EXPLAIN SELECT ... runs the query as SELECT does, but reports what it
+  // read instead of the rows.
+  explain_ = sql_vector[0] == "explain";
+  if (explain_) {
+    if (sql_vector.size() <= pos ||
+        to_lower_copy(sql_vector[pos]) != "select") {
+      throw SyntaxErrorException();
+    }
+    sql_type_ = 91; //EXPLAIN
+    pos++;
+  }
 
   if (sql_vector.size() <= pos) {
     throw SyntaxErrorException();
   }
 
-  if (sql_vector[pos] != "*") {
-    throw SyntaxErrorException();
+  // Either * or a list of columns and aggregates separated by commas.
+  if (sql_vector[pos] == "*") {
+    pos++;
+  } else {
+    while (true) {
+      if (sql_vector.size() <= pos + 1 || sql_vector[pos] == "," ||
+          sql_vector[pos] == "from") {
+        throw SyntaxErrorException();
+      }
+      items_.push_back(ParseSelectItem(sql_vector, pos));
+      if (sql_vector.size() <= pos || sql_vector[pos] != ",") {
+        break;
+      }
+      pos++;
+    }
   }
-  pos++;
 
-  if (sql_vector[pos] != "from") {
+  if (sql_vector.size() <= pos + 1 || sql_vector[pos] != "from") {
     throw SyntaxErrorException();
   }
   pos++;
@@ -306,51 +504,60 @@ void SQLSelect::Parse(std::vector<std::string> sql_vector) {
     return;
   }
 
-  if (sql_vector[pos] != "where") {
-    throw SyntaxErrorException();
-  }
-  pos++;
-
-  while (true) {
-    SQLWhere where;
-
-    where.key = sql_vector[pos];
-    pos++;
-
-    if (sql_vector[pos] == "=") {
-      where.sign_type = SIGN_EQ;
-    } else if (sql_vector[pos] == "<") {
-      where.sign_type = SIGN_LT;
-    } else if (sql_vector[pos] == ">") {
-      where.sign_type = SIGN_GT;
-    } else if (sql_vector[pos] == "<=") {
-      where.sign_type = SIGN_LE;
-    } else if (sql_vector[pos] == ">=") {
-      where.sign_type = SIGN_GE;
-    } else if (sql_vector[pos] == "<>") {
-      where.sign_type = SIGN_NE;
-    }
-    pos++;
-
-    where.value = sql_vector[pos];
+  if (sql_vector[pos] == "where") {
     pos++;
+    ParseWheres(sql_vector, pos, wheres_);
+  }
 
-    if (where.value.at(0) == '\'' || where.value.at(0) == '\"') {
-      where.value.assign(where.value, 1, where.value.length() - 2);
+  if (sql_vector.size() > pos && to_lower_copy(sql_vector[pos]) == "group") {
+    if (sql_vector.size() <= pos + 2 ||
+        to_lower_copy(sql_vector[pos + 1]) != "by") {
+      throw SyntaxErrorException();
     }
-
-    wheres_.push_back(where);
-    cout << where.key << " " << where.sign_type << " " << where.value << endl;
-
-    if (sql_vector.size() == pos) {
-      break;
+    pos += 2;
+    while (true) {
+      if (sql_vector[pos] == "," || to_lower_copy(sql_vector[pos]) == "limit") {
+        throw SyntaxErrorException();
+      }
+      group_cols_.push_back(sql_vector[pos]);
+      pos++;
+      if (sql_vector.size() <= pos + 1 || sql_vector[pos] != ",") {
+        break;
+      }
+      pos++;
     }
+  }
 
-    if (sql_vector[pos] != "and") {
+  if (sql_vector.size() > pos && to_lower_copy(sql_vector[pos]) == "order") {
+    if (sql_vector.size() <= pos + 2 ||
+        to_lower_copy(sql_vector[pos + 1]) != "by") {
       throw SyntaxErrorException();
     }
-    pos++;
+    pos += 2;
+    while (true) {
+      if (sql_vector[pos] == "," || to_lower_copy(sql_vector[pos]) == "limit") {
+        throw SyntaxErrorException();
+      }
+      SQLOrderItem order;
+      order.item = ParseSelectItem(sql_vector, pos);
+      order.desc = false;
+      if (sql_vector.size() > pos && (to_lower_copy(sql_vector[pos]) == "asc" ||
+                                      to_lower_copy(sql_vector[pos]) == "desc")) {
+        order.desc = to_lower_copy(sql_vector[pos]) == "desc";
+        pos++;
+      }
+      order_.push_back(order);
+      if (sql_vector.size() <= pos + 1 || sql_vector[pos] != ",") {
+        break;
+      }
+      pos++;
+    }
   }
+
+  if (sql_vector.size() == pos) {
+    return;
+  }
+  ParseLimit(sql_vector, pos, limit_, offset_);
 }
 
 void SQLDropDatabase::Parse(std::vector<std::string> sql_vector) {
@@ -383,19 +590,67 @@ void SQLCreateIndex::Parse(std::vector<std::string> sql_vector) {
   tb_name_ = sql_vector[pos];
   pos++;
 
-  if (to_lower_copy(sql_vector[pos]) != "(") {
+  if (sql_vector.size() <= pos || sql_vector[pos] != "(") {
     throw SyntaxErrorException();
   }
-  pos++;
 
-  std::cout << "COLUMN NAME: " << sql_vector[pos] << std::endl;
-  col_name_ = sql_vector[pos];
-  pos++;
+  // One column, or several separated by commas.
+  do {
+    pos++;
+    if (sql_vector.size() <= pos + 1) {
+      throw SyntaxErrorException();
+    }
+    std::cout << "COLUMN NAME: " << sql_vector[pos] << std::endl;
+    col_names_.push_back(sql_vector[pos]);
+    pos++;
+  } while (sql_vector[pos] == ",");
 
-  if (to_lower_copy(sql_vector[pos]) != ")") {
+  if (sql_vector[pos] != ")") {
     throw SyntaxErrorException();
   }
   pos++;
+
+  // Then INCLUDE (columns) and USING BTREE, the default, HASH or BITMAP, in
+  // either order.
+  method_ = INDEX_BTREE;
+  bool has_method = false;
+  while (sql_vector.size() > pos) {
+    std::string word = to_lower_copy(sql_vector[pos]);
+    if (word == "include" && include_names_.empty()) {
+      pos++;
+      if (sql_vector.size() <= pos || sql_vector[pos] != "(") {
+        throw SyntaxErrorException();
+      }
+      do {
+        pos++;
+        if (sql_vector.size() <= pos + 1) {
+          throw SyntaxErrorException();
+        }
+        std::cout << "INCLUDE COLUMN: " << sql_vector[pos] << std::endl;
+        include_names_.push_back(sql_vector[pos]);
+        pos++;
+      } while (sql_vector[pos] == ",");
+      if (sql_vector[pos] != ")") {
+        throw SyntaxErrorException();
+      }
+      pos++;
+    } else if (word == "using" && !has_method &&
+               sql_vector.size() > pos + 1) {
+      std::string method = to_lower_copy(sql_vector[pos + 1]);
+      if (method == "hash") {
+        method_ = INDEX_HASH;
+      } else if (method == "bitmap") {
+        method_ = INDEX_BITMAP;
+      } else if (method != "btree") {
+        throw SyntaxErrorException();
+      }
+      std::cout << "METHOD: " << method << std::endl;
+      has_method = true;
+      pos += 2;
+    } else {
+      throw SyntaxErrorException();
+    }
+  }
 }
 
 void SQLDelete::Parse(std::vector<std::string> sql_vector) {
@@ -424,45 +679,9 @@ void SQLDelete::Parse(std::vector<std::string> sql_vector) {
   }
   pos++;
 
-  while (true) {
-    SQLWhere where;
-
-    where.key = sql_vector[pos];
-    pos++;
-
-    if (sql_vector[pos] == "=") {
-      where.sign_type = SIGN_EQ;
-    } else if (sql_vector[pos] == "<") {
-      where.sign_type = SIGN_LT;
-    } else if (sql_vector[pos] == ">") {
-      where.sign_type = SIGN_GT;
-    } else if (sql_vector[pos] == "<=") {
-      where.sign_type = SIGN_LE;
-    } else if (sql_vector[pos] == ">=") {
-      where.sign_type = SIGN_GE;
-    } else if (sql_vector[pos] == "<>") {
-      where.sign_type = SIGN_NE;
-    }
-    pos++;
-
-    where.value = sql_vector[pos];
-    pos++;
-
-    if (where.value.at(0) == '\'' || where.value.at(0) == '\"') {
-      where.value.assign(where.value, 1, where.value.length() - 2);
-    }
-
-    wheres_.push_back(where);
-    cout << where.key << " " << where.sign_type << " " << where.value << endl;
-
-    if (sql_vector.size() == pos) {
-      break;
-    }
-
-    if (sql_vector[pos] != "and") {
-      throw SyntaxErrorException();
-    }
-    pos++;
+  ParseWheres(sql_vector, pos, wheres_);
+  if (sql_vector.size() != pos) {
+    throw SyntaxErrorException();
   }
 }
 
@@ -521,54 +740,20 @@ void SQLUpdate::Parse(std::vector<std::string> sql_vector) {
   }
   pos++;
 
-  while (true) {
-    SQLWhere where;
-
-    where.key = sql_vector[pos];
-    pos++;
-
-    if (sql_vector[pos] == "=") {
-      where.sign_type = SIGN_EQ;
-    } else if (sql_vector[pos] == "<") {
-      where.sign_type = SIGN_LT;
-    } else if (sql_vector[pos] == ">") {
-      where.sign_type = SIGN_GT;
-    } else if (sql_vector[pos] == "<=") {
-      where.sign_type = SIGN_LE;
-    } else if (sql_vector[pos] == ">=") {
-      where.sign_type = SIGN_GE;
-    } else if (sql_vector[pos] == "<>") {
-      where.sign_type = SIGN_NE;
-    }
-    pos++;
-
-    where.value = sql_vector[pos];
-    pos++;
-
-    if (where.value.at(0) == '\'' || where.value.at(0) == '\"') {
-      where.value.assign(where.value, 1, where.value.length() - 2);
-    }
-
-    wheres_.push_back(where);
-    cout << where.key << " " << where.sign_type << " " << where.value << endl;
-
-    if (sql_vector.size() == pos) {
-      break;
-    }
-
-    if (sql_vector[pos] != "and") {
-      throw SyntaxErrorException();
-    }
-    pos++;
+  ParseWheres(sql_vector, pos, wheres_);
+  if (sql_vector.size() != pos) {
+    throw SyntaxErrorException();
   }
 }
 
 void SQLJoin::Parse(std::vector<std::string> sql_vector) {
   sql_type_ = 120;
   unsigned int pos = 1;
-  // SYNTAX : JOIN t1 AND t2 ON t1-att = t2-att
-  //Size = 8
-  if (sql_vector.size() != 8) {
+  limit_ = -1;
+  offset_ = 0;
+  // SYNTAX : JOIN t1 AND t2 ON t1-att = t2-att [LIMIT n [OFFSET m]]
+  //Size = 8, plus the limit
+  if (sql_vector.size() < 8) {
     throw SyntaxErrorException();
   }
   tb_name1_ = sql_vector[pos];
@@ -590,4 +775,8 @@ void SQLJoin::Parse(std::vector<std::string> sql_vector) {
   }
   pos++;
   col_name2_ = sql_vector[pos];
+  pos++;
+  if (sql_vector.size() > pos) {
+    ParseLimit(sql_vector, pos, limit_, offset_);
+  }
 }
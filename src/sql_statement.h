@@ -1,10 +1,12 @@
 #ifndef MINIDB_SQL_STATEMENT_H_
 #define MINIDB_SQL_STATEMENT_H_
 
+#include <cstring>
 #include <string>
 #include <vector>
 
 #include "catalog_manager.h"
+#include "commons.h"
 //Declarations for classes simplify dependencies by informing the compiler of their existence without including full definitions
 //This can make code more readable and save time while calling them
 class CatalogManager;
@@ -41,7 +43,7 @@ public:
 // parameterized constructor
   TKey(int keytype, int length) {
     key_type_ = keytype;
-    if (keytype == 2)
+    if (keytype == T_CHAR || keytype == T_BYTES)
       length_ = length;
     else
       length_ = 4;
@@ -56,6 +58,19 @@ public:
     memcpy(key_, t1.key_, length_);
   }
 
+// Copy Assignment, keeps each TKey owning its own buffer
+  TKey &operator=(const TKey &t1) {
+    if (this != &t1) {
+      char *key = new char[t1.length_];
+      memcpy(key, t1.key_, t1.length_);
+      delete[] key_;
+      key_ = key;
+      key_type_ = t1.key_type_;
+      length_ = t1.length_;
+    }
+    return *this;
+  }
+
 /* Reads a value from a char* (C-style string) and stores it in key_
     atoi() is for char* to int . */
   void ReadValue(const char *content) {
@@ -69,7 +84,8 @@ public:
       memcpy(key_, &a, length_);
     } break;
     case 2: {
-      memcpy(key_, content, length_);
+      // Copy up to the terminator and zero the rest of the field.
+      strncpy(key_, content, length_);
     } break;
     }
   }
@@ -86,7 +102,7 @@ public:
       memcpy(key_, &a, length_);
     } break;
     case 2: {
-      memcpy(key_, str.c_str(), length_);
+      strncpy(key_, str.c_str(), length_);
     } break;
     }
   }
@@ -197,13 +213,17 @@ class SQLCreateTable : public SQL {
 private:
   std::string tb_name_;
   std::vector<Attribute> attrs_;
+  int layout_;
 
 public:
-  SQLCreateTable(std::vector<std::string> sql_vector) { Parse(sql_vector); }
+  SQLCreateTable(std::vector<std::string> sql_vector) : layout_(LAYOUT_ROW) {
+    Parse(sql_vector);
+  }
   std::string tb_name() { return tb_name_; }
   void set_tb_name(std::string tbname) { tb_name_ = tbname; }
   std::vector<Attribute> attrs() { return attrs_; };
   void set_attrs(std::vector<Attribute> att) { attrs_ = att; }
+  int layout() { return layout_; }
   void Parse(std::vector<std::string> sql_vector);
 };
 
@@ -240,30 +260,58 @@ typedef struct {
   std::string value;
 } SQLWhere;
 
+// One entry of a select list: a column, or an aggregate function over one.
+typedef struct {
+  int func;        // AGG_* of an aggregate, or -1 for a plain column.
+  std::string col; // "*" for COUNT(*).
+} SQLSelectItem;
+
+// One key of an ORDER BY clause.
+typedef struct {
+  SQLSelectItem item; // Column or aggregate to order by.
+  bool desc;          // DESC rather than ASC.
+} SQLOrderItem;
+
 class SQLSelect : public SQL {
 private:
   std::string tb_name_;
+  std::vector<SQLSelectItem> items_; // What to return, empty for all.
   std::vector<SQLWhere> wheres_;
+  std::vector<std::string> group_cols_; // GROUP BY columns.
+  std::vector<SQLOrderItem> order_;      // ORDER BY keys.
+  long limit_;  // Most rows to return, -1 for all.
+  long offset_; // Rows to skip first.
+  bool explain_; // EXPLAIN SELECT: report what the query read, not rows.
 
 public:
   SQLSelect(std::vector<std::string> sql_vector) { Parse(sql_vector); }
   void Parse(std::vector<std::string> sql_vector);
   std::string tb_name() { return tb_name_; }
+  std::vector<SQLSelectItem> &items() { return items_; }
   std::vector<SQLWhere> &wheres() { return wheres_; }
+  std::vector<std::string> &group_cols() { return group_cols_; }
+  std::vector<SQLOrderItem> &order() { return order_; }
+  long limit() { return limit_; }
+  long offset() { return offset_; }
+  bool explain() { return explain_; }
 };
 
 class SQLCreateIndex : public SQL {
 private:
   std::string index_name_;
   std::string tb_name_;
-  std::string col_name_;
+  std::vector<std::string> col_names_; // Key columns, most significant first.
+  std::vector<std::string> include_names_; // Columns carried by the entries.
+  int method_; // INDEX_BTREE, INDEX_HASH or INDEX_BITMAP.
 
 public:
   SQLCreateIndex(std::vector<std::string> sql_vector) { Parse(sql_vector); }
   void Parse(std::vector<std::string> sql_vector);
   std::string index_name() { return index_name_; }
   std::string tb_name() { return tb_name_; }
-  std::string col_name() { return col_name_; }
+  std::vector<std::string> &col_names() { return col_names_; }
+  std::vector<std::string> &include_names() { return include_names_; }
+  int method() { return method_; }
 };
 
 class SQLDelete : public SQL {
@@ -303,6 +351,8 @@ private:
   std::string tb_name2_;
   std::string col_name1_;
   std::string col_name2_;
+  long limit_;  // Most rows to return, -1 for all.
+  long offset_; // Rows to skip first.
 public:
   SQLJoin(std::vector<std::string> sql_vector) { Parse(sql_vector); }
   void Parse(std::vector<std::string> sql_vector);
@@ -310,6 +360,8 @@ public:
   std::string tb_name2() { return tb_name2_; }
   std::string col_name1() { return col_name1_; }
   std::string col_name2() { return col_name2_; }
+  long limit() { return limit_; }
+  long offset() { return offset_; }
 };
 
 #endif
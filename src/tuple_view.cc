@@ -0,0 +1,37 @@
+#include "tuple_view.h"
+
+using namespace std;
+
+int TupleView::Compare(int i, TKey &key) {
+  switch (tbl_->ats()[i].data_type()) {
+  case T_INT: {
+    int a = GetInt(i);
+    int b = *(int *)key.key();
+    return a < b ? -1 : (a > b ? 1 : 0);
+  }
+  case T_FLOAT: {
+    float a = GetFloat(i);
+    float b = *(float *)key.key();
+    return a < b ? -1 : (a > b ? 1 : 0);
+  }
+  case T_CHAR:
+    return strncmp(GetField(i), key.key(), key.length());
+  default:
+    return 0;
+  }
+}
+
+TKey TupleView::GetKey(int i) {
+  TKey tmp(tbl_->ats()[i].data_type(), tbl_->ats()[i].length());
+  memcpy(tmp.key(), GetField(i), tmp.length());
+  return tmp;
+}
+
+vector<TKey> TupleView::Materialize() {
+  vector<TKey> keys;
+  keys.reserve(tbl_->GetAttributeNum());
+  for (unsigned int i = 0; i < tbl_->GetAttributeNum(); ++i) {
+    keys.push_back(GetKey(i));
+  }
+  return keys;
+}
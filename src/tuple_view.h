@@ -0,0 +1,53 @@
+#ifndef MINIDB_TUPLE_VIEW_H_
+#define MINIDB_TUPLE_VIEW_H_
+
+#include <cstring>
+#include <vector>
+
+#include "catalog_manager.h"
+#include "commons.h"
+#include "sql_statement.h"
+
+// TupleView: a non-owning view over one record stored in a block.
+// Fields are read in place through the field addressing of the table, which
+// covers both the row and the columnar page layout, so scanning a block does
+// not allocate. A view is only valid while the block it points into stays in
+// the buffer.
+class TupleView {
+private:
+  Table *tbl_;          // Table describing the record layout.
+  const char *content_; // Content area of the block holding the record.
+  int row_;             // Position of the record in the block.
+
+public:
+  TupleView(Table *tbl, const char *content, int row)
+      : tbl_(tbl), content_(content), row_(row) {}
+
+  // Address of the i-th field of the record.
+  const char *GetField(int i) {
+    return content_ + tbl_->GetFieldBase(i) + row_ * tbl_->GetFieldStride(i);
+  }
+
+  int GetInt(int i) {
+    int a;
+    memcpy(&a, GetField(i), 4);
+    return a;
+  }
+
+  float GetFloat(int i) {
+    float a;
+    memcpy(&a, GetField(i), 4);
+    return a;
+  }
+
+  // Compare the i-th field with a key of the same type.
+  // Returns <0, 0 or >0 like strncmp.
+  int Compare(int i, TKey &key);
+
+  // Copy the i-th field out of the page.
+  TKey GetKey(int i);
+  // Copy every field out of the page, used when a row is emitted.
+  std::vector<TKey> Materialize();
+};
+
+#endif /* MINIDB_TUPLE_VIEW_H_ */
@@ -0,0 +1,112 @@
+#include "zone_map.h"
+
+#include <cstring>
+
+#include "index_manager.h"
+
+using namespace std;
+
+namespace {
+
+// True if a value up to `high` may be at `bound` or above it, or with
+// `strict`, above it; both normalized.
+bool MayReachUp(const char *high, const char *bound, int width, bool strict) {
+  int c = memcmp(high, bound, width);
+  return c > 0 || (c == 0 && !strict);
+}
+
+// True if a value from `low` on may be at `bound` or below it, or with
+// `strict`, below it.
+bool MayReachDown(const char *low, const char *bound, int width,
+                  bool strict) {
+  int c = memcmp(low, bound, width);
+  return c < 0 || (c == 0 && !strict);
+}
+
+} // namespace
+
+void WidenZone(Table *tbl, char *zone, TupleView &record) {
+  char value[ZONE_PREFIX_LEN];
+  for (unsigned int i = 0; i < tbl->GetAttributeNum(); ++i) {
+    int width = tbl->GetZoneWidth(i);
+    char *low = zone + tbl->GetZoneOffset(i);
+    char *high = low + width;
+    NormalizeKey(tbl->ats()[i].data_type(), record.GetField(i), width, value);
+    if (memcmp(value, low, width) < 0) {
+      memcpy(low, value, width);
+    }
+    if (memcmp(value, high, width) > 0) {
+      memcpy(high, value, width);
+    }
+  }
+}
+
+bool ZoneMayMatch(Table *tbl, const char *zone, Predicate &pred) {
+  char bound[ZONE_PREFIX_LEN];
+  vector<PredicateTerm> &terms = pred.terms();
+  for (unsigned int i = 0; i < terms.size(); ++i) {
+    PredicateTerm &t = terms[i];
+    int width = tbl->GetZoneWidth(t.attr);
+    const char *low = zone + tbl->GetZoneOffset(t.attr);
+    const char *high = low + width;
+    if (memcmp(low, high, width) > 0) {
+      return false; // The block holds no record.
+    }
+
+    if (t.is_range) {
+      const char *lo = t.data_type == T_INT ? (const char *)&t.ilo
+                                            : (const char *)&t.flo;
+      const char *hi = t.data_type == T_INT ? (const char *)&t.ihi
+                                            : (const char *)&t.fhi;
+      bool lo_strict = t.data_type == T_FLOAT && t.lo_strict;
+      bool hi_strict = t.data_type == T_FLOAT && t.hi_strict;
+      NormalizeKey(t.data_type, lo, width, bound);
+      if (!MayReachUp(high, bound, width, lo_strict)) {
+        return false;
+      }
+      NormalizeKey(t.data_type, hi, width, bound);
+      if (!MayReachDown(low, bound, width, hi_strict)) {
+        return false;
+      }
+      continue;
+    }
+
+    const char *value;
+    switch (t.data_type) {
+    case T_INT: value = (const char *)&t.ival; break;
+    case T_FLOAT: value = (const char *)&t.fval; break;
+    default: value = &t.cval[0]; break;
+    }
+    NormalizeKey(t.data_type, value, width, bound);
+    // Values sharing the prefix kept may lie on either side of the value.
+    bool exact = t.data_type != T_CHAR || t.length <= width;
+    switch (t.sign_type) {
+    case SIGN_EQ:
+      if (!MayReachUp(high, bound, width, false) ||
+          !MayReachDown(low, bound, width, false)) {
+        return false;
+      }
+      break;
+    case SIGN_NE:
+      if (exact && memcmp(low, bound, width) == 0 &&
+          memcmp(high, bound, width) == 0) {
+        return false;
+      }
+      break;
+    case SIGN_LT:
+    case SIGN_LE:
+      if (!MayReachDown(low, bound, width,
+                        exact && t.sign_type == SIGN_LT)) {
+        return false;
+      }
+      break;
+    case SIGN_GT:
+    case SIGN_GE:
+      if (!MayReachUp(high, bound, width, exact && t.sign_type == SIGN_GT)) {
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,21 @@
+#ifndef MINIDB_ZONE_MAP_H_
+#define MINIDB_ZONE_MAP_H_
+
+#include "catalog_manager.h"
+#include "predicate.h"
+#include "tuple_view.h"
+
+// Zone maps: the bounds a table keeps of the values of every attribute in
+// each of its blocks, laid out as described in Table. A scan compares them
+// with its conditions and passes over the blocks none of whose records can
+// qualify, without reading them.
+
+// Widen `zone`, the zone of the block holding `record`, to take it in.
+void WidenZone(Table *tbl, char *zone, TupleView &record);
+
+// False if no record whose values lie within the bounds of `zone` can
+// satisfy every term of `pred`, compiled against the attributes of `tbl`.
+// A string cut in the bounds only rules a block out when its prefix does.
+bool ZoneMayMatch(Table *tbl, const char *zone, Predicate &pred);
+
+#endif /* MINIDB_ZONE_MAP_H_ */
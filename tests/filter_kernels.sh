@@ -0,0 +1,18 @@
+#!/bin/sh
+# Unit test: builds tests/filter_kernels_test.cc against the filter kernels
+# and runs it, checking every set the CPU supports against plain
+# row-at-a-time comparisons and that the best one is picked at run time.
+#
+# Usage: tests/filter_kernels.sh [c++ compiler]
+
+CXX=${1:-${CXX:-g++}}
+DIR=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if ! "$CXX" -std=c++11 -O2 -I "$DIR/src" -o "$WORK/filter_kernels_test" \
+    "$DIR/tests/filter_kernels_test.cc" "$DIR/src/filter_kernels.cc"; then
+  echo "FAIL: could not build the test"
+  exit 1
+fi
+"$WORK/filter_kernels_test"
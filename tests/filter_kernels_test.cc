@@ -0,0 +1,288 @@
+// Differential test of the filter kernels: every set the CPU supports, the
+// SIMD ones and the scalar one, must clear exactly the rows that a plain
+// row-at-a-time comparison rejects, for every comparison, type, stride and
+// row count, including counts that leave a partial vector at the end.
+// Built and run by tests/filter_kernels.sh.
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "commons.h"
+#include "filter_kernels.h"
+
+using namespace std;
+
+namespace {
+
+const int kMaxRows = 300;
+const char *kSignNames[] = {"=", "<>", "<", ">", "<=", ">="};
+
+mt19937 rng(2024);
+long failures = 0;
+
+template <typename T> bool Compare(T a, int sign, T b) {
+  switch (sign) {
+  case SIGN_EQ: return a == b;
+  case SIGN_NE: return a != b;
+  case SIGN_LT: return a < b;
+  case SIGN_GT: return a > b;
+  case SIGN_LE: return a <= b;
+  case SIGN_GE: return a >= b;
+  }
+  return false;
+}
+
+// Rows laid out `stride` bytes apart, one byte past an aligned address so
+// that no kernel can count on aligned loads.
+struct Block {
+  vector<char> data;
+  int stride;
+  int count;
+
+  Block(int s, int c) : data(s * c + 1), stride(s), count(c) {
+    for (unsigned int i = 0; i < data.size(); ++i) {
+      data[i] = (char)rng();
+    }
+  }
+  char *row(int r) { return data.data() + 1 + r * stride; }
+};
+
+// A random starting mask: kernels must leave cleared bits alone, and must
+// not set any bit past `count`.
+vector<uint64_t> RandomMask(int count) {
+  vector<uint64_t> mask((count + 63) / 64 + 1);
+  for (unsigned int i = 0; i < mask.size(); ++i) {
+    mask[i] = ((uint64_t)rng() << 32) | rng();
+  }
+  return mask;
+}
+
+// Compare the mask a kernel left with the expected pass flags of each row.
+void Check(const vector<uint64_t> &before, const vector<uint64_t> &after,
+           const vector<bool> &pass, const FilterKernels &k,
+           const string &what) {
+  int count = pass.size();
+  for (int r = 0; r < (int)after.size() * 64; ++r) {
+    bool was = (before[r >> 6] >> (r & 63)) & 1;
+    bool is = (after[r >> 6] >> (r & 63)) & 1;
+    bool want = r < count ? was && pass[r] : was;
+    if (is != want) {
+      if (failures++ < 20) {
+        printf("%s: %s, %d rows: row %d is %d, expected %d\n", k.name,
+               what.c_str(), count, r, is, want);
+      }
+      return;
+    }
+  }
+}
+
+int RandomInt() {
+  static const int edges[] = {numeric_limits<int>::min(),
+                              numeric_limits<int>::min() + 1, -1, 0, 1,
+                              numeric_limits<int>::max() - 1,
+                              numeric_limits<int>::max()};
+  if (rng() % 8 == 0) {
+    return edges[rng() % 7];
+  }
+  return (int)(rng() % 41) - 20;
+}
+
+float RandomFloat() {
+  static const float edges[] = {-numeric_limits<float>::infinity(),
+                                -numeric_limits<float>::max(), -0.0f, 0.0f,
+                                numeric_limits<float>::min(),
+                                numeric_limits<float>::max(),
+                                numeric_limits<float>::infinity()};
+  if (rng() % 8 == 0) {
+    return edges[rng() % 7];
+  }
+  return ((int)(rng() % 41) - 20) * 0.5f;
+}
+
+// A string over a small alphabet, high bytes included, so that prefixes and
+// equal values are common; the bytes after its end are left as garbage, as
+// in a record. `buf` holds `length` bytes.
+void RandomString(char *buf, int length) {
+  static const char alphabet[] = {'a', 'b', 'z', '\x7f', '\x80', '\xff'};
+  int n = rng() % (length + 1);
+  for (int i = 0; i < n; ++i) {
+    buf[i] = alphabet[rng() % 6];
+  }
+  if (n < length) {
+    buf[n] = 0;
+  }
+}
+
+void TestIntCmp(const FilterKernels &k, int stride, int count) {
+  Block b(stride, count);
+  for (int r = 0; r < count; ++r) {
+    int a = RandomInt();
+    memcpy(b.row(r), &a, 4);
+  }
+  for (int sign = SIGN_EQ; sign <= SIGN_GE; ++sign) {
+    int value = RandomInt();
+    vector<bool> pass(count);
+    for (int r = 0; r < count; ++r) {
+      int a;
+      memcpy(&a, b.row(r), 4);
+      pass[r] = Compare(a, sign, value);
+    }
+    vector<uint64_t> before = RandomMask(count), after = before;
+    k.int_cmp(b.row(0), stride, count, sign, value, &after[0]);
+    Check(before, after, pass, k,
+          "int " + string(kSignNames[sign]) + " " + to_string(value) +
+              ", stride " + to_string(stride));
+  }
+}
+
+void TestIntRange(const FilterKernels &k, int stride, int count) {
+  Block b(stride, count);
+  for (int r = 0; r < count; ++r) {
+    int a = RandomInt();
+    memcpy(b.row(r), &a, 4);
+  }
+  int lo = RandomInt(), hi = RandomInt();
+  vector<bool> pass(count);
+  for (int r = 0; r < count; ++r) {
+    int a;
+    memcpy(&a, b.row(r), 4);
+    pass[r] = lo <= a && a <= hi;
+  }
+  vector<uint64_t> before = RandomMask(count), after = before;
+  k.int_range(b.row(0), stride, count, lo, hi, &after[0]);
+  Check(before, after, pass, k,
+        "int in [" + to_string(lo) + ", " + to_string(hi) + "], stride " +
+            to_string(stride));
+}
+
+void TestFloatCmp(const FilterKernels &k, int stride, int count) {
+  Block b(stride, count);
+  for (int r = 0; r < count; ++r) {
+    float a = RandomFloat();
+    memcpy(b.row(r), &a, 4);
+  }
+  for (int sign = SIGN_EQ; sign <= SIGN_GE; ++sign) {
+    float value = RandomFloat();
+    vector<bool> pass(count);
+    for (int r = 0; r < count; ++r) {
+      float a;
+      memcpy(&a, b.row(r), 4);
+      pass[r] = Compare(a, sign, value);
+    }
+    vector<uint64_t> before = RandomMask(count), after = before;
+    k.float_cmp(b.row(0), stride, count, sign, value, &after[0]);
+    Check(before, after, pass, k,
+          "float " + string(kSignNames[sign]) + " " + to_string(value) +
+              ", stride " + to_string(stride));
+  }
+}
+
+void TestFloatRange(const FilterKernels &k, int stride, int count) {
+  Block b(stride, count);
+  for (int r = 0; r < count; ++r) {
+    float a = RandomFloat();
+    memcpy(b.row(r), &a, 4);
+  }
+  for (int strict = 0; strict < 4; ++strict) {
+    float lo = RandomFloat(), hi = RandomFloat();
+    bool lo_strict = strict & 1, hi_strict = strict & 2;
+    vector<bool> pass(count);
+    for (int r = 0; r < count; ++r) {
+      float a;
+      memcpy(&a, b.row(r), 4);
+      pass[r] = (lo_strict ? a > lo : a >= lo) &&
+                (hi_strict ? a < hi : a <= hi);
+    }
+    vector<uint64_t> before = RandomMask(count), after = before;
+    k.float_range(b.row(0), stride, count, lo, lo_strict, hi, hi_strict,
+                  &after[0]);
+    Check(before, after, pass, k,
+          "float in " + string(lo_strict ? "(" : "[") + to_string(lo) + ", " +
+              to_string(hi) + (hi_strict ? ")" : "]") + ", stride " +
+              to_string(stride));
+  }
+}
+
+void TestCharCmp(const FilterKernels &k, int length, int stride, int count) {
+  Block b(stride, count);
+  for (int r = 0; r < count; ++r) {
+    RandomString(b.row(r), length);
+  }
+  for (int sign = SIGN_EQ; sign <= SIGN_GE; ++sign) {
+    // The constant of a term is zero padded to the field length.
+    vector<char> value(length, 0);
+    RandomString(&value[0], length);
+    if (rng() % 4 == 0 && count > 0) {
+      memcpy(&value[0], b.row(rng() % count), length);
+    }
+    vector<bool> pass(count);
+    for (int r = 0; r < count; ++r) {
+      pass[r] = Compare(strncmp(b.row(r), &value[0], length), sign, 0);
+    }
+    vector<uint64_t> before = RandomMask(count), after = before;
+    k.char_cmp(b.row(0), stride, length, count, sign, &value[0], &after[0]);
+    Check(before, after, pass, k,
+          "char(" + to_string(length) + ") " + kSignNames[sign] +
+              ", stride " + to_string(stride));
+  }
+}
+
+void TestKernels(const FilterKernels &k) {
+  // Packed columns and columns inside records of a few lengths.
+  const int strides[] = {4, 8, 12, 36};
+  const int lengths[] = {1, 3, 8, 15, 16, 17, 20};
+  for (int count = 0; count <= kMaxRows; ++count) {
+    for (int s = 0; s < 4; ++s) {
+      TestIntCmp(k, strides[s], count);
+      TestIntRange(k, strides[s], count);
+      TestFloatCmp(k, strides[s], count);
+      TestFloatRange(k, strides[s], count);
+    }
+    for (int l = 0; l < 7; ++l) {
+      TestCharCmp(k, lengths[l], lengths[l], count);
+      TestCharCmp(k, lengths[l], lengths[l] + 9, count);
+    }
+  }
+}
+
+// GetFilterKernels must pick the best set the CPU supports.
+void TestDispatch(const vector<const FilterKernels *> &supported) {
+  string want = "scalar";
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    want = "avx2";
+  } else if (__builtin_cpu_supports("sse4.2")) {
+    want = "sse4.2";
+  }
+#endif
+  if (&GetFilterKernels() != supported.front() ||
+      GetFilterKernels().name != want ||
+      supported.back() != &GetScalarFilterKernels()) {
+    printf("dispatch picked %s, expected %s\n", GetFilterKernels().name,
+           want.c_str());
+    ++failures;
+  }
+}
+
+} // namespace
+
+int main() {
+  vector<const FilterKernels *> supported = GetSupportedFilterKernels();
+  TestDispatch(supported);
+  string names;
+  for (unsigned int i = 0; i < supported.size(); ++i) {
+    TestKernels(*supported[i]);
+    names += string(i > 0 ? ", " : "") + supported[i]->name;
+  }
+  if (failures > 0) {
+    printf("FAIL: %ld mismatches\n", failures);
+    return 1;
+  }
+  printf("PASS: %s\n", names.c_str());
+  return 0;
+}
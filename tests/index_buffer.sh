@@ -0,0 +1,73 @@
+#!/bin/sh
+# Regression test: updates and deletes over a composite B+ tree index on a
+# wide string column, grown to several levels and to more blocks than the
+# buffer holds, must leave it with an entry for every record, in order.
+#
+# Usage: tests/index_buffer.sh path/to/minidb
+
+MINIDB=${1:?usage: $0 path/to/minidb}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+awk 'BEGIN {
+  n = 8000;
+  print "create database d;";
+  print "use d;";
+  print "create table t (a int, b int, c char(100), d float, primary key (a));";
+  print "create index ibc on t (b, c);";
+  for (a = 0; a < n; a++) {
+    printf "insert into t values (%d, %d, '\''k%d'\'', %d.5);\n",
+           a, (a * 37) % 50, (a * 101) % 400, a;
+  }
+  for (i = 0; i < 300; i++) {
+    lo = (i * 7919) % n;
+    if (i % 3 == 0) {
+      printf "update t set c = '\''u%d'\'' where a > %d and a < %d;\n",
+             i, lo, lo + 15;
+    } else if (i % 3 == 1) {
+      printf "delete from t where a > %d and a < %d;\n", lo, lo + 8;
+    } else {
+      printf "update t set b = %d where a > %d and a < %d;\n",
+             i % 50, lo, lo + 10;
+    }
+  }
+  printf "update t set c = '\''k5'\'' where a > %d;\n", n * 6 / 10;
+  printf "delete from t where a > %d;\n", n * 9 / 10;
+  print "select count(*) from t;";
+  print "select count(*) from t where b >= 0;";
+  print "select b, c from t order by b, c;";
+}' > "$WORK/in.sql"
+
+# A corrupted tree may send a walk along its leaves around in circles.
+LIMIT=
+if command -v timeout > /dev/null; then
+  LIMIT="timeout 600"
+fi
+HOME="$WORK" $LIMIT "$MINIDB" < "$WORK/in.sql" > "$WORK/out.txt" 2>&1
+if [ $? -ne 0 ]; then
+  echo "FAIL: minidb exited with an error or timed out"
+  exit 1
+fi
+
+# The first count scans the table, the second reads the index.
+COUNTS=$(grep -A1 '^count(\*)' "$WORK/out.txt" | grep '^[0-9]' | tr -d ' ')
+TABLE=$(echo "$COUNTS" | sed -n 1p)
+INDEX=$(echo "$COUNTS" | sed -n 2p)
+if [ -z "$TABLE" ] || [ "$TABLE" != "$INDEX" ]; then
+  echo "FAIL: $TABLE records in the table, $INDEX in the index"
+  exit 1
+fi
+
+sed -n '/select b , c from t order by b , c/,$p' "$WORK/out.txt" |
+  grep -E '^[0-9]+ +[a-z0-9]+ *$' > "$WORK/rows.txt"
+ROWS=$(wc -l < "$WORK/rows.txt" | tr -d ' ')
+if [ "$ROWS" != "$TABLE" ]; then
+  echo "FAIL: $ROWS rows ordered along the index, $TABLE records"
+  exit 1
+fi
+if ! LC_ALL=C sort -c -k1,1n -k2,2 "$WORK/rows.txt"; then
+  echo "FAIL: rows ordered along the index are out of order"
+  exit 1
+fi
+
+echo "PASS: $TABLE records"
@@ -0,0 +1,85 @@
+#!/bin/sh
+# Regression test: the operators that write rows to temporary files once
+# the memory budget is spent (external sort, the Grace hash join and the
+# spilling hash aggregate) must return what they return in memory, as must
+# top-N, which keeps its rows in a heap however small the budget.
+# The statements run twice, under the default budget and under one of
+# 128 KB set through MINIDB_SPILL_BUDGET, and their rows are compared.
+#
+# Usage: tests/spill.sh path/to/minidb
+
+MINIDB=${1:?usage: $0 path/to/minidb}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+awk 'BEGIN {
+  print "create database d;";
+  print "use d;";
+  print "create table t (a int, g int, s char(20), f float, primary key (a));";
+  print "create table u (x int, y int, v char(20), primary key (x));";
+  for (a = 0; a < 12000; a++) {
+    printf "insert into t values (%d, %d, '\''s%d'\'', %d.25);\n",
+           a, (a * 7919) % 5000, (a * 104729) % 9973, a % 97;
+  }
+  for (x = 0; x < 10000; x++) {
+    printf "insert into u values (%d, %d, '\''v%d'\'');\n",
+           x, (x * 31) % 5000, x % 7;
+  }
+  print "select a, s from t order by s, a;";
+  print "select g, s, f from t order by f desc, s, a;";
+  print "select a, s from t order by s desc, a limit 25;";
+  print "select a, s from t order by s desc, a limit 70000 offset 5000;";
+  print "select g, count(*), sum(a), min(s), max(f) from t group by g;";
+  print "select s, count(*) from t group by s;";
+  print "join t AND u ON g = y;";
+}' > "$WORK/in.sql"
+
+# A corrupted spill may leave an operator waiting for rows forever.
+LIMIT=
+if command -v timeout > /dev/null; then
+  LIMIT="timeout 600"
+fi
+
+for run in memory spill; do
+  mkdir "$WORK/$run"
+  if [ $run = spill ]; then
+    BUDGET=131072
+  else
+    BUDGET=
+  fi
+  HOME="$WORK/$run" MINIDB_SPILL_BUDGET=$BUDGET $LIMIT "$MINIDB" \
+    < "$WORK/in.sql" > "$WORK/$run.txt" 2>&1
+  if [ $? -ne 0 ]; then
+    echo "FAIL: minidb exited with an error or timed out ($run)"
+    exit 1
+  fi
+  # One file per query, from its statement on. Rows of queries without
+  # ORDER BY are sorted, since spilling may change their order.
+  awk -v dir="$WORK/$run" '
+    /^SQL STATEMENT: (select|join)/ { n++; sorted = $0 !~ / order by / }
+    /^SQL STATEMENT:/ && !/^SQL STATEMENT: (select|join)/ { n = 0 }
+    n > 0 { print > (dir "/" n (sorted ? ".unsorted" : ".txt")) }
+  ' "$WORK/$run.txt"
+  for f in "$WORK/$run"/*.unsorted; do
+    LC_ALL=C sort "$f" > "${f%.unsorted}.txt"
+  done
+done
+
+if [ "$(ls "$WORK/memory"/*.txt | wc -l)" -ne 7 ]; then
+  echo "FAIL: expected the output of 7 queries"
+  exit 1
+fi
+for f in "$WORK/memory"/*.txt; do
+  q=$(basename "$f")
+  if [ $(wc -l < "$f") -lt 20 ]; then
+    echo "FAIL: query $q returned too few rows"
+    exit 1
+  fi
+  if ! cmp -s "$f" "$WORK/spill/$q"; then
+    echo "FAIL: query $q differs once it spills:"
+    diff "$f" "$WORK/spill/$q" | head -10
+    exit 1
+  fi
+done
+
+echo "PASS: 7 queries"